@@ -1,89 +1,387 @@
 #include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
 #include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+// build: gcc -O3 -fopenmp compare.c -o compare.exe -lm
+//
+// Use compare.exe n1 n2 n3 n4 reference_file new_result output_diff [max_error]
+//     compares the raw float volumes, writing their difference to output_diff
+// Use compare.exe [-e max_error] [-d diff.rsf] [-s] [-f] reference.rsf new.rsf
+//     takes n1..n4 and the data files from the RSF headers; writes the difference
+//     only with -d, prints only the summary with -s and stops at the first time
+//     step with errors with -f
+//
+// Inputs are memory mapped and read ahead one time step at a time; every step is
+// reduced in parallel, vectorized, to its maximum, RMS and relative errors, SNR and
+// the L2 norms of both volumes, so that large comparisons are bound by the disk.
+// Points are errors when their difference exceeds max_error times the maximum
+// absolute value of the reference in the time step (in the planes of the time step
+// up to theirs with the legacy arguments, as always); they are counted again only in
+// the planes whose maximum difference exceeds that.
 
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
 #define ERRO(str) do{ fprintf(stderr, str "\n"); exit(1); }while(0)
 
-// A really small number 
+// A really small number
 #define EPS 1.0e-15
 //#define MAX_ERROR 1.0e-5
 #define MAX_ERROR 1.0e-5
 
+#define NAME_LEN 4096
+
+// a volume of n4 time steps of n3 planes of n1*n2 floats, mapped from its data file
+typedef struct
+{
+   long n[4];
+   char data[NAME_LEN];   // data file
+   size_t size;           // bytes of the volume
+   float *v;
+   int fd;
+} VolumeT;
+
+
+// ReadHeader: dimensions and data file of an RSF header; the data file is relative
+//             to the directory of the header unless absolute
+static void ReadHeader(const char *name, VolumeT *vol)
+{
+   FILE *fp = fopen(name, "r");
+   if (fp == NULL) ERRO("fopen of a header failed");
+   char line[NAME_LEN], in[NAME_LEN] = "";
+   long esize = sizeof(float);
+   vol->n[0] = vol->n[1] = vol->n[2] = vol->n[3] = 1;
+   while (fgets(line, NAME_LEN, fp) != NULL)
+   {
+      int k;
+      long value;
+      if (sscanf(line, "n%d=%ld", &k, &value) == 2 && k >= 1 && k <= 4) vol->n[k-1] = value;
+      else if (sscanf(line, "esize=%ld", &value) == 1) esize = value;
+      else if (strncmp(line, "data_format=", 12) == 0 && strstr(line, "native_float") == NULL)
+         ERRO("only native_float data is supported");
+      else if (strncmp(line, "in=", 3) == 0)
+      {
+         const char *s = line+3;
+         if (*s == '"') s++;
+         snprintf(in, NAME_LEN, "%s", s);
+         in[strcspn(in, "\"\n")] = '\0';
+      }
+   }
+   fclose(fp);
+   if (esize != sizeof(float)) ERRO("only 4 byte samples are supported");
+   if (in[0] == '\0') ERRO("header without in=");
+   const char *slash = strrchr(name, '/');
+   if (in[0] == '/' || slash == NULL)
+      snprintf(vol->data, NAME_LEN, "%s", in);
+   else
+      snprintf(vol->data, NAME_LEN, "%.*s/%s", (int)(slash-name), name, in);
+}
+
+
+// MapVolume: data file of the volume mapped for sequential reading
+static void MapVolume(VolumeT *vol)
+{
+   vol->size = vol->n[0]*vol->n[1]*vol->n[2]*vol->n[3]*sizeof(float);
+   vol->fd = open(vol->data, O_RDONLY);
+   if (vol->fd < 0) ERRO("open of a data file failed");
+   struct stat st;
+   if (fstat(vol->fd, &st) != 0 || (size_t) st.st_size < vol->size) ERRO("data file shorter than its dimensions");
+   vol->v = mmap(NULL, vol->size, PROT_READ, MAP_SHARED, vol->fd, 0);
+   if (vol->v == MAP_FAILED) ERRO("mmap of a data file failed");
+   madvise(vol->v, vol->size, MADV_SEQUENTIAL);
+}
+
+
+// CreateDiff: data file of the difference, mapped for writing, and its header
+static float *CreateDiff(const char *data, const char *header, const VolumeT *ref, const char *refHeader, int *fd)
+{
+   *fd = open(data, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (*fd < 0) ERRO("open of the diff file failed");
+   if (ftruncate(*fd, ref->size) != 0) ERRO("ftruncate of the diff file failed");
+   float *diff = mmap(NULL, ref->size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+   if (diff == MAP_FAILED) ERRO("mmap of the diff file failed");
+   if (header == NULL) return diff;
+
+   // the header of the reference, but for the data file
+   FILE *in = fopen(refHeader, "r");
+   FILE *out = fopen(header, "w");
+   if (in == NULL || out == NULL) ERRO("fopen of the diff header failed");
+   const char *slash = strrchr(data, '/');
+   char line[NAME_LEN];
+   while (fgets(line, NAME_LEN, in) != NULL)
+      if (strncmp(line, "in=", 3) == 0) fprintf(out, "in=\"./%s\"\n", (slash != NULL) ? slash+1 : data);
+      else fputs(line, out);
+   fclose(in);
+   fclose(out);
+   return diff;
+}
+
+
+// Advise: advice on the pages that hold bytes from p
+static void Advise(const void *p, size_t bytes, int advice)
+{
+   const size_t page = sysconf(_SC_PAGESIZE);
+   const size_t start = (size_t)p & ~(page-1);
+   madvise((void *)start, (size_t)p+bytes-start, advice);
+}
+
+
+// ReducePlanes: maximum absolute value of the reference and of the difference in each
+//               plane of a time step, and the squared norms of the reference, the new
+//               result and the difference; the difference is stored in d unless NULL
+static void ReducePlanes(const float *a, const float *b, float *d, long nPlane, long n3,
+                         float *planeMax, float *planeDiff, double *ref2, double *res2, double *diff2)
+{
+   double sa = 0.0, sb = 0.0, se = 0.0;
+   #pragma omp parallel for reduction(+:sa,sb,se) schedule(static)
+   for (long iz=0; iz<n3; iz++)
+   {
+      const float *pa = a+iz*nPlane, *pb = b+iz*nPlane;
+      float *pd = (d != NULL) ? d+iz*nPlane : NULL;
+      float ma = 0.0f, me = 0.0f;
+      double qa = 0.0, qb = 0.0, qe = 0.0;
+      if (pd != NULL)
+      {
+         #pragma omp simd reduction(max:ma,me) reduction(+:qa,qb,qe)
+         for (long i=0; i<nPlane; i++)
+         {
+            const float e = pa[i]-pb[i];
+            pd[i] = e;
+            ma = MAX(ma, fabsf(pa[i]));
+            me = MAX(me, fabsf(e));
+            qa += (double)pa[i]*pa[i];
+            qb += (double)pb[i]*pb[i];
+            qe += (double)e*e;
+         }
+      }
+      else
+      {
+         #pragma omp simd reduction(max:ma,me) reduction(+:qa,qb,qe)
+         for (long i=0; i<nPlane; i++)
+         {
+            const float e = pa[i]-pb[i];
+            ma = MAX(ma, fabsf(pa[i]));
+            me = MAX(me, fabsf(e));
+            qa += (double)pa[i]*pa[i];
+            qb += (double)pb[i]*pb[i];
+            qe += (double)e*e;
+         }
+      }
+      planeMax[iz] = ma;
+      planeDiff[iz] = me;
+      sa += qa;
+      sb += qb;
+      se += qe;
+   }
+   *ref2 = sa;
+   *res2 = sb;
+   *diff2 = se;
+}
+
+
+// PlaneErrors: points of each plane of a time step whose difference exceeds max_error
+//              times the scale of the plane; only planes whose maximum difference does
+//              are read
+static long PlaneErrors(const float *a, const float *b, long nPlane, long n3,
+                        const float *planeDiff, const float *scale, double max_error, long *cont)
+{
+   long total = 0;
+   #pragma omp parallel for reduction(+:total) schedule(dynamic)
+   for (long iz=0; iz<n3; iz++)
+   {
+      long c = 0;
+      const double t = scale[iz]*max_error;
+      if (planeDiff[iz] > t)
+      {
+         const float *pa = a+iz*nPlane, *pb = b+iz*nPlane;
+         #pragma omp simd reduction(+:c)
+         for (long i=0; i<nPlane; i++) c += (fabsf(pa[i]-pb[i]) > t);
+      }
+      cont[iz] = c;
+      total += c;
+   }
+   return total;
+}
+
+
+static double Now()
+{
+   return omp_get_wtime();
+}
+
+
 int main(int argc, char *argv[])
 {
-   if (argc != 8)
+   VolumeT ref, res;
+   const char *refHeader = NULL, *diffHeader = NULL;
+   char diffData[NAME_LEN] = "";
+   double max_error = MAX_ERROR;
+   int summary = 0, stopFirst = 0;
+
+   const int legacy = (argc > 1 && argv[1][0] >= '0' && argv[1][0] <= '9');
+   if (legacy)
    {
-      fprintf(stderr, "Use %s n1 n2 n3 n4 reference_file new_result output_diff\n", argv[0]);
-      return 1;
+      if (argc != 8 && argc != 9)
+      {
+         fprintf(stderr, "Use %s n1 n2 n3 n4 reference_file new_result output_diff [max_error]\n", argv[0]);
+         return 1;
+      }
+      for (int k=0; k<4; k++) ref.n[k] = res.n[k] = atol(argv[k+1]);
+      snprintf(ref.data, NAME_LEN, "%s", argv[5]);
+      snprintf(res.data, NAME_LEN, "%s", argv[6]);
+      snprintf(diffData, NAME_LEN, "%s", argv[7]);
+
+      // relative error tolerance, e.g. the error budget of reduced precision storage
+      if (argc == 9) max_error = atof(argv[8]);
+
+      printf("argc=%d\n", argc);
+      printf("n1=%ld n2=%ld n3=%ld n4=%ld\n", ref.n[0], ref.n[1], ref.n[2], ref.n[3]);
+      printf("file1: %s\n", ref.data);
+      printf("file2: %s\n", res.data);
+      printf("file3: %s\n", diffData);
+      printf("max_error: %e\n", max_error);
    }
+   else
+   {
+      int opt;
+      while ((opt = getopt(argc, argv, "e:d:sf")) != -1)
+         switch (opt)
+         {
+         case 'e': max_error = atof(optarg); break;
+         case 'd': diffHeader = optarg; break;
+         case 's': summary = 1; break;
+         case 'f': stopFirst = 1; break;
+         default:
+            fprintf(stderr, "Use %s n1 n2 n3 n4 reference_file new_result output_diff [max_error]\n", argv[0]);
+            fprintf(stderr, "Use %s [-e max_error] [-d diff.rsf] [-s] [-f] reference.rsf new.rsf\n", argv[0]);
+            return 1;
+         }
+      if (argc-optind != 2)
+      {
+         fprintf(stderr, "Use %s [-e max_error] [-d diff.rsf] [-s] [-f] reference.rsf new.rsf\n", argv[0]);
+         return 1;
+      }
+      refHeader = argv[optind];
+      ReadHeader(refHeader, &ref);
+      ReadHeader(argv[optind+1], &res);
+      for (int k=0; k<4; k++)
+         if (ref.n[k] != res.n[k]) ERRO("dimensions of the headers differ");
+      if (diffHeader != NULL) snprintf(diffData, NAME_LEN, "%s@", diffHeader);
+      printf("n1=%ld n2=%ld n3=%ld n4=%ld max_error=%e threads=%d\n",
+             ref.n[0], ref.n[1], ref.n[2], ref.n[3], max_error, omp_get_max_threads());
+      printf("reference: %s\n", ref.data);
+      printf("new: %s\n", res.data);
+      if (diffHeader != NULL) printf("diff: %s\n", diffHeader);
+   }
+
+   MapVolume(&ref);
+   MapVolume(&res);
+   int fdDiff = -1;
+   float *diff = (diffData[0] != '\0') ? CreateDiff(diffData, diffHeader, &ref, refHeader, &fdDiff) : NULL;
+
+   const long nPlane = ref.n[0]*ref.n[1];
+   const long n3 = ref.n[2], n4 = ref.n[3];
+   const long nStep = nPlane*n3;
+   const size_t stepBytes = nStep*sizeof(float);
+   long *cont = malloc(n3*sizeof(long));
+   float *planeMax = malloc(n3*sizeof(float));
+   float *planeDiff = malloc(n3*sizeof(float));
+   float *scale = malloc(n3*sizeof(float));
+   if (cont == NULL || planeMax == NULL || planeDiff == NULL || scale == NULL) ERRO("malloc failed for the planes");
 
-   const long n1=atol(argv[1]);
-   const long n2=atol(argv[2]);
-   const long n3=atol(argv[3]);
-   const long n4=atol(argv[4]);
-
-   const char * const file1 = argv[5];
-   const char * const file2 = argv[6];
-   const char * const file3 = argv[7];
-
-   printf("argc=%d\n", argc);
-   printf("n1=%ld n2=%ld n3=%ld n4=%ld\n", n1, n2, n3, n4);
-   printf("file1: %s\n", file1);
-   printf("file2: %s\n", file2);
-   printf("file3: %s\n", file3);
-
-   const size_t msize=n1*n2*sizeof(float);
-   float *plane1 = malloc(n1*n2*sizeof(float));
-   if (plane1 == NULL) ERRO("malloc failed for plane1");
-   float *plane2 = malloc(n1*n2*sizeof(float));
-   if (plane2 == NULL) ERRO("malloc failed for plane2");
-   float *diff   = malloc(n1*n2*sizeof(float));
-   if (diff == NULL) ERRO("malloc failed for diff");
-   FILE* f1 = fopen(file1, "r");
-   if (f1 == NULL) ERRO("fopen");
-   FILE* f2 = fopen(file2, "r");
-   if (f2 == NULL) ERRO("fopen");
-   FILE* f3 = fopen(file3, "w");
-   if (f3 == NULL) ERRO("fopen");
-  
-  
-   long global_cont=0;
-   for (int it=0; it<n4; it++)
+   const double t0 = Now();
+   long global_cont = 0;
+   float global_maxerr = 0.0f;
+   double global_diff2 = 0.0, global_ref2 = 0.0, worst_snr = INFINITY;
+   long it;
+   for (it=0; it<n4; it++)
    {
+      const float *a = ref.v+it*nStep, *b = res.v+it*nStep;
+      float *d = (diff != NULL) ? diff+it*nStep : NULL;
+
+      // read the next time step ahead while this one is reduced
+      if (it+1 < n4)
+      {
+         Advise(a+nStep, stepBytes, MADV_WILLNEED);
+         Advise(b+nStep, stepBytes, MADV_WILLNEED);
+      }
+
+      double ref2 = 0.0, res2 = 0.0, diff2 = 0.0;
+      ReducePlanes(a, b, d, nPlane, n3, planeMax, planeDiff, &ref2, &res2, &diff2);
+
+      // errors are relative to the maximum of the time step, or of the planes up to
+      // theirs in the legacy comparison
       float maxval=EPS; // per timestep maxval for error detection
-      for (int iz=0; iz<n3; iz++)
+      float maxdiff=0.0f; // per timestep maximum absolute difference
+      for (long iz=0; iz<n3; iz++)
+      {
+         maxval = MAX(maxval, planeMax[iz]);
+         maxdiff = MAX(maxdiff, planeDiff[iz]);
+         if (legacy) scale[iz] = maxval;
+      }
+      if (!legacy)
+         for (long iz=0; iz<n3; iz++) scale[iz] = maxval;
+
+      // errors are counted again only in the planes that have any
+      const long step_cont = PlaneErrors(a, b, nPlane, n3, planeDiff, scale, max_error, cont);
+      if (step_cont && !summary)
+         for (long iz=0; iz<n3; iz++)
+            if (cont[iz]) printf("%ld erros no plano it=%ld iz=%ld maxval=%lf\n", cont[iz], it, iz, scale[iz]);
+      global_cont += step_cont;
+
+      const double snr = (diff2 > 0.0) ? 10.0*log10(ref2/diff2) : INFINITY;
+      if (legacy)
+         printf("it=%ld maxval=%lf maxerr=%e\n", it, maxval, maxdiff/maxval);
+      else if (!summary)
+         printf("it=%ld maxval=%lf maxerr=%e rms=%e snr=%.2lf dB l2ref=%e l2new=%e errors=%ld\n",
+                it, maxval, maxdiff/maxval, sqrt(diff2/nStep), snr, sqrt(ref2), sqrt(res2), step_cont);
+      global_maxerr = MAX(global_maxerr, maxdiff/maxval);
+      global_diff2 += diff2;
+      global_ref2 += ref2;
+      worst_snr = MIN(worst_snr, snr);
+
+      // pages already compared are not needed again
+      Advise(a, stepBytes, MADV_DONTNEED);
+      Advise(b, stepBytes, MADV_DONTNEED);
+      if (stopFirst && step_cont)
       {
-          if (fread(plane1, msize, (size_t) 1, f1) != 1) ERRO("fread");
-          if (fread(plane2, msize, (size_t) 1, f2) != 1) ERRO("fread");
-          for (int i=0; i<n1*n2; i++) maxval=MAX(maxval, fabsf(plane1[i]));
-          long cont=0;
-          for (int i=0; i<n1*n2; i++)
-          {
-             diff[i]=plane1[i]-plane2[i];
-             if (fabsf(diff[i]) > (maxval*MAX_ERROR)) cont++;
-          }
-          global_cont += cont;
-          if (cont) printf("%ld erros no plano it=%d iz=%d maxval=%lf\n", cont, it, iz, maxval);
-          if (fwrite(diff, msize, (size_t) 1, f3) != 1) ERRO("fwrite");
+         printf("stopped at the first time step with errors, it=%ld\n", it);
+         it++;
+         break;
       }
-      printf("it=%d maxval=%lf\n", it, maxval);
    }
-   fclose(f1);
-   fclose(f2);
-   fclose(f3);
-
-   if (global_cont) {
-       free(plane1);
-       free(plane2);
-       free(diff);
-       return 1;
+   const double seconds = Now()-t0;
+
+   printf("maximum relative error %e\n", global_maxerr);
+   if (!legacy)
+   {
+      const double bytes = (double)it*stepBytes*((diff != NULL) ? 3 : 2);
+      printf("%ld of %ld time steps: rms error %e, relative L2 error %e, worst snr %.2lf dB, %ld errors; %.3lf s, %.2lf GB/s\n",
+             it, n4, sqrt(global_diff2/((double)it*nStep)),
+             (global_ref2 > 0.0) ? sqrt(global_diff2/global_ref2) : 0.0, worst_snr, global_cont,
+             seconds, (seconds > 0.0) ? 1.0e-9*bytes/seconds : 0.0);
+   }
+   munmap(ref.v, ref.size);
+   munmap(res.v, res.size);
+   close(ref.fd);
+   close(res.fd);
+   if (diff != NULL)
+   {
+      munmap(diff, ref.size);
+      close(fdDiff);
    }
+   free(cont);
+   free(planeMax);
+   free(planeDiff);
+   free(scale);
+
+   if (global_cont) return 1;
    printf("success\n");
-   free(plane1);
-   free(plane2);
-   free(diff);
    return 0;
 }
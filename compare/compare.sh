@@ -1,9 +1,9 @@
 #!/bin/bash
 
 
-if [[ $# -ne 2 ]];then
+if [[ $# -ne 2 && $# -ne 3 ]];then
    echo "argc=$#"
-   echo "Use $0 file1.rsf file2.rsf"
+   echo "Use $0 file1.rsf file2.rsf [max_error]"
    exit 1
 fi
 
@@ -11,9 +11,7 @@ fi
 
 if file "$1" | grep 'ASCII text';then
 if file "$2" | grep 'ASCII text';then
-  cat "$1" | sed -e "s/^in\=.*$/in=\".\/diff.rsf@\"/" > ./diff.rsf
-  source "$1"
-  [[ $n1 -gt 0 && $n2 -gt 0 && $n3 -gt 0 && $n4 -gt 0 ]] && ./compare.exe $n1 $n2 $n3 $n4 "${1}@" "${2}@" ./diff.rsf@ && exit 0
+  ./compare.exe -d ./diff.rsf ${3:+-e $3} "$1" "$2" && exit 0
 fi
 fi
 
@@ -7,6 +7,25 @@
 #include"cuda_propagate.h"
 #include"cuda_insertsource.h"
 
+#ifdef BRICK
+#error "bricked storage (BRICK) is only implemented by the OpenMP backend"
+#endif
+#ifdef HALF
+#error "half precision storage (HALF) is only implemented by the OpenMP backend"
+#endif
+#if defined(TIME_ORDER) && TIME_ORDER == 4
+#error "4th order time integration (TIME_ORDER=4) is only implemented by the OpenMP backend"
+#endif
+#ifdef SOURCE_FORCING
+#error "source as a forcing (SOURCE_FORCING) is only implemented by the OpenMP backend"
+#endif
+#ifdef DIAG
+#error "fused diagnostics (DIAG) are only implemented by the OpenMP backend"
+#endif
+#ifdef NONUNIFORM_Z
+#error "stretched z axis (NONUNIFORM_Z) is only implemented by the CPU backends"
+#endif
+
 // Global device vars
 float* dev_ch1dxx=NULL;
 float* dev_ch1dyy=NULL;
@@ -24,25 +43,18 @@ float* dev_qp=NULL;
 float* dev_qc=NULL;
 
 
-#define MODEL_GLOBALVARS
-#define MODEL_INITIALIZE
-
-
-
 void DRIVER_Initialize(const int sx, const int sy, const int sz, const int bord,
                        float dx, float dy, float dz, float dt,
                        float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
-                       float * restrict phi, float * restrict theta, 
+                       float * restrict phi, float * restrict theta, const CoefT *coef,
                        float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
 {
 
-#include"../precomp.h"
-
 	   CUDA_Initialize(sx,   sy,   sz,   bord,
 		  dx,  dy,  dz,  dt,
-	          ch1dxx,    ch1dyy,    ch1dzz, 
-  	          ch1dxy,    ch1dyz,    ch1dxz, 
-  	          v2px,    v2pz,    v2sz,    v2pn,
+	          coef->ch1dxx,    coef->ch1dyy,    coef->ch1dzz, 
+  	          coef->ch1dxy,    coef->ch1dyz,    coef->ch1dxz, 
+  	          coef->v2px,    coef->v2pz,    coef->v2sz,    coef->v2pn,
   	          vpz,    vsv,    epsilon,    delta,
   	          phi,    theta,
   	          pp,    pc,    qp,    qc);
@@ -67,7 +79,7 @@ void DRIVER_Update_pointers(const int sx, const int sy, const int sz, float *pc)
 
 void DRIVER_Propagate(const int sx, const int sy, const int sz, const int bord,
                       const float dx, const float dy, const float dz, const float dt, const int it,
-	              float * pp, float * pc, float * qp, float * qc)
+	              const CoefT *coef, float * pp, float * pc, float * qp, float * qc)
 {
 
 	// CUDA_Propagate also does TimeForward
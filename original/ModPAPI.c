@@ -1,4 +1,20 @@
+#include <pthread.h>
 #include "ModPAPI.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// selected events, the event set counting each one, and per thread counts
+
+static char eventName[PAPI_MAX_EVENTS][PAPI_NAME];
+static int setOf[PAPI_MAX_EVENTS];
+static int nEvents=0;
+static int nSets=0;
+static int nThreads=1;
+static int eventset[PAPI_MAX_THREADS][PAPI_MAX_SETS];
+static long long count[PAPI_MAX_THREADS][PAPI_MAX_EVENTS];
+static int stepsCounted[PAPI_MAX_SETS];
+
 
 // PAPIFails:
 //   convert PAPI return code on failure and stops
@@ -8,87 +24,313 @@ void PAPIFails(char *s, int retval) {
   printf("**(PAPIFails)**: PAPI funcion %s failed with retval=%d meaning %s\n",
 	 s, retval, PAPI_strerror(retval));
   exit(-1);
-} 
+}
+
+
+// ThreadNum:
+//    OpenMP thread number, 0 outside OpenMP
+
+
+static int ThreadNum() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+
+// SelectEvents:
+//    events of the group named by $FLETCHER_PAPI, or listed in it
+
+
+static void SelectEvents() {
+  static const char *group[][2]=PAPI_GROUPS;
+  const char *env=getenv("FLETCHER_PAPI");
+  const char *list=(env != NULL && env[0] != '\0') ? env : PAPI_DEFAULT_GROUP;
+  for (int k=0; k<(int)(sizeof(group)/sizeof(group[0])); k++)
+    if (strcmp(list, group[k][0]) == 0) {
+      list=group[k][1];
+      break;
+    }
+
+  char buf[PAPI_MAX_EVENTS*PAPI_NAME];
+  snprintf(buf, sizeof(buf), "%s", list);
+  for (char *tok=strtok(buf, ","); tok != NULL && nEvents < PAPI_MAX_EVENTS; tok=strtok(NULL, ","))
+    snprintf(eventName[nEvents++], PAPI_NAME, "%s", tok);
+}
+
+
+// SplitEvents:
+//    place the events in sets that the hardware counts together; an event that
+//    does not fit the current set starts the next one, an event that cannot be
+//    counted at all is dropped
+
+
+static void SplitEvents() {
+  int set=PAPI_NULL, inSet=0, kept=0;
+  int retval;
+
+  for (int e=0; e<nEvents; e++) {
+    if (set == PAPI_NULL && (retval=PAPI_create_eventset(&set)) != PAPI_OK)
+      PAPIFails("PAPI_create_eventset", retval);
+    retval=PAPI_add_named_event(set, eventName[e]);
+    if (retval != PAPI_OK && inSet > 0 && nSets < PAPI_MAX_SETS-1) {
+      PAPI_cleanup_eventset(set);
+      PAPI_destroy_eventset(&set);
+      set=PAPI_NULL;
+      nSets++;
+      inSet=0;
+      if ((retval=PAPI_create_eventset(&set)) != PAPI_OK)
+	PAPIFails("PAPI_create_eventset", retval);
+      retval=PAPI_add_named_event(set, eventName[e]);
+    }
+    if (retval != PAPI_OK) {
+      printf("**(InitPAPI_CreateCounters)**: event %s is not counted: %s\n",
+	     eventName[e], PAPI_strerror(retval));
+      continue;
+    }
+    if (kept != e)
+      memcpy(eventName[kept], eventName[e], PAPI_NAME);
+    setOf[kept++]=nSets;
+    inSet++;
+  }
+  if (set != PAPI_NULL) {
+    PAPI_cleanup_eventset(set);
+    PAPI_destroy_eventset(&set);
+  }
+  nEvents=kept;
+  if (inSet > 0)
+    nSets++;
+  if (nSets == 0) {
+    printf("**(InitPAPI_CreateCounters)**: no event can be counted\n");
+    exit(-1);
+  }
+}
+
+
+// CreateSets:
+//    event sets of the calling thread t
+
+
+static void CreateSets(int t) {
+  int retval;
+  for (int s=0; s<nSets; s++) {
+    eventset[t][s]=PAPI_NULL;
+    if ((retval=PAPI_create_eventset(&eventset[t][s])) != PAPI_OK)
+      PAPIFails("PAPI_create_eventset", retval);
+    for (int e=0; e<nEvents; e++)
+      if (setOf[e] == s && (retval=PAPI_add_named_event(eventset[t][s], eventName[e])) != PAPI_OK)
+	PAPIFails(eventName[e], retval);
+  }
+}
 
 
 // InitPAPI_CreateCounters:
-//    initialize PAPI library and create the counters to measure
-//    memory hierarchy usage
-// Returns eventset, used by other PAPI routines
+//    initialize PAPI library, once per process, and create the event sets of
+//    the selected events on every thread, with counts from zero
+// Returns the number of event sets
 
 
 int InitPAPI_CreateCounters(){
-  int eventset=PAPI_NULL;
+  static int initialized=0;
   int retval;
-  
+
   /* Init the PAPI library */
-  retval = PAPI_library_init( PAPI_VER_CURRENT );
-  if ( retval != PAPI_VER_CURRENT ) {
-    PAPIFails("PAPI_library_init", retval );
+  if (!initialized) {
+    retval = PAPI_library_init( PAPI_VER_CURRENT );
+    if ( retval != PAPI_VER_CURRENT ) {
+      PAPIFails("PAPI_library_init", retval );
+    }
+    retval = PAPI_thread_init( (unsigned long (*)(void)) pthread_self );
+    if ( retval != PAPI_OK ) {
+      PAPIFails("PAPI_thread_init", retval );
+    }
+    initialized=1;
   }
-  
-  /* Create the eventset */
-  retval=PAPI_create_eventset(&eventset);
-  if (retval!=PAPI_OK) {
-    PAPIFails("PAPI_create_eventset", retval );
+
+  nEvents=0;
+  nSets=0;
+  memset(count, 0, sizeof(count));
+  memset(stepsCounted, 0, sizeof(stepsCounted));
+  SelectEvents();
+  SplitEvents();
+
+  // counters are bound to threads: every thread of the team creates its own sets
+
+#ifdef _OPENMP
+#pragma omp parallel
+  {
+#pragma omp single
+    nThreads=(omp_get_num_threads() < PAPI_MAX_THREADS) ? omp_get_num_threads() : PAPI_MAX_THREADS;
+    const int t=ThreadNum();
+    if (t < nThreads) {
+      PAPI_register_thread();
+      CreateSets(t);
+    }
   }
+#else
+  CreateSets(0);
+#endif
 
-  int ic, il;
-  for (int i=0; i<NCOUNTERS; i++) {
-    retval=PAPI_add_named_event(eventset,eventName[i]); 
-    if (retval!=PAPI_OK) {
-      char msg[256]="PAPI_add_named_event("; 
-      for (ic=0; ic<256; ic++) {
-	if (msg[ic]=='\0') {
-	  break;
-	}
-      }
-      for (il=0; il<16; il++, ic++) {
-	msg[ic]=eventName[i][il];
-	if (eventName[i][il] =='\0') {
-	  msg[ic]=')';
-	  msg[ic+1]='\0';
-	  break;
-	}
+  printf("PAPI: %d events in %d event sets, counted on %d threads\n", nEvents, nSets, nThreads);
+  return(nSets);
+}
+
+
+// FinalizePAPI:
+//    destroy the event sets of every thread, so that the next
+//    InitPAPI_CreateCounters starts anew
+
+
+void FinalizePAPI() {
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    const int t=ThreadNum();
+    if (t < nThreads) {
+      for (int s=0; s<nSets; s++) {
+	PAPI_cleanup_eventset(eventset[t][s]);
+	PAPI_destroy_eventset(&eventset[t][s]);
       }
-      printf("msg=%s\n",msg);
-      PAPIFails(msg, retval );
+#ifdef _OPENMP
+      PAPI_unregister_thread();
+#endif
     }
   }
-  return(eventset);
+  nEvents=0;
+  nSets=0;
 }
 
 
 // StartCounters:
-//    reset and start counting the events on eventset
+//    reset and start counting, on every thread, the event set of step it;
+//    the threads of this parallel region run the parallel region of the kernel
 
 
-void StartCounters(int eventset){
-    PAPI_start(eventset);
+void StartCounters(int it){
+  const int s=it%nSets;
+#pragma omp parallel
+  {
+    const int t=ThreadNum();
+    if (t < nThreads)
+      PAPI_start(eventset[t][s]);
+  }
 }
 
 
-// StopCounters:
-//    stop counting the events on eventset and return their values
+// StopReadCounters:
+//    stop counting the event set of step it on every thread and accumulate its values
 
 
-void StopReadCounters(int eventset, long long *val) {
-  PAPI_stop(eventset, val);
+void StopReadCounters(int it) {
+  const int s=it%nSets;
+  stepsCounted[s]++;
+#pragma omp parallel
+  {
+    const int t=ThreadNum();
+    if (t < nThreads) {
+      long long val[PAPI_MAX_EVENTS];
+      PAPI_stop(eventset[t][s], val);
+      for (int e=0, k=0; e<nEvents; e++)
+	if (setOf[e] == s)
+	  count[t][e]+=val[k++];
+    }
+  }
+}
+
+
+// Scaled:
+//    count of event e on thread t scaled from the steps of its set to all steps
+
+
+static double Scaled(int t, int e) {
+  int steps=0;
+  for (int s=0; s<nSets; s++)
+    steps+=stepsCounted[s];
+  const int counted=stepsCounted[setOf[e]];
+  return (counted > 0) ? (double)count[t][e]*steps/counted : 0.0;
+}
+
+
+// Total:
+//    count of the event named name over all threads; -1 if not counted
+
+
+static double Total(const char *name) {
+  for (int e=0; e<nEvents; e++)
+    if (strcmp(eventName[e], name) == 0) {
+      double sum=0.0;
+      for (int t=0; t<nThreads; t++)
+	sum+=Scaled(t, e);
+      return sum;
+    }
+  return -1.0;
+}
+
+
+// Derived:
+//    report metric name, ratio of num to den, if both events were counted
+
+
+static void Derived(const char *name, double num, double den, FILE *f) {
+  if (num < 0.0 || !(den > 0.0))
+    return;
+  printf("PAPI %s %.4lf\n", name, num/den);
+  if (f != NULL)
+    fprintf(f, "%s; %lf; ", name, num/den);
 }
 
 
 // ReportRawCountersCSV
-//    report raw counter names and values at a file with CSV format
-//    do not report if *f is NULL
+//    report counter names and values, scaled to all steps, per thread and in total,
+//    and the metrics derived from them for the given propagated samples,
+//    at a file with CSV format and on stdout
+//    do not report at the file if *f is NULL
 
 
-void ReportRawCountersCSV (long long *values, FILE *f){
+void ReportRawCountersCSV (long samples, FILE *f){
+
+  for (int e=0; e<nEvents; e++) {
+    printf("PAPI %s %.0lf", eventName[e], Total(eventName[e]));
+    if (nThreads > 1) {
+      printf(" (per thread");
+      for (int t=0; t<nThreads; t++)
+	printf(" %.0lf", Scaled(t, e));
+      printf(")");
+    }
+    printf("\n");
+  }
 
   if (f != NULL) {
-    for (int i=0; i<NCOUNTERS; i++) {
-      fprintf(f,"%s; %lld; ",eventName[i], values[i]);
+    for (int e=0; e<nEvents; e++) {
+      fprintf(f,"%s; %.0lf; ",eventName[e], Total(eventName[e]));
     }
     fprintf(f,"\n");
+    for (int t=0; t<nThreads; t++) {
+      fprintf(f,"thread; %d; ", t);
+      for (int e=0; e<nEvents; e++)
+	fprintf(f,"%s; %.0lf; ",eventName[e], Scaled(t, e));
+      fprintf(f,"\n");
+    }
   }
-}
 
+  // derived metrics; a last level miss moves one line from memory
+
+  const double flops=Total("PAPI_SP_OPS");
+  const double llMiss=Total("PAPI_L3_TCM");
+  const double bytes=(llMiss < 0.0) ? -1.0 : llMiss*PAPI_LINE;
+  Derived("flops_per_sample", flops, samples, f);
+  Derived("bytes_per_sample", bytes, samples, f);
+  Derived("arithmetic_intensity", flops, bytes, f);
+  Derived("vectorization_ratio", Total("PAPI_VEC_SP"), flops, f);
+  Derived("ipc", Total("PAPI_TOT_INS"), Total("PAPI_TOT_CYC"), f);
+  Derived("stalled_fraction", Total("PAPI_RES_STL"), Total("PAPI_TOT_CYC"), f);
+  Derived("l1_misses_per_sample", Total("PAPI_L1_DCM"), samples, f);
+  Derived("l2_misses_per_sample", Total("PAPI_L2_DCM"), samples, f);
+  Derived("l3_misses_per_sample", llMiss, samples, f);
+  Derived("tlb_misses_per_sample", Total("PAPI_TLB_DM"), samples, f);
+  if (f != NULL)
+    fprintf(f,"\n");
+}
@@ -9,33 +9,64 @@
 // vector instruction length
 #define VLEN 4LL
 
-// PAPI counters and counter names
-//#define NCOUNTERS 4
-//static char eventName[NCOUNTERS][16]={"PAPI_LD_INS", "PAPI_L1_LDM", "PAPI_L2_LDM", "PAPI_L3_LDM"};
+// PAPI counters (make PAPI=1)
+//    $FLETCHER_PAPI names a group below or lists events separated by commas;
+//    default is flops. Every OpenMP thread counts the events of the propagate
+//    steps. Events that do not fit the hardware counters together are split in
+//    event sets counted at alternate steps, and their counts are scaled to all steps.
 
-#define NCOUNTERS 1
-static char eventName[NCOUNTERS][16]={"PAPI_SP_OPS"};
+#define PAPI_MAX_EVENTS 16
+#define PAPI_MAX_SETS 8
+#define PAPI_MAX_THREADS 256
+#define PAPI_NAME 32
+#define PAPI_LINE 64LL          // bytes per cache miss
+
+#define PAPI_DEFAULT_GROUP "flops"
+
+// flops:  single precision operations, as before (PAPI_SP_OPS)
+// cache:  data cache misses per level and loads
+// tlb:    TLB and last level cache misses, to compare row-major and bricked (BRICK) layouts
+// stalls: cycles, instructions and cycles stalled on any resource
+// vector: vector and all single precision operations
+// roof:   flops and last level misses, for arithmetic intensity
+
+#define PAPI_GROUPS {						\
+    {"flops",  "PAPI_SP_OPS"},						\
+    {"cache",  "PAPI_L1_DCM,PAPI_L2_DCM,PAPI_L3_TCM,PAPI_LD_INS"},	\
+    {"tlb",    "PAPI_TLB_DM,PAPI_L3_TCM"},				\
+    {"stalls", "PAPI_TOT_CYC,PAPI_TOT_INS,PAPI_RES_STL"},		\
+    {"vector", "PAPI_VEC_SP,PAPI_SP_OPS"},				\
+    {"roof",   "PAPI_SP_OPS,PAPI_L3_TCM"}					\
+  }
 
 // InitPAPI_CreateCounters:
-//    initialize PAPI library and create the counters to measure
-//    memory hierarchy usage
-// Returns eventset, used by other PAPI routines
+//    initialize PAPI library, once per process, and create the event sets of
+//    the selected events on every thread, with counts from zero
+// Returns the number of event sets
 
 int InitPAPI_CreateCounters();
 
+// FinalizePAPI:
+//    destroy the event sets of every thread, so that the next
+//    InitPAPI_CreateCounters starts anew
+
+void FinalizePAPI();
+
 // StartCounters:
-//    reset and start counting the events on eventset
+//    reset and start counting, on every thread, the event set of step it
 
-void StartCounters(int eventset);
+void StartCounters(int it);
 
-// StopCounters:
-//    stop counting the events on eventset and return their values
+// StopReadCounters:
+//    stop counting the event set of step it on every thread and accumulate its values
 
-void StopReadCounters(int eventset, long long *val);
+void StopReadCounters(int it);
 
 // ReportRawCountersCSV
-//    report raw counter names and values at a file with CSV format
-//    do not report if *f is NULL
+//    report counter names and values, scaled to all steps, per thread and in total,
+//    and the metrics derived from them for the given propagated samples,
+//    at a file with CSV format and on stdout
+//    do not report at the file if *f is NULL
 
-void ReportRawCountersCSV (long long *values, FILE *f);
+void ReportRawCountersCSV (long samples, FILE *f);
 #endif
@@ -3,16 +3,38 @@
 #include "openacc_insertsource.h"
 #include "../sample.h"
 
-extern float *ch1dxx, *ch1dyy, *ch1dzz, *ch1dxy, *ch1dyz, *ch1dxz, *v2px, *v2pz, *v2sz, *v2pn;
-
+#ifdef BRICK
+#error "bricked storage (BRICK) is only implemented by the OpenMP backend"
+#endif
+#ifdef HALF
+#error "half precision storage (HALF) is only implemented by the OpenMP backend"
+#endif
+#if defined(TIME_ORDER) && TIME_ORDER == 4
+#error "4th order time integration (TIME_ORDER=4) is only implemented by the OpenMP backend"
+#endif
+#ifdef SOURCE_FORCING
+#error "source as a forcing (SOURCE_FORCING) is only implemented by the OpenMP backend"
+#endif
+#ifdef DIAG
+#error "fused diagnostics (DIAG) are only implemented by the OpenMP backend"
+#endif
+#ifdef NONUNIFORM_Z
+#error "stretched z axis (NONUNIFORM_Z) is only implemented by the CPU backends"
+#endif
 
 void DRIVER_Initialize(const int sx, const int sy, const int sz, const int bord,
 		       float dx, float dy, float dz, float dt,
 		       float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
-		       float * restrict phi, float * restrict theta,
+		       float * restrict phi, float * restrict theta, const CoefT *coef,
 		       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
 {
-  
+
+  // the kernels find the coefficients of coef present on the device
+
+  const float *ch1dxx=coef->ch1dxx, *ch1dyy=coef->ch1dyy, *ch1dzz=coef->ch1dzz;
+  const float *ch1dxy=coef->ch1dxy, *ch1dyz=coef->ch1dyz, *ch1dxz=coef->ch1dxz;
+  const float *v2px=coef->v2px, *v2pz=coef->v2pz, *v2sz=coef->v2sz, *v2pn=coef->v2pn;
+
 #pragma acc enter data copyin(ch1dxx[0:sx*sy*sz])
 #pragma acc enter data copyin(ch1dyy[0:sx*sy*sz])
 #pragma acc enter data copyin(ch1dzz[0:sx*sy*sz])
@@ -48,12 +70,12 @@ void DRIVER_Update_pointers(const int sx, const int sy, const int sz, float *pc)
 
 void DRIVER_Propagate(const int sx, const int sy, const int sz, const int bord,
 	       const float dx, const float dy, const float dz, const float dt, const int it, 
-	       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
 {
 
 	   OPENACC_Propagate (  sx,   sy,   sz,   bord,
 	                              dx,   dy,   dz,   dt,   it,
-	                              pp,   pc,   qp,   qc);
+	                              coef,   pp,   pc,   qp,   qc);
 
 }
 
@@ -9,7 +9,7 @@
 
 void OPENACC_Propagate(int sx, int sy, int sz, int bord,
 	       float dx, float dy, float dz, float dt, int it, 
-	       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
 
 
 #define SAMPLE_PRE_LOOP
@@ -0,0 +1,93 @@
+#ifdef DIAG
+
+#include "openmp_diag.h"
+#include "../map.h"
+#include "../utils.h"
+
+#if defined(HALF) || defined(JIT)
+#error "fused diagnostics (DIAG) does not support HALF or JIT"
+#endif
+
+
+static int every=DIAG_EVERY;
+static float limit=DIAG_LIMIT;
+static float ddx, ddy, ddz;
+
+// diagnostics of the last step
+
+static int lastStep=0;
+static double lastEnergy=0.0;
+static float lastMax=0.0f;
+static float peakMax=0.0f;
+static int diverged=0;
+
+
+// OPENMP_DiagInitialize: read the log interval and divergence limit
+
+
+void OPENMP_DiagInitialize(float dx, float dy, float dz) {
+  const char *env=getenv("FLETCHER_DIAG_EVERY");
+  if (env != NULL && atoi(env) > 0)
+    every=atoi(env);
+  env=getenv("FLETCHER_DIAG_LIMIT");
+  if (env != NULL && atof(env) > 0.0)
+    limit=atof(env);
+  ddx=dx; ddy=dy; ddz=dz;
+  diverged=0;
+  printf("Fused diagnostics logged every %d steps; divergence above |p| %e\n", every, limit);
+}
+
+
+// OPENMP_DiagStep: diagnostics of step it; logs them and dumps the fields on divergence
+
+
+void OPENMP_DiagStep(int sx, int sy, int sz, int it,
+		     double energy, float pMax, int nonFinite,
+		     float *p, float *q) {
+
+  lastStep=it;
+  lastEnergy=energy;
+  lastMax=pMax;
+  peakMax=fmaxf(peakMax, pMax);
+
+  if (nonFinite == 0 && pMax <= limit) {
+    if (it%every == 0)
+      printf("diag: step %d energy %e max|p| %e\n", it, energy, pMax);
+    return;
+  }
+
+  // divergence: locate the first bad sample and dump both fields
+
+  printf("diag: step %d diverged: energy %e max|p| %e, %d non finite samples\n",
+	 it, energy, pMax, nonFinite);
+  for (int i=0; i<sx*sy*sz; i++)
+    if (!isfinite(p[i]) || fabsf(p[i]) > limit) {
+      int ix, iy, iz;
+      coord(i, sx, sy, sz, &ix, &iy, &iz);
+      printf("diag: first diverged sample p=%e at (%d,%d,%d)\n", p[i], ix, iy, iz);
+      break;
+    }
+  DumpFieldToFile(sx, sy, sz, 0, sx-1, 0, sy-1, 0, sz-1, ddx, ddy, ddz, p, "Diverged_p");
+  DumpFieldToFile(sx, sy, sz, 0, sx-1, 0, sy-1, 0, sz-1, ddx, ddy, ddz, q, "Diverged_q");
+  printf("diag: fields dumped to Diverged_p.rsf and Diverged_q.rsf\n");
+  diverged=it;
+}
+
+
+// OPENMP_DiagDiverged: step at which the fields diverged, 0 if they did not
+
+
+int OPENMP_DiagDiverged() {
+  return diverged;
+}
+
+
+// OPENMP_DiagFinalize: report the last diagnostics
+
+
+void OPENMP_DiagFinalize() {
+  printf("diag: last step %d energy %e max|p| %e; peak max|p| %e\n",
+	 lastStep, lastEnergy, lastMax, peakMax);
+}
+
+#endif
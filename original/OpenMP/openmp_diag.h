@@ -0,0 +1,49 @@
+#ifndef _OPENMP_DIAG
+#define _OPENMP_DIAG
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+
+// Fused wave field diagnostics (make DIAG=1).
+// The propagate kernel reduces, per thread and within its own loop, the energy (sum of
+// p^2+q^2), the largest |p| and the count of non finite samples of the new fields;
+// OpenMP combines the per thread values at the end of the step. Every DIAG_EVERY steps
+// ($FLETCHER_DIAG_EVERY) they are logged. A step with non finite samples or with |p|
+// above DIAG_LIMIT ($FLETCHER_DIAG_LIMIT) diverged: both fields are dumped to
+// Diverged_p.rsf and Diverged_q.rsf, and OPENMP_DiagDiverged tells the driver, that
+// stops stepping; the caller decides whether to abort.
+
+
+#define DIAG_EVERY 10         // steps between logged diagnostics
+#define DIAG_LIMIT 1.0e10f    // largest |p| of a stable run
+
+
+// OPENMP_DiagInitialize: read the log interval and divergence limit
+
+
+void OPENMP_DiagInitialize(float dx, float dy, float dz);
+
+
+// OPENMP_DiagStep: diagnostics of step it; logs them and dumps the fields on divergence
+
+
+void OPENMP_DiagStep(int sx, int sy, int sz, int it,
+		     double energy, float pMax, int nonFinite,
+		     float *p, float *q);
+
+
+// OPENMP_DiagDiverged: step at which the fields diverged, 0 if they did not
+
+
+int OPENMP_DiagDiverged();
+
+
+// OPENMP_DiagFinalize: report the last diagnostics
+
+
+void OPENMP_DiagFinalize();
+
+#endif
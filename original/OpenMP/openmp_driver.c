@@ -1,41 +1,103 @@
 #include "../driver.h"
 #include "openmp_propagate.h"
 #include "openmp_insertsource.h"
+#include "openmp_half.h"
+#include "openmp_jit.h"
+#include "openmp_time4.h"
+#include "openmp_diag.h"
+#include "../fletcher.h"
 #include "../sample.h"
 
 void DRIVER_Initialize(const int sx, const int sy, const int sz, const int bord,
 		       float dx, float dy, float dz, float dt,
 		       float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
-		       float * restrict phi, float * restrict theta,
+		       float * restrict phi, float * restrict theta, const CoefT *coef,
 		       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
 {
+#ifdef HALF
+	OPENMP_HalfInitialize(sx, sy, sz, pp, pc, qp, qc);
+#endif
+#ifdef JIT
+	OPENMP_JitInitialize(sx, sy, sz, bord, dx, dy, dz, dt, coef);
+#endif
+#if TIME_ORDER == 4
+	OPENMP_Time4Initialize(sx, sy, sz);
+#endif
+#ifdef DIAG
+	OPENMP_DiagInitialize(dx, dy, dz);
+#endif
 }
 
 
 void DRIVER_Finalize()
 {
+#ifdef HALF
+	OPENMP_HalfFinalize();
+#endif
+#ifdef JIT
+	OPENMP_JitFinalize();
+#endif
+#if TIME_ORDER == 4
+	OPENMP_Time4Finalize();
+#endif
+#ifdef DIAG
+	OPENMP_DiagFinalize();
+#endif
 }
 
 
 void DRIVER_Update_pointers(const int sx, const int sy, const int sz, float *pc)
 {
+#ifdef HALF
+	OPENMP_HalfUpdate(sx, sy, sz, pc);
+#endif
 }
 
 
 void DRIVER_Propagate(const int sx, const int sy, const int sz, const int bord,
 	       const float dx, const float dy, const float dz, const float dt, const int it, 
-	       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
 {
 
+#ifdef HALF
+	OPENMP_HalfPropagate (  sx,   sy,   sz,   bord,
+                                      dx,   dy,   dz,   dt,   it,   coef);
+#elif defined(JIT)
+	OPENMP_JitPropagate (coef,   pp,   pc,   qp,   qc);
+#elif TIME_ORDER == 4
+	OPENMP_Time4Propagate (  sx,   sy,   sz,   bord,
+                                       dx,   dy,   dz,   dt,   it,
+                                       coef,   pp,   pc,   qp,   qc);
+#else
 	OPENMP_Propagate (  sx,   sy,   sz,   bord,
                                   dx,   dy,   dz,   dt,   it,
-                                  pp,   pc,   qp,   qc);
+                                  coef,   pp,   pc,   qp,   qc);
+#endif
+#if defined(SOURCE_FORCING) && TIME_ORDER == 2
+	OPENMP_ApplyForcing(pp, qp);
+#endif
 
 }
 
 
+#ifdef DIAG
+int DRIVER_Diverged()
+{
+	return OPENMP_DiagDiverged();
+}
+#endif
+
+
 void DRIVER_InsertSource(float dt, int it, int iSource, float *p, float*q, float src)
 {
+#ifdef HALF
+        OPENMP_HalfInsertSource(iSource,src);
+#elif TIME_ORDER == 4
+        OPENMP_Time4InsertSource(dt,it,iSource,src);
+#elif defined(SOURCE_FORCING)
+        OPENMP_InsertForcing(iSource,src);
+#else
         OPENMP_InsertSource(dt,it,iSource,p,q,src);
+#endif
 }
 
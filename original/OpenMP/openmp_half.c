@@ -0,0 +1,238 @@
+#ifdef HALF
+
+#include "openmp_half.h"
+#include "../derivatives.h"
+#include "../map.h"
+#include "../trace.h"
+
+#ifdef BRICK
+#error "half precision storage (HALF) does not support bricked storage (BRICK)"
+#endif
+#ifdef SOURCE_FORCING
+#error "half precision storage (HALF) does not support the source as a forcing (SOURCE_FORCING)"
+#endif
+
+
+// half precision fields: hp[cur] and hq[cur] hold pc and qc, the others pp and qp
+
+static half_t *hp[2]={NULL, NULL};
+static half_t *hq[2]={NULL, NULL};
+static float pScale[2], qScale[2];   // stored value times scale is the field value
+static float pMax[2], qMax[2];       // maximum absolute field value
+static int cur=0;
+static long n=0;
+static int overflowReported=0;
+
+
+// NewScale: power of two scale that keeps bound at or below HALF_TARGET
+
+
+static float NewScale(float bound) {
+  int e;
+  if (!(bound > 0.0f) || isinf(bound))
+    return 1.0f;
+  frexpf(bound/HALF_TARGET, &e);
+  return ldexpf(1.0f, e);
+}
+
+
+// Encode: store arrF into arrH with a scale fitted to its maximum; returns the maximum
+
+
+static float Encode(const float *arrF, half_t *arrH, float *scale) {
+  float maxF=0.0f;
+#pragma omp parallel for reduction(max:maxF)
+  for (long i=0; i<n; i++)
+    maxF=fmaxf(maxF, fabsf(arrF[i]));
+  *scale=NewScale(maxF);
+  const float inv=1.0f/(*scale);
+#pragma omp parallel for
+  for (long i=0; i<n; i++)
+    arrH[i]=FloatToHalf(arrF[i]*inv);
+  return maxF;
+}
+
+
+// Rescale: re-encode arrH with a new scale
+
+
+static void Rescale(half_t *arrH, float *scale, float newScale) {
+  const float fac=(*scale)/newScale;
+#pragma omp parallel for
+  for (long i=0; i<n; i++)
+    arrH[i]=FloatToHalf(HalfToFloat(arrH[i])*fac);
+  *scale=newScale;
+}
+
+
+// OPENMP_HalfInitialize: allocate half precision fields and encode pp, pc, qp, qc
+
+
+void OPENMP_HalfInitialize(int sx, int sy, int sz,
+			   float *pp, float *pc, float *qp, float *qc) {
+  n=(long)sx*(long)sy*(long)sz;
+  for (int k=0; k<2; k++) {
+    hp[k]=(half_t *) malloc(n*sizeof(half_t));
+    hq[k]=(half_t *) malloc(n*sizeof(half_t));
+  }
+  cur=0;
+  pMax[cur]=Encode(pc, hp[cur], &pScale[cur]);
+  qMax[cur]=Encode(qc, hq[cur], &qScale[cur]);
+  pMax[1-cur]=Encode(pp, hp[1-cur], &pScale[1-cur]);
+  qMax[1-cur]=Encode(qp, hq[1-cur], &qScale[1-cur]);
+  overflowReported=0;
+
+  // per sample traffic: pc, qc read, pp, qp read and written, ten coefficient arrays read
+
+  printf("Wave fields stored in %s with per field scaling (unit roundoff %.2e); ",
+	 HALF_NAME, HALF_EPS);
+  printf("%d bytes per sample instead of %d\n",
+	 (int)(6*sizeof(half_t)+10*sizeof(float)), (int)(16*sizeof(float)));
+}
+
+
+// OPENMP_HalfPropagate: one time step over the half precision fields, that are swapped on exit
+
+
+void OPENMP_HalfPropagate(int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt, int it, const CoefT *coef) {
+
+  half_t * restrict pp=hp[1-cur];
+  half_t * restrict qp=hq[1-cur];
+  const half_t * restrict pc=hp[cur];
+  const half_t * restrict qc=hq[cur];
+  const float pcScale=pScale[cur];
+  const float qcScale=qScale[cur];
+  const float ppOldScale=pScale[1-cur];
+  const float qpOldScale=qScale[1-cur];
+
+  // |2*pc-pp| bounds the new field but for the (small) stencil term; a factor 2 covers it
+
+  const float ppNewScale=NewScale(2.0f*(2.0f*pMax[cur]+pMax[1-cur]));
+  const float qpNewScale=NewScale(2.0f*(2.0f*qMax[cur]+qMax[1-cur]));
+  const float ppNewInv=1.0f/ppNewScale;
+  const float qpNewInv=1.0f/qpNewScale;
+  float ppMax=0.0f;
+  float qpMax=0.0f;
+
+  const int nbx=(sx-2*bord+BLOCK_X-1)/BLOCK_X;
+  const int nby=(sy-2*bord+BLOCK_Y-1)/BLOCK_Y;
+  const int nbz=(sz-2*bord+BLOCK_Z-1)/BLOCK_Z;
+
+#define SAMPLE_TILE
+#define SAMPLE_HALF
+
+#define SAMPLE_PRE_LOOP
+#include "../sample.h"
+#undef SAMPLE_PRE_LOOP
+
+
+#pragma omp parallel reduction(max:ppMax,qpMax)
+  { // start omp
+
+    // each block decodes pc and qc with a stencil halo into private fp32 tiles
+
+    float tpc[TILE_VOL];
+    float tqc[TILE_VOL];
+
+#pragma omp for collapse(3)
+    for (int bz=0; bz<nbz; bz++) {
+      for (int by=0; by<nby; by++) {
+	for (int bx=0; bx<nbx; bx++) {
+
+	  TRACE_BEGIN(tTrace);
+	  const int txStart=bord+bx*BLOCK_X-TILE_HALO;
+	  const int tyStart=bord+by*BLOCK_Y-TILE_HALO;
+	  const int tzStart=bord+bz*BLOCK_Z-TILE_HALO;
+	  const int izEnd=(tzStart+TILE_Z < sz) ? tzStart+TILE_Z : sz;
+	  const int iyEnd=(tyStart+TILE_Y < sy) ? tyStart+TILE_Y : sy;
+	  const int ixEnd=(txStart+TILE_X < sx) ? txStart+TILE_X : sx;
+
+	  for (int iz=tzStart; iz<izEnd; iz++) {
+	    for (int iy=tyStart; iy<iyEnd; iy++) {
+	      const int t0=tind(0,iy-tyStart,iz-tzStart)-txStart;
+	      for (int ix=txStart; ix<ixEnd; ix++) {
+		tpc[t0+ix]=HalfToFloat(pc[ind(ix,iy,iz)])*pcScale;
+		tqc[t0+ix]=HalfToFloat(qc[ind(ix,iy,iz)])*qcScale;
+	      }
+	    }
+	  }
+
+	  for (int iz=tzStart+TILE_HALO; iz<izEnd-TILE_HALO; iz++) {
+	    for (int iy=tyStart+TILE_HALO; iy<iyEnd-TILE_HALO; iy++) {
+	      for (int ix=txStart+TILE_HALO; ix<ixEnd-TILE_HALO; ix++) {
+
+
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+
+
+	      }
+	    }
+	  }
+	  TRACE_END(tTrace, TRACE_KERNEL, (bz*nby+by)*nbx+bx);
+	}
+      }
+    }
+  } // end omp
+
+#undef SAMPLE_HALF
+#undef SAMPLE_TILE
+
+  if (!overflowReported && (ppMax*ppNewInv > HALF_MAX || qpMax*qpNewInv > HALF_MAX)) {
+    printf("**(OPENMP_HalfPropagate)**: %s overflow at step %d\n", HALF_NAME, it);
+    overflowReported=1;
+  }
+
+  pScale[1-cur]=ppNewScale;
+  qScale[1-cur]=qpNewScale;
+  pMax[1-cur]=ppMax;
+  qMax[1-cur]=qpMax;
+  cur=1-cur;
+}
+
+
+// OPENMP_HalfInsertSource: add src to the current p and q fields at iSource;
+//                          rescale the whole field if the new value does not fit
+
+
+void OPENMP_HalfInsertSource(int iSource, float src) {
+
+  const float p=HalfToFloat(hp[cur][iSource])*pScale[cur]+src;
+  const float q=HalfToFloat(hq[cur][iSource])*qScale[cur]+src;
+  if (fabsf(p) > HALF_TARGET*pScale[cur])
+    Rescale(hp[cur], &pScale[cur], NewScale(fabsf(p)));
+  if (fabsf(q) > HALF_TARGET*qScale[cur])
+    Rescale(hq[cur], &qScale[cur], NewScale(fabsf(q)));
+  hp[cur][iSource]=FloatToHalf(p/pScale[cur]);
+  hq[cur][iSource]=FloatToHalf(q/qScale[cur]);
+  pMax[cur]=fmaxf(pMax[cur], fabsf(p));
+  qMax[cur]=fmaxf(qMax[cur], fabsf(q));
+}
+
+
+// OPENMP_HalfUpdate: decode the current p field into pc
+
+
+void OPENMP_HalfUpdate(int sx, int sy, int sz, float *pc) {
+  const half_t * restrict h=hp[cur];
+  const float scale=pScale[cur];
+#pragma omp parallel for
+  for (long i=0; i<n; i++)
+    pc[i]=HalfToFloat(h[i])*scale;
+}
+
+
+// OPENMP_HalfFinalize: free half precision fields
+
+
+void OPENMP_HalfFinalize() {
+  for (int k=0; k<2; k++) {
+    free(hp[k]);
+    free(hq[k]);
+    hp[k]=hq[k]=NULL;
+  }
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef _OPENMP_HALF
+#define _OPENMP_HALF
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include "../coef.h"
+
+
+// Half precision storage of pp, pc, qp and qc (make HALF=fp16 or HALF=bf16).
+// Fields are kept as 16 bit values times a power of two scale per array, chosen
+// at every step from the field maxima so that stored values stay far from overflow
+// and underflow; all arithmetic is done in fp32 on a tile decoded by the kernel.
+
+
+#ifdef HALF_FP16
+
+typedef _Float16 half_t;
+
+#define HALF_NAME "fp16"
+#define HALF_EPS 4.8828125e-4f       // unit roundoff, 2^-11
+#define HALF_MAX 65504.0f            // largest finite value
+
+static inline float HalfToFloat(half_t h) {
+  return (float) h;
+}
+
+static inline half_t FloatToHalf(float f) {
+  return (half_t) f;
+}
+
+#else
+
+typedef uint16_t half_t;
+
+#define HALF_NAME "bf16"
+#define HALF_EPS 3.90625e-3f         // unit roundoff, 2^-8
+#define HALF_MAX 3.38953139e38f      // largest finite value
+
+static inline float HalfToFloat(half_t h) {
+  union {uint32_t u; float f;} v;
+  v.u=((uint32_t) h) << 16;
+  return v.f;
+}
+
+// round to nearest even; NaN stays NaN
+
+static inline half_t FloatToHalf(float f) {
+  union {uint32_t u; float f;} v;
+  v.f=f;
+  if ((v.u & 0x7fffffff) > 0x7f800000)
+    return (half_t) ((v.u >> 16) | 0x0040);
+  v.u+=0x7fff+((v.u >> 16) & 1);
+  return (half_t) (v.u >> 16);
+}
+
+#endif
+
+#define HALF_TARGET 16384.0f         // stored field maxima are scaled below this value
+
+
+// OPENMP_HalfInitialize: allocate half precision fields and encode pp, pc, qp, qc
+
+
+void OPENMP_HalfInitialize(int sx, int sy, int sz,
+			   float *pp, float *pc, float *qp, float *qc);
+
+
+// OPENMP_HalfPropagate: one time step over the half precision fields, that are swapped on exit
+
+
+void OPENMP_HalfPropagate(int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt, int it, const CoefT *coef);
+
+
+// OPENMP_HalfInsertSource: add src to the current p and q fields at iSource
+
+
+void OPENMP_HalfInsertSource(int iSource, float src);
+
+
+// OPENMP_HalfUpdate: decode the current p field into pc
+
+
+void OPENMP_HalfUpdate(int sx, int sy, int sz, float *pc);
+
+
+// OPENMP_HalfFinalize: free half precision fields
+
+
+void OPENMP_HalfFinalize();
+
+#endif
@@ -11,3 +11,31 @@ void OPENMP_InsertSource(float dt, int it, int iSource,
      q[iSource]+=src;
   }
 }
+
+
+// forcing of the next step, times dt^2
+
+static int forceIndex=-1;
+static float forceDt2=0.0f;
+
+
+// OPENMP_InsertForcing: with SOURCE_FORCING, source src=Source(dt,it) at iSource as the
+//                       leapfrog forcing src/dt^2 at time it, applied by the next step
+
+
+void OPENMP_InsertForcing(int iSource, float src) {
+  forceIndex=iSource;
+  forceDt2=src;
+}
+
+
+// OPENMP_ApplyForcing: add the forcing to p and q, the fields just computed by the step
+
+
+void OPENMP_ApplyForcing(float *p, float *q) {
+  if (forceIndex >= 0) {
+    p[forceIndex]+=forceDt2;
+    q[forceIndex]+=forceDt2;
+    forceIndex=-1;
+  }
+}
@@ -9,4 +9,17 @@
 void OPENMP_InsertSource(float dt, int it, int iSource, 
 		         float *p, float *q, float src);
 
+
+// OPENMP_InsertForcing: with SOURCE_FORCING, source src=Source(dt,it) at iSource as the
+//                       leapfrog forcing src/dt^2 at time it, applied by the next step
+
+
+void OPENMP_InsertForcing(int iSource, float src);
+
+
+// OPENMP_ApplyForcing: add the forcing to p and q, the fields just computed by the step
+
+
+void OPENMP_ApplyForcing(float *p, float *q);
+
 #endif
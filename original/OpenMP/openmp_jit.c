@@ -0,0 +1,339 @@
+#ifdef JIT
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "openmp_jit.h"
+#include "openmp_propagate.h"
+#include "../map.h"
+#include "../sample.h"
+#include "../metrics.h"
+#include "../walltime.h"
+
+#if defined(BRICK) || defined(HALF)
+#error "run time specialized kernel (JIT) does not support BRICK or HALF"
+#endif
+#ifdef NONUNIFORM_Z
+#error "run time specialized kernel (JIT) does not support a stretched z axis (NONUNIFORM_Z)"
+#endif
+
+
+#define JIT_CALIB_STEPS 3   // steps of each kernel timed at initialization
+#define JIT_PATH 4096
+#define JIT_ARGS 256        // words of the compile command
+
+
+typedef void (*JitKernel)(const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
+
+static void *handle=NULL;
+static JitKernel kernel=NULL;
+static double kernelTime=0.0;
+static int nSteps=0;
+
+
+// Hash: 64 bit FNV-1a of len bytes, continuing from h
+
+
+static uint64_t Hash(uint64_t h, const char *bytes, size_t len) {
+  for (size_t k=0; k<len; k++) {
+    h^=(unsigned char) bytes[k];
+    h*=0x100000001b3ULL;
+  }
+  return h;
+}
+
+
+// HashFile: continue hash h with the contents of file name
+
+
+static uint64_t HashFile(uint64_t h, const char *name) {
+  char buf[4096];
+  size_t len;
+  FILE *fp=fopen(name, "r");
+  if (fp == NULL) {
+    printf("OPENMP_JitInitialize: cannot read %s\n", name);
+    exit(-1);
+  }
+  while ((len=fread(buf, 1, sizeof(buf), fp)) > 0)
+    h=Hash(h, buf, len);
+  fclose(fp);
+  return h;
+}
+
+
+// Private: 1 if name (not followed if a link) is a directory (dir) or regular file owned
+//          by this user that no one else can write
+
+
+static int Private(const char *name, int dir) {
+  struct stat st;
+  if (lstat(name, &st) != 0)
+    return 0;
+  if (dir ? !S_ISDIR(st.st_mode) : !S_ISREG(st.st_mode))
+    return 0;
+  return st.st_uid == geteuid() && (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+
+// CacheDir: private cache directory, $FLETCHER_JIT_DIR, $XDG_CACHE_HOME/fletcher_jit or
+//           $HOME/.cache/fletcher_jit, created with mode 0700 if missing; a new temporary
+//           directory, that is not kept across runs, without a home
+
+
+static void CacheDir(char *dir) {
+  const char *env=getenv("FLETCHER_JIT_DIR");
+  const char *xdg=getenv("XDG_CACHE_HOME");
+  const char *home=getenv("HOME");
+  if (env != NULL && env[0] != '\0')
+    snprintf(dir, JIT_PATH, "%s", env);
+  else if (xdg != NULL && xdg[0] == '/')
+    snprintf(dir, JIT_PATH, "%s/fletcher_jit", xdg);
+  else if (home != NULL && home[0] == '/') {
+    snprintf(dir, JIT_PATH, "%s/.cache", home);
+    mkdir(dir, 0700);
+    snprintf(dir, JIT_PATH, "%s/.cache/fletcher_jit", home);
+  } else {
+    snprintf(dir, JIT_PATH, "/tmp/fletcher_jit.XXXXXX");
+    if (mkdtemp(dir) == NULL) {
+      printf("OPENMP_JitInitialize: cannot create a temporary cache directory\n");
+      exit(-1);
+    }
+  }
+  if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+    printf("OPENMP_JitInitialize: cannot create cache directory %s\n", dir);
+    exit(-1);
+  }
+  if (!Private(dir, 1)) {
+    printf("OPENMP_JitInitialize: cache directory %s is not a directory of this user that only it can write\n", dir);
+    exit(-1);
+  }
+}
+
+
+// Compile: run the compile command on srcName into soName, without a shell; 1 if it succeeded
+
+
+static int Compile(const char *compile, const char *soName, const char *srcName) {
+  char words[JIT_PATH];
+  char *argv[JIT_ARGS];
+  int argc=0;
+  snprintf(words, JIT_PATH, "%s", compile);
+  char *save;
+  for (char *w=strtok_r(words, " \t", &save); w != NULL && argc < JIT_ARGS-4; w=strtok_r(NULL, " \t", &save))
+    argv[argc++]=w;
+  argv[argc++]="-o";
+  argv[argc++]=(char *) soName;
+  argv[argc++]=(char *) srcName;
+  argv[argc]=NULL;
+
+  fflush(stdout);
+  const pid_t pid=fork();
+  if (pid < 0)
+    return 0;
+  if (pid == 0) {
+    execvp(argv[0], argv);
+    _exit(127);
+  }
+  int status;
+  while (waitpid(pid, &status, 0) < 0)
+    if (errno != EINTR)
+      return 0;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+
+// GridClass: cheapest sample variant (TILE_ISO, TILE_VTI, TILE_TTI) exact at all internal points
+
+
+static int GridClass(int sx, int sy, int sz, int bord, const CoefT *coef) {
+  const float *ch1dxx=coef->ch1dxx, *ch1dyy=coef->ch1dyy, *ch1dzz=coef->ch1dzz;
+  const float *ch1dxy=coef->ch1dxy, *ch1dyz=coef->ch1dyz, *ch1dxz=coef->ch1dxz;
+  const float *v2sz=coef->v2sz;
+  int tilted=0, coupled=0;
+  for (int iz=bord; iz<sz-bord; iz++) {
+    for (int iy=bord; iy<sy-bord; iy++) {
+      for (int ix=bord; ix<sx-bord; ix++) {
+	const int i=ind(ix,iy,iz);
+	tilted |= ch1dxx[i]!=0.0f || ch1dyy[i]!=0.0f || ch1dzz[i]!=1.0f ||
+	          ch1dxy[i]!=0.0f || ch1dyz[i]!=0.0f || ch1dxz[i]!=0.0f;
+	coupled |= v2sz[i]!=0.0f;
+      }
+    }
+  }
+  return tilted ? TILE_TTI : (coupled ? TILE_VTI : TILE_ISO);
+}
+
+
+// Generate: write the kernel source into fp; floats are written in hexadecimal to be exact
+
+
+static void Generate(FILE *fp, int sx, int sy, int sz, int bord,
+		     float dx, float dy, float dz, float dt, int class) {
+  static const char *className[3]={"ISO", "VTI", "TTI"};
+
+  fprintf(fp, "// propagate kernel generated by OPENMP_JitInitialize\n");
+  fprintf(fp, "// grid %dx%dx%d, border %d, %s\n\n", sx, sy, sz, bord, className[class]);
+  fprintf(fp, "#include <math.h>\n");
+  fprintf(fp, "#include \"%s/derivatives.h\"\n", JIT_SRCDIR);
+  fprintf(fp, "#include \"%s/map.h\"\n", JIT_SRCDIR);
+  fprintf(fp, "#include \"%s/coef.h\"\n\n", JIT_SRCDIR);
+  if (class == TILE_ISO)
+    fprintf(fp, "#define SAMPLE_ISO\n\n");
+  else if (class == TILE_VTI)
+    fprintf(fp, "#define SAMPLE_VTI\n\n");
+  fprintf(fp, "void JitPropagate(const CoefT *coef, float * restrict pp, float * restrict pc, "
+	  "float * restrict qp, float * restrict qc) {\n\n");
+  fprintf(fp, "  const int sx=%d;\n  const int sy=%d;\n  const int sz=%d;\n  const int bord=%d;\n",
+	  sx, sy, sz, bord);
+  fprintf(fp, "  const float dx=%af;\n  const float dy=%af;\n  const float dz=%af;\n  const float dt=%af;\n\n",
+	  dx, dy, dz, dt);
+  fprintf(fp, "#define SAMPLE_PRE_LOOP\n#include \"%s/sample.h\"\n#undef SAMPLE_PRE_LOOP\n\n", JIT_SRCDIR);
+  fprintf(fp, "#pragma omp parallel for\n");
+  fprintf(fp, "  for (int iz=bord; iz<sz-bord; iz++) {\n");
+  fprintf(fp, "    for (int iy=bord; iy<sy-bord; iy++) {\n");
+  fprintf(fp, "      for (int ix=bord; ix<sx-bord; ix++) {\n\n");
+  fprintf(fp, "#define SAMPLE_LOOP\n#include \"%s/sample.h\"\n#undef SAMPLE_LOOP\n\n", JIT_SRCDIR);
+  fprintf(fp, "      }\n    }\n  }\n}\n");
+}
+
+
+// OPENMP_JitInitialize: generate, compile (or find in cache) and load the kernel;
+//                       compare its speed with OPENMP_Propagate
+
+
+void OPENMP_JitInitialize(int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt, const CoefT *coef) {
+
+  const double t0=wtime();
+
+  // kernel source in memory, to hash it before touching the cache
+
+  char *src=NULL;
+  size_t srcLen=0;
+  FILE *mem=open_memstream(&src, &srcLen);
+  const int class=GridClass(sx, sy, sz, bord, coef);
+  long samples[3]={0, 0, 0};
+  samples[class]=(long)(sx-2*bord)*(sy-2*bord)*(sz-2*bord);
+  MetricsClasses(samples);
+  Generate(mem, sx, sy, sz, bord, dx, dy, dz, dt, class);
+  fclose(mem);
+
+  char dir[JIT_PATH];
+  CacheDir(dir);
+
+  // the key covers the source, the compile command and the included headers
+
+  const char *compile=JIT_CC " " JIT_CFLAGS " -fPIC -shared";
+  uint64_t key=Hash(0xcbf29ce484222325ULL, src, srcLen);
+  key=Hash(key, compile, strlen(compile));
+  key=HashFile(key, JIT_SRCDIR "/sample.h");
+  key=HashFile(key, JIT_SRCDIR "/coef.h");
+  key=HashFile(key, JIT_SRCDIR "/derivatives.h");
+  key=HashFile(key, JIT_SRCDIR "/map.h");
+
+  char srcName[JIT_PATH], soName[JIT_PATH], tmpName[JIT_PATH];
+  snprintf(srcName, JIT_PATH, "%s/kernel_%016llx.c", dir, (unsigned long long) key);
+  snprintf(soName, JIT_PATH, "%s/kernel_%016llx.so", dir, (unsigned long long) key);
+  snprintf(tmpName, JIT_PATH, "%s.%d", soName, (int) getpid());
+
+  struct stat st;
+  const int cached=(lstat(soName, &st) == 0);
+  if (!cached) {
+    FILE *fp=fopen(srcName, "w");
+    if (fp == NULL) {
+      printf("OPENMP_JitInitialize: cannot write %s\n", srcName);
+      exit(-1);
+    }
+    fwrite(src, 1, srcLen, fp);
+    fclose(fp);
+
+    // compile to a private name and rename, so concurrent runs never load a partial object
+
+    if (!Compile(compile, tmpName, srcName) || rename(tmpName, soName) != 0) {
+      printf("OPENMP_JitInitialize: compilation failed: %s -o %s %s\n", compile, tmpName, srcName);
+      exit(-1);
+    }
+  }
+  free(src);
+
+  // only a kernel of this user that no one else could have changed is loaded
+
+  if (!Private(soName, 0)) {
+    printf("OPENMP_JitInitialize: %s is not a file of this user that only it can write\n", soName);
+    exit(-1);
+  }
+
+  handle=dlopen(soName, RTLD_NOW);
+  if (handle == NULL) {
+    printf("OPENMP_JitInitialize: %s\n", dlerror());
+    exit(-1);
+  }
+  kernel=(JitKernel) dlsym(handle, "JitPropagate");
+  if (kernel == NULL) {
+    printf("OPENMP_JitInitialize: %s\n", dlerror());
+    exit(-1);
+  }
+  const double tJit=wtime()-t0;
+
+  printf("JIT kernel %s: %s in %.3lf s\n", soName, cached ? "loaded from cache" : "compiled", tJit);
+
+  // best of a few steps of each kernel over scratch fields of normal (not subnormal) values
+
+  const long n=(long)sx*(long)sy*(long)sz;
+  float *p0=(float *) malloc(n*sizeof(float));
+  float *p1=(float *) malloc(n*sizeof(float));
+  float *q0=(float *) malloc(n*sizeof(float));
+  float *q1=(float *) malloc(n*sizeof(float));
+  for (long i=0; i<n; i++) {
+    p0[i]=q0[i]=1.0f+sinf(1.0e-3f*i);
+    p1[i]=q1[i]=1.0f+cosf(1.0e-3f*i);
+  }
+  double tGeneric=1.0e30, tSpecial=1.0e30;
+  for (int k=0; k<JIT_CALIB_STEPS; k++) {
+    double t=wtime();
+    OPENMP_Propagate(sx, sy, sz, bord, dx, dy, dz, dt, k, coef, p0, p1, q0, q1);
+    t=wtime()-t;
+    if (t < tGeneric) tGeneric=t;
+    t=wtime();
+    kernel(coef, p0, p1, q0, q1);
+    t=wtime()-t;
+    if (t < tSpecial) tSpecial=t;
+  }
+  free(p0);
+  free(p1);
+  free(q0);
+  free(q1);
+
+  printf("JIT kernel step %.3lf ms, generic kernel step %.3lf ms: speedup %.2lf\n",
+	 1.0e3*tSpecial, 1.0e3*tGeneric, tGeneric/tSpecial);
+}
+
+
+// OPENMP_JitPropagate: one time step with the loaded kernel
+
+
+void OPENMP_JitPropagate(const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+  const double t0=wtime();
+  kernel(coef, pp, pc, qp, qc);
+  kernelTime+=wtime()-t0;
+  nSteps++;
+}
+
+
+// OPENMP_JitFinalize: report kernel time and unload it
+
+
+void OPENMP_JitFinalize() {
+  if (nSteps > 0)
+    printf("JIT kernel: %d steps, %.3lf ms per step\n", nSteps, 1.0e3*kernelTime/nSteps);
+  dlclose(handle);
+  handle=NULL;
+  kernel=NULL;
+  kernelTime=0.0;
+  nSteps=0;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef _OPENMP_JIT
+#define _OPENMP_JIT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "../coef.h"
+
+
+// Run time specialized propagate kernel (make JIT=1).
+// At initialization a C kernel is generated with grid sizes, border, dx, dy, dz, dt
+// and the formulation of the whole model as compile time constants, compiled by the
+// system compiler into a shared object kept in a cache directory under the hash of its
+// source, compile command and headers, and loaded with dlopen. The cache directory is
+// $FLETCHER_JIT_DIR, $XDG_CACHE_HOME/fletcher_jit or $HOME/.cache/fletcher_jit; it and
+// the kernels must belong to the user and be writable only by the user.
+
+
+// OPENMP_JitInitialize: generate, compile (or find in cache) and load the kernel;
+//                       compare its speed with OPENMP_Propagate
+
+
+void OPENMP_JitInitialize(int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt, const CoefT *coef);
+
+
+// OPENMP_JitPropagate: one time step with the loaded kernel
+
+
+void OPENMP_JitPropagate(const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
+
+
+// OPENMP_JitFinalize: report kernel time and unload it
+
+
+void OPENMP_JitFinalize();
+
+#endif
@@ -1,6 +1,52 @@
+#include <string.h>
 #include "openmp_propagate.h"
 #include "../derivatives.h"
 #include "../map.h"
+#include "openmp_diag.h"
+#include "../trace.h"
+
+#ifdef SPECIALIZE
+#if defined(BRICK) || defined(HALF)
+#error "per tile specialization (SPECIALIZE) does not support BRICK or HALF"
+#endif
+#endif
+
+
+#ifdef BRICK
+#if TILE_HALO > BRICK_X
+#error "BRICK needs bricks at least as wide as the stencil radius"
+#endif
+
+
+// GatherPlanes: planes tz0..TILE_Z-1 of the tile of brick (bx,by,bz) from the bricked
+//               field f; each tile row is copied from one row of the brick and of its
+//               x neighbours. Tile points outside the grid are left unset
+
+
+static void GatherPlanes(int sx, int sy, int sz, int bx, int by, int bz, int tz0,
+			 const float * restrict f, float * restrict t) {
+  const int nbx=sx/BRICK_X, nby=sy/BRICK_Y;
+  for (int tz=tz0; tz<TILE_Z; tz++) {
+    const int iz=bz*BRICK_Z-TILE_HALO+tz;
+    if (iz<0 || iz>=sz) continue;
+    for (int ty=0; ty<TILE_Y; ty++) {
+      const int iy=by*BRICK_Y-TILE_HALO+ty;
+      if (iy<0 || iy>=sy) continue;
+      const float *row=f+((long)((iz/BRICK_Z)*nby+iy/BRICK_Y)*nbx+bx)*BRICK_VOL+
+	((iz%BRICK_Z)*BRICK_Y+iy%BRICK_Y)*BRICK_X;
+      float *trow=t+tind(0,ty,tz);
+      if (bx > 0)
+	for (int tx=0; tx<TILE_HALO; tx++)
+	  trow[tx]=row[tx-BRICK_VOL+BRICK_X-TILE_HALO];
+      for (int tx=0; tx<BRICK_X; tx++)
+	trow[TILE_HALO+tx]=row[tx];
+      if (bx < nbx-1)
+	for (int tx=0; tx<TILE_HALO; tx++)
+	  trow[TILE_HALO+BRICK_X+tx]=row[tx+BRICK_VOL];
+    }
+  }
+}
+#endif
 
 
 // Propagate: using Fletcher's equations, propagate waves one dt,
@@ -8,23 +54,169 @@
 
 void OPENMP_Propagate(int sx, int sy, int sz, int bord,
 	       float dx, float dy, float dz, float dt, int it, 
-	       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+
 
+#ifdef BRICK
+#define SAMPLE_TILE
+#endif
 
 #define SAMPLE_PRE_LOOP
 #include "../sample.h"
 #undef SAMPLE_PRE_LOOP
 
-
+#ifdef DIAG
+#define SAMPLE_DIAG
+  double diagEnergy=0.0;
+  float diagMax=0.0f;
+  int diagNonFinite=0;
+#pragma omp parallel reduction(+:diagEnergy,diagNonFinite) reduction(max:diagMax)
+#else
 #pragma omp parallel
+#endif
   { // start omp
 
     // solve both equations in all internal grid points, 
     // including absortion zone
     
     
+#ifdef BRICK
+
+    // each brick gathers pc and qc with a stencil halo into a private
+    // row-major tile; coefficients and outputs stay in bricked layout.
+    // Threads walk whole columns of bricks along z, so consecutive tiles
+    // share 2*TILE_HALO planes: those are shifted down and only the
+    // BRICK_Z new planes are gathered
+
+    float tpc[TILE_VOL];
+    float tqc[TILE_VOL];
+    const int tileShift=BRICK_Z*TILE_X*TILE_Y;
+
+#pragma omp for collapse(2) schedule(dynamic)
+    for (int by=0; by<sy/BRICK_Y; by++) {
+      for (int bx=0; bx<sx/BRICK_X; bx++) {
+	for (int bz=0; bz<sz/BRICK_Z; bz++) {
+
+	  TRACE_BEGIN(tTrace);
+	  const int txStart=bx*BRICK_X-TILE_HALO;
+	  const int tyStart=by*BRICK_Y-TILE_HALO;
+	  const int tzStart=bz*BRICK_Z-TILE_HALO;
+
+	  // tile points outside the grid are only read by border points, never computed
+
+	  if (bz == 0) {
+	    GatherPlanes(sx, sy, sz, bx, by, bz, 0, pc, tpc);
+	    GatherPlanes(sx, sy, sz, bx, by, bz, 0, qc, tqc);
+	  } else {
+	    memmove(tpc, tpc+tileShift, (TILE_VOL-tileShift)*sizeof(float));
+	    memmove(tqc, tqc+tileShift, (TILE_VOL-tileShift)*sizeof(float));
+	    GatherPlanes(sx, sy, sz, bx, by, bz, TILE_Z-BRICK_Z, pc, tpc);
+	    GatherPlanes(sx, sy, sz, bx, by, bz, TILE_Z-BRICK_Z, qc, tqc);
+	  }
+
+	  const int izEnd=((bz+1)*BRICK_Z < sz-bord) ? (bz+1)*BRICK_Z : sz-bord;
+	  const int iyEnd=((by+1)*BRICK_Y < sy-bord) ? (by+1)*BRICK_Y : sy-bord;
+	  const int ixEnd=((bx+1)*BRICK_X < sx-bord) ? (bx+1)*BRICK_X : sx-bord;
+	  for (int iz=(bz*BRICK_Z > bord) ? bz*BRICK_Z : bord; iz<izEnd; iz++) {
+	    for (int iy=(by*BRICK_Y > bord) ? by*BRICK_Y : bord; iy<iyEnd; iy++) {
+	      for (int ix=(bx*BRICK_X > bord) ? bx*BRICK_X : bord; ix<ixEnd; ix++) {
+
+
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+
+
+	      }
+	    }
+	  }
+	  TRACE_END(tTrace, TRACE_KERNEL, (bz*(sy/BRICK_Y)+by)*(sx/BRICK_X)+bx);
+	}
+      }
+    }
+
+#elif defined(SPECIALIZE)
+
+    // each block runs the cheapest sample variant that is exact at all its points,
+    // as classified by MODEL_INITIALIZE; the three loops differ only on sample.h
+
+    const int nbx=(sx-2*bord+BLOCK_X-1)/BLOCK_X;
+    const int nby=(sy-2*bord+BLOCK_Y-1)/BLOCK_Y;
+    const int nbz=(sz-2*bord+BLOCK_Z-1)/BLOCK_Z;
+
+#pragma omp for collapse(3) schedule(dynamic)
+    for (int bz=0; bz<nbz; bz++) {
+      for (int by=0; by<nby; by++) {
+	for (int bx=0; bx<nbx; bx++) {
+
+	  const int ixStart=bord+bx*BLOCK_X;
+	  const int iyStart=bord+by*BLOCK_Y;
+	  const int izStart=bord+bz*BLOCK_Z;
+	  const int ixEnd=(ixStart+BLOCK_X < sx-bord) ? ixStart+BLOCK_X : sx-bord;
+	  const int iyEnd=(iyStart+BLOCK_Y < sy-bord) ? iyStart+BLOCK_Y : sy-bord;
+	  const int izEnd=(izStart+BLOCK_Z < sz-bord) ? izStart+BLOCK_Z : sz-bord;
+
+	  TRACE_BEGIN(tTrace);
+	  switch (tileClass[(bz*nby+by)*nbx+bx]) {
+	  case TILE_ISO:
+	    for (int iz=izStart; iz<izEnd; iz++) {
+	      for (int iy=iyStart; iy<iyEnd; iy++) {
+		for (int ix=ixStart; ix<ixEnd; ix++) {
+
+
+#define SAMPLE_ISO
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+#undef SAMPLE_ISO
+
+
+		}
+	      }
+	    }
+	    break;
+	  case TILE_VTI:
+	    for (int iz=izStart; iz<izEnd; iz++) {
+	      for (int iy=iyStart; iy<iyEnd; iy++) {
+		for (int ix=ixStart; ix<ixEnd; ix++) {
+
+
+#define SAMPLE_VTI
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+#undef SAMPLE_VTI
+
+
+		}
+	      }
+	    }
+	    break;
+	  default:
+	    for (int iz=izStart; iz<izEnd; iz++) {
+	      for (int iy=iyStart; iy<iyEnd; iy++) {
+		for (int ix=ixStart; ix<ixEnd; ix++) {
+
+
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+
+
+		}
+	      }
+	    }
+	  }
+	  TRACE_END(tTrace, TRACE_KERNEL, (bz*nby+by)*nbx+bx);
+	}
+      }
+    }
+
+#else
+
 #pragma omp for
     for (int iz=bord; iz<sz-bord; iz++) {
+      TRACE_BEGIN(tTrace);
       for (int iy=bord; iy<sy-bord; iy++) {
 	for (int ix=bord; ix<sx-bord; ix++) {
 
@@ -36,6 +228,14 @@ void OPENMP_Propagate(int sx, int sy, int sz, int bord,
 
 	}
       }
+      TRACE_END(tTrace, TRACE_KERNEL, iz);
     }
+
+#endif
   } // end omp
+
+#ifdef DIAG
+#undef SAMPLE_DIAG
+  OPENMP_DiagStep(sx, sy, sz, it, diagEnergy, diagMax, diagNonFinite, pp, qp);
+#endif
 }
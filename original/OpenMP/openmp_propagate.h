@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include "../coef.h"
 
 // Propagate: using Fletcher's equations, propagate waves one dt,
 //            either forward or backward in time
@@ -12,6 +13,6 @@
 
 void OPENMP_Propagate(int sx, int sy, int sz, int bord,
 	       float dx, float dy, float dz, float dt, int it, 
-	       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
 
 #endif
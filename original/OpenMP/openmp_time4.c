@@ -0,0 +1,150 @@
+#include "../fletcher.h"
+
+#if TIME_ORDER == 4
+
+#include "openmp_time4.h"
+#include "../derivatives.h"
+#include "../map.h"
+#include "../source.h"
+#include "openmp_diag.h"
+#include "../trace.h"
+
+#if defined(BRICK) || defined(HALF) || defined(SPECIALIZE) || defined(JIT)
+#error "4th order time integration (TIME_ORDER=4) does not support BRICK, HALF, SPECIALIZE or JIT"
+#endif
+
+
+// rhs of p and q at the current time, L p and L q
+
+static float *rp=NULL;
+static float *rq=NULL;
+
+// source of the next step: forcing and its second time derivative
+
+static int srcIndex=-1;
+static float srcForce=0.0f;
+static float srcForce2=0.0f;
+
+
+// OPENMP_Time4Initialize: allocate the rhs arrays, null at borders
+
+
+void OPENMP_Time4Initialize(int sx, int sy, int sz) {
+  const long n=(long)sx*(long)sy*(long)sz;
+  rp=(float *) calloc(n, sizeof(float));
+  rq=(float *) calloc(n, sizeof(float));
+  if (rp == NULL || rq == NULL) {
+    printf("OPENMP_Time4Initialize: allocation of rhs arrays failed\n");
+    exit(-1);
+  }
+  printf("4th order time integration: two stencil passes per step\n");
+}
+
+
+// OPENMP_Time4Propagate: one 4th order time step
+
+
+void OPENMP_Time4Propagate(int sx, int sy, int sz, int bord,
+			   float dx, float dy, float dz, float dt, int it,
+			   const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+
+#define SAMPLE_PRE_LOOP
+#include "../sample.h"
+#undef SAMPLE_PRE_LOOP
+
+#ifdef DIAG
+#define SAMPLE_DIAG
+  double diagEnergy=0.0;
+  float diagMax=0.0f;
+  int diagNonFinite=0;
+#pragma omp parallel reduction(+:diagEnergy,diagNonFinite) reduction(max:diagMax)
+#else
+#pragma omp parallel
+#endif
+  { // start omp
+
+    // first pass: rhs of both equations at current time
+
+#pragma omp for
+    for (int iz=bord; iz<sz-bord; iz++) {
+      TRACE_BEGIN(tTrace);
+      for (int iy=bord; iy<sy-bord; iy++) {
+	for (int ix=bord; ix<sx-bord; ix++) {
+
+
+#define SAMPLE_RHS
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+#undef SAMPLE_RHS
+
+
+	}
+      }
+      TRACE_END(tTrace, TRACE_RHS, iz);
+    }
+
+    // forcing joins the rhs, so that the second pass also applies L to it
+
+#pragma omp single
+    if (srcIndex >= 0) {
+      rp[srcIndex]+=srcForce;
+      rq[srcIndex]+=srcForce;
+    }
+
+    // second pass, after the implicit barrier: operator applied to the rhs and update
+
+#pragma omp for
+    for (int iz=bord; iz<sz-bord; iz++) {
+      TRACE_BEGIN(tTrace);
+      for (int iy=bord; iy<sy-bord; iy++) {
+	for (int ix=bord; ix<sx-bord; ix++) {
+
+
+#define SAMPLE_TIME4
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+#undef SAMPLE_TIME4
+
+
+	}
+      }
+      TRACE_END(tTrace, TRACE_KERNEL, iz);
+    }
+  } // end omp
+
+  if (srcIndex >= 0) {
+    pp[srcIndex]+=srcForce2*dt*dt*dt*dt*(1.0f/12.0f);
+    qp[srcIndex]+=srcForce2*dt*dt*dt*dt*(1.0f/12.0f);
+    srcIndex=-1;
+  }
+
+#ifdef DIAG
+#undef SAMPLE_DIAG
+  OPENMP_DiagStep(sx, sy, sz, it, diagEnergy, diagMax, diagNonFinite, pp, qp);
+#endif
+}
+
+
+// OPENMP_Time4InsertSource: source src=Source(dt,it) at iSource, applied by the next step;
+//                           the forcing src/dt^2 keeps the amplitude of the leapfrog scheme
+
+
+void OPENMP_Time4InsertSource(float dt, int it, int iSource, float src) {
+  srcIndex=iSource;
+  srcForce=src/(dt*dt);
+  srcForce2=(Source(dt, it+1)-2.0f*src+Source(dt, it-1))/(dt*dt*dt*dt);
+}
+
+
+// OPENMP_Time4Finalize: free the rhs arrays
+
+
+void OPENMP_Time4Finalize() {
+  free(rp);
+  free(rq);
+  rp=rq=NULL;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _OPENMP_TIME4
+#define _OPENMP_TIME4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "../coef.h"
+
+
+// 4th order time integration by the modified equation (make TIME_ORDER=4):
+//   u(t+dt) = 2u(t) - u(t-dt) + dt^2 L u(t) + dt^4/12 L(L u(t))
+// where L is the spatial operator of Fletcher's equations. A first pass stores
+// L u(t) of p and q in internal arrays, a second pass applies L to them and updates.
+// It costs two stencil passes per step but is stable for sqrt(3) times larger dt.
+// The source enters as the forcing f=src/dt^2 at its own time, with the matching
+// dt^4/12 (L f + f'') terms, instead of being added to the current field: added to the
+// field, it acts one step late, which limits any integrator to first order.
+
+
+// OPENMP_Time4Initialize: allocate the rhs arrays, null at borders
+
+
+void OPENMP_Time4Initialize(int sx, int sy, int sz);
+
+
+// OPENMP_Time4Propagate: one 4th order time step
+
+
+void OPENMP_Time4Propagate(int sx, int sy, int sz, int bord,
+			   float dx, float dy, float dz, float dt, int it,
+			   const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
+
+
+// OPENMP_Time4InsertSource: source src=Source(dt,it) at iSource, applied by the next step
+
+
+void OPENMP_Time4InsertSource(float dt, int it, int iSource, float src);
+
+
+// OPENMP_Time4Finalize: free the rhs arrays
+
+
+void OPENMP_Time4Finalize();
+
+#endif
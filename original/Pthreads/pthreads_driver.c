@@ -0,0 +1,59 @@
+#include "../driver.h"
+#include "pthreads_propagate.h"
+#include "pthreads_insertsource.h"
+#include "../sample.h"
+
+static int sourceIndex=-1;          // source the pool was told of
+
+
+void DRIVER_Initialize(const int sx, const int sy, const int sz, const int bord,
+		       float dx, float dy, float dz, float dt,
+		       float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
+		       float * restrict phi, float * restrict theta, const CoefT *coef,
+		       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
+{
+	PTHREADS_Initialize(sx, sy, sz, bord, dx, dy, dz, dt);
+	sourceIndex=-1;
+}
+
+
+void DRIVER_Finalize()
+{
+	PTHREADS_Finalize();
+}
+
+
+// wave fields are shared with the host; only wait for the slabs still running
+
+
+void DRIVER_Update_pointers(const int sx, const int sy, const int sz, float *pc)
+{
+	PTHREADS_WaitAll();
+}
+
+
+void DRIVER_Propagate(const int sx, const int sy, const int sz, const int bord,
+	       const float dx, const float dy, const float dz, const float dt, const int it, 
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
+{
+
+	PTHREADS_Propagate (  sx,   sy,   sz,   bord,
+                                  dx,   dy,   dz,   dt,   it,
+                                  coef,   pp,   pc,   qp,   qc);
+
+}
+
+
+// PTHREADS_Propagate returns once the source slab finished the step,
+// so the source can be inserted while other slabs still run; the slab is
+// found again whenever the pool is rebuilt or the source moves
+
+
+void DRIVER_InsertSource(float dt, int it, int iSource, float *p, float*q, float src)
+{
+	if (iSource != sourceIndex) {
+	  PTHREADS_SourceSlab(iSource);
+	  sourceIndex=iSource;
+	}
+        PTHREADS_InsertSource(dt,it,iSource,p,q,src);
+}
@@ -0,0 +1,14 @@
+#include "pthreads_insertsource.h"
+
+
+// InsertSource: compute and insert source value at index iSource of arrays p and q
+//               the caller guarantees that the slab holding iSource is idle
+
+
+void PTHREADS_InsertSource(float dt, int it, int iSource, 
+			   float *p, float*q, float src) {
+  {
+     p[iSource]+=src;
+     q[iSource]+=src;
+  }
+}
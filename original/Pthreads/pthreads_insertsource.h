@@ -0,0 +1,12 @@
+#ifndef _PTHREADS_SOURCE
+#define _PTHREADS_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+void PTHREADS_InsertSource(float dt, int it, int iSource, 
+		           float *p, float *q, float src);
+
+#endif
@@ -0,0 +1,355 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "pthreads_propagate.h"
+#include "../derivatives.h"
+#include "../map.h"
+#include "../walltime.h"
+#include "../trace.h"
+
+#ifdef BRICK
+#error "bricked storage (BRICK) is only implemented by the OpenMP backend"
+#endif
+#ifdef HALF
+#error "half precision storage (HALF) is only implemented by the OpenMP backend"
+#endif
+#if defined(TIME_ORDER) && TIME_ORDER == 4
+#error "4th order time integration (TIME_ORDER=4) is only implemented by the OpenMP backend"
+#endif
+#ifdef SOURCE_FORCING
+#error "source as a forcing (SOURCE_FORCING) is only implemented by the OpenMP backend"
+#endif
+#ifdef DIAG
+#error "fused diagnostics (DIAG) are only implemented by the OpenMP backend"
+#endif
+
+
+#define CACHE_LINE 64      // counters of distinct slabs live on distinct cache lines
+#define SPIN_LIMIT 1024    // busy wait iterations before yielding the core
+
+
+typedef struct {
+  volatile int step;       // last time step completed by the slab
+  char pad[CACHE_LINE-sizeof(int)];
+} SlabCounter;
+
+
+// pool state
+
+static int nThreads=0;
+static pthread_t *thread=NULL;
+static int *izStart=NULL;           // first z plane of each slab
+static int *izEnd=NULL;             // last z plane (exclusive) of each slab
+static SlabCounter *done=NULL;      // per slab step counters
+static volatile int released=0;     // last step released by PTHREADS_Propagate
+static volatile int stopping=0;
+static int srcSlab=-1;              // slab holding the source
+
+// grid and wave fields as seen at step base; later steps alternate them
+
+static int base=0;
+static int gsx, gsy, gsz, gbord;
+static float gdx, gdy, gdz, gdt;
+static float *pp0, *pc0, *qp0, *qc0;
+static const CoefT *gcoef;
+
+// synchronization statistics
+
+static double *waitTime=NULL;       // per worker time waiting for neighbours
+static double hostWait=0.0;         // time DRIVER_Propagate waits for the source slab
+static int nSteps=0;
+
+// comparison with fork/join ($FLETCHER_PTHREADS_COMPARE): host time waiting for
+// the workers and steps, in join all (0) and neighbour only (1) blocks
+
+static int compareSteps=0;
+static int compareMode=-1;          // mode of the current block, -1 without comparison
+static double compareTime[2];
+static int compareCount[2];
+
+
+// SpinUntil: wait until *counter >= value
+
+
+static inline void SpinUntil(volatile int *counter, int value) {
+  int spins=0;
+  while (__atomic_load_n(counter, __ATOMIC_ACQUIRE) < value) {
+    if (++spins > SPIN_LIMIT) {
+      sched_yield();
+      spins=0;
+    }
+  }
+}
+
+
+// PropagateSlab: one time step over z planes [iz0,iz1)
+
+
+static void PropagateSlab(int iz0, int iz1,
+			  int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt,
+			  const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+
+#define SAMPLE_PRE_LOOP
+#include "../sample.h"
+#undef SAMPLE_PRE_LOOP
+
+  for (int iz=iz0; iz<iz1; iz++) {
+    for (int iy=bord; iy<sy-bord; iy++) {
+      for (int ix=bord; ix<sx-bord; ix++) {
+
+
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+
+
+      }
+    }
+  }
+}
+
+
+// Worker: run the slab until shutdown
+
+
+static void *Worker(void *arg) {
+  const int w=(int)(intptr_t)arg;
+
+  // wait for the first step
+
+  while (__atomic_load_n(&released, __ATOMIC_ACQUIRE) == 0)
+    if (stopping) return NULL;
+    else sched_yield();
+
+  for (int t=base; ; t++) {
+
+    // step t is released
+
+    if (__atomic_load_n(&released, __ATOMIC_ACQUIRE) < t) {
+      int spins=0;
+      while (__atomic_load_n(&released, __ATOMIC_ACQUIRE) < t) {
+	if (stopping) return NULL;
+	if (++spins > SPIN_LIMIT) {
+	  sched_yield();
+	  spins=0;
+	}
+      }
+    }
+
+    // neighbour slabs finished step t-1: their pc halo is ready and
+    // they are done reading our part of the array we overwrite now
+
+    const int lo=(w>0) ? w-1 : w;
+    const int hi=(w<nThreads-1) ? w+1 : w;
+    if (__atomic_load_n(&done[lo].step, __ATOMIC_ACQUIRE) < t-1 ||
+	__atomic_load_n(&done[hi].step, __ATOMIC_ACQUIRE) < t-1) {
+      const double tw=wtime();
+      SpinUntil(&done[lo].step, t-1);
+      SpinUntil(&done[hi].step, t-1);
+      waitTime[w]+=wtime()-tw;
+    }
+
+    float *pp, *pc, *qp, *qc;
+    if ((t-base)%2 == 0) {
+      pp=pp0; pc=pc0; qp=qp0; qc=qc0;
+    } else {
+      pp=pc0; pc=pp0; qp=qc0; qc=qp0;
+    }
+
+    TRACE_BEGIN(tTrace);
+    PropagateSlab(izStart[w], izEnd[w],
+		  gsx, gsy, gsz, gbord,
+		  gdx, gdy, gdz, gdt,
+		  gcoef, pp, pc, qp, qc);
+    TRACE_END(tTrace, TRACE_KERNEL, w);
+
+    __atomic_store_n(&done[w].step, t, __ATOMIC_RELEASE);
+  }
+}
+
+
+// PTHREADS_Initialize: split the grid in slabs and start the workers
+
+
+void PTHREADS_Initialize(int sx, int sy, int sz, int bord,
+			 float dx, float dy, float dz, float dt) {
+
+  gsx=sx; gsy=sy; gsz=sz; gbord=bord;
+  gdx=dx; gdy=dy; gdz=dz; gdt=dt;
+
+  // threads from OMP_NUM_THREADS, as set by env.sh, or all cores;
+  // slabs must be at least bord planes thick, since stencils reach only the neighbours
+
+  const char *env=getenv("OMP_NUM_THREADS");
+  nThreads=(env != NULL) ? atoi(env) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  const int planes=sz-2*bord;
+  if (nThreads > planes/bord)
+    nThreads=planes/bord;
+  if (nThreads < 1)
+    nThreads=1;
+
+  thread=(pthread_t *) malloc(nThreads*sizeof(pthread_t));
+  izStart=(int *) malloc(nThreads*sizeof(int));
+  izEnd=(int *) malloc(nThreads*sizeof(int));
+  waitTime=(double *) calloc(nThreads, sizeof(double));
+  if (posix_memalign((void **) &done, CACHE_LINE, nThreads*sizeof(SlabCounter)) != 0) {
+    printf("PTHREADS_Initialize: allocation of slab counters failed\n");
+    exit(-1);
+  }
+
+  for (int w=0; w<nThreads; w++) {
+    izStart[w]=bord+(int)(((long)planes*w)/nThreads);
+    izEnd[w]=bord+(int)(((long)planes*(w+1))/nThreads);
+    done[w].step=0;
+  }
+
+  released=0;
+  stopping=0;
+  srcSlab=-1;
+  for (int w=0; w<nThreads; w++)
+    pthread_create(&thread[w], NULL, Worker, (void *)(intptr_t) w);
+
+  // worker w pinned to the w-th cpu this process may run on, cycling if fewer
+
+  cpu_set_t allowed;
+  int cpu[CPU_SETSIZE], nCpus=0, pinned=0;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    printf("Pthreads pool: cpus of the process unknown (%s); workers not pinned\n", strerror(errno));
+  else
+    for (int c=0; c<CPU_SETSIZE; c++)
+      if (CPU_ISSET(c, &allowed))
+	cpu[nCpus++]=c;
+  for (int w=0; w<nThreads && nCpus>0; w++) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu[w%nCpus], &set);
+    const int err=pthread_setaffinity_np(thread[w], sizeof(set), &set);
+    if (err != 0)
+      printf("Pthreads pool: worker %d not pinned to cpu %d: %s\n", w, cpu[w%nCpus], strerror(err));
+    else
+      pinned++;
+  }
+
+  const char *cmp=getenv("FLETCHER_PTHREADS_COMPARE");
+  compareSteps=(cmp != NULL && atoi(cmp) > 0) ? atoi(cmp) : 0;
+  compareTime[0]=compareTime[1]=0.0;
+  compareCount[0]=compareCount[1]=0;
+
+  printf("Pthreads pool of %d workers, %d pinned to %d allowed cpus, on slabs of about %d z planes\n",
+	 nThreads, pinned, nCpus, planes/nThreads);
+}
+
+
+// PTHREADS_SourceSlab: tells the pool which slab holds index iSource; waits for
+//                      every slab, since the new one may still run the last step
+
+
+void PTHREADS_SourceSlab(int iSource) {
+  PTHREADS_WaitAll();
+  const int iz=iSource/(gsx*gsy);
+  srcSlab=nThreads-1;
+  for (int w=0; w<nThreads; w++)
+    if (iz < izEnd[w]) {
+      srcSlab=w;
+      break;
+    }
+}
+
+
+// PTHREADS_Propagate: release time step it to the workers and wait only for
+//                     the slab holding the source, that is written next
+
+
+void PTHREADS_Propagate(int sx, int sy, int sz, int bord,
+	       float dx, float dy, float dz, float dt, int it,
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+
+  if (base == 0) {
+    base=it;
+    pp0=pp; pc0=pc; qp0=qp; qc0=qc;
+    gcoef=coef;
+    for (int w=0; w<nThreads; w++)
+      done[w].step=it-1;
+  }
+  nSteps++;
+
+  // comparison blocks alternate, starting with join all; a block ends once every
+  // slab finished it, so that all its waits are timed in its mode
+
+  if (compareSteps > 0 && (it-base)%compareSteps == 0) {
+    if (it > base)
+      PTHREADS_WaitAll();
+    compareMode=((it-base)/compareSteps)%2;
+  }
+  if (compareMode >= 0)
+    compareCount[compareMode]++;
+  __atomic_store_n(&released, it, __ATOMIC_RELEASE);
+
+  const double tw=wtime();
+  if (srcSlab >= 0 && compareMode != 0) {
+    SpinUntil(&done[srcSlab].step, it);
+    if (compareMode > 0)
+      compareTime[compareMode]+=wtime()-tw;
+  } else
+    PTHREADS_WaitAll();
+  hostWait+=wtime()-tw;
+}
+
+
+// PTHREADS_WaitAll: wait until every slab finished the last released step
+
+
+void PTHREADS_WaitAll() {
+  const double tw=wtime();
+  for (int w=0; w<nThreads; w++)
+    SpinUntil(&done[w].step, released);
+  if (compareMode >= 0)
+    compareTime[compareMode]+=wtime()-tw;
+}
+
+
+// PTHREADS_Finalize: stop and join the workers and report synchronization overhead
+
+
+void PTHREADS_Finalize() {
+
+  PTHREADS_WaitAll();
+  stopping=1;
+  for (int w=0; w<nThreads; w++)
+    pthread_join(thread[w], NULL);
+
+  double sumWait=0.0, maxWait=0.0;
+  for (int w=0; w<nThreads; w++) {
+    sumWait+=waitTime[w];
+    if (waitTime[w] > maxWait)
+      maxWait=waitTime[w];
+  }
+  const int steps=(nSteps > 0) ? nSteps : 1;
+  printf("Pthreads pool: neighbour wait per step %.2lf us average, %.2lf us slowest worker\n",
+	 1.0e6*sumWait/(nThreads*steps), 1.0e6*maxWait/steps);
+  printf("Pthreads pool: host wait for source slab per step %.2lf us\n",
+	 1.0e6*hostWait/steps);
+  if (compareCount[0] > 0 && compareCount[1] > 0) {
+    const double join=compareTime[0]/compareCount[0];
+    const double neighbour=compareTime[1]/compareCount[1];
+    printf("Pthreads pool: host waits %.2lf us per step joining all workers, as OPENMP_Propagate, "
+	   "%.2lf us with neighbour sync; %.2lf us (%.1lf%%) removed per step over %d+%d steps\n",
+	   1.0e6*join, 1.0e6*neighbour, 1.0e6*(join-neighbour), 100.0*(join-neighbour)/join,
+	   compareCount[0], compareCount[1]);
+  }
+  compareMode=-1;
+
+  free(thread);
+  free(izStart);
+  free(izEnd);
+  free(waitTime);
+  free(done);
+  base=0;
+  nSteps=0;
+  hostWait=0.0;
+}
@@ -0,0 +1,53 @@
+#ifndef _PTHREADS_PROPAGATE
+#define _PTHREADS_PROPAGATE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "../coef.h"
+
+
+// Persistent pool of pinned workers, each one owning a fixed slab of z planes.
+// A slab starts step t as soon as itself and its two neighbour slabs finished step t-1;
+// there is no barrier between time steps. Workers are pinned to the cpus the process
+// may run on. With $FLETCHER_PTHREADS_COMPARE=n, blocks of n steps alternate between
+// waiting for every worker after each step, the fork/join of OPENMP_Propagate, and
+// neighbour only synchronization, and the time removed per step is reported.
+
+
+// PTHREADS_Initialize: split the grid in slabs and start the workers
+
+
+void PTHREADS_Initialize(int sx, int sy, int sz, int bord,
+			 float dx, float dy, float dz, float dt);
+
+
+// PTHREADS_Propagate: release time step it to the workers and wait only for
+//                     the slab holding the source, that is written next
+
+
+void PTHREADS_Propagate(int sx, int sy, int sz, int bord,
+	       float dx, float dy, float dz, float dt, int it, 
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
+
+
+// PTHREADS_SourceSlab: tells the pool which slab holds index iSource; waits for
+//                      every slab, since the new one may still run the last step
+
+
+void PTHREADS_SourceSlab(int iSource);
+
+
+// PTHREADS_WaitAll: wait until every slab finished the last released step
+
+
+void PTHREADS_WaitAll();
+
+
+// PTHREADS_Finalize: stop and join the workers and report synchronization overhead
+
+
+void PTHREADS_Finalize();
+
+#endif
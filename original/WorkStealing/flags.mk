@@ -0,0 +1,3 @@
+CC=$(GCC)
+CFLAGS=-O3 -pthread
+LIBS=$(GCC_LIBS) -lpthread
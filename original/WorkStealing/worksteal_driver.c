@@ -0,0 +1,43 @@
+#include "../driver.h"
+#include "worksteal_propagate.h"
+#include "worksteal_insertsource.h"
+#include "../sample.h"
+
+
+void DRIVER_Initialize(const int sx, const int sy, const int sz, const int bord,
+		       float dx, float dy, float dz, float dt,
+		       float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
+		       float * restrict phi, float * restrict theta, const CoefT *coef,
+		       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
+{
+	WORKSTEAL_Initialize(sx, sy, sz, bord, dx, dy, dz, dt);
+}
+
+
+void DRIVER_Finalize()
+{
+	WORKSTEAL_Finalize();
+}
+
+
+void DRIVER_Update_pointers(const int sx, const int sy, const int sz, float *pc)
+{
+}
+
+
+void DRIVER_Propagate(const int sx, const int sy, const int sz, const int bord,
+	       const float dx, const float dy, const float dz, const float dt, const int it, 
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc)
+{
+
+	WORKSTEAL_Propagate (  sx,   sy,   sz,   bord,
+                                   dx,   dy,   dz,   dt,   it,
+                                   coef,   pp,   pc,   qp,   qc);
+
+}
+
+
+void DRIVER_InsertSource(float dt, int it, int iSource, float *p, float*q, float src)
+{
+        WORKSTEAL_InsertSource(dt,it,iSource,p,q,src);
+}
@@ -0,0 +1,12 @@
+#ifndef _WORKSTEAL_SOURCE
+#define _WORKSTEAL_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+void WORKSTEAL_InsertSource(float dt, int it, int iSource, 
+			    float *p, float *q, float src);
+
+#endif
@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include "worksteal_propagate.h"
+#include "../derivatives.h"
+#include "../map.h"
+#include "../walltime.h"
+#include "../trace.h"
+
+#ifdef BRICK
+#error "bricked storage (BRICK) is only implemented by the OpenMP backend"
+#endif
+#ifdef HALF
+#error "half precision storage (HALF) is only implemented by the OpenMP backend"
+#endif
+#if defined(TIME_ORDER) && TIME_ORDER == 4
+#error "4th order time integration (TIME_ORDER=4) is only implemented by the OpenMP backend"
+#endif
+#ifdef SOURCE_FORCING
+#error "source as a forcing (SOURCE_FORCING) is only implemented by the OpenMP backend"
+#endif
+#ifdef DIAG
+#error "fused diagnostics (DIAG) are only implemented by the OpenMP backend"
+#endif
+
+
+#define CACHE_LINE 64      // deques of distinct workers live on distinct cache lines
+#define SPIN_LIMIT 1024    // busy wait iterations before yielding the core
+
+
+// Deque: tiles [lo,hi) still to run; the owner takes from lo, thieves from hi
+
+
+typedef struct {
+  pthread_spinlock_t lock;
+  int lo;
+  int hi;
+  char pad[CACHE_LINE-sizeof(pthread_spinlock_t)-2*sizeof(int)];
+} Deque;
+
+
+// pool state
+
+static int nThreads=0;
+static pthread_t *thread=NULL;
+static Deque *deque=NULL;
+static volatile int generation=0;   // incremented when a step is released
+static volatile int remaining=0;    // tiles of the current step not finished
+static volatile int finished=0;     // workers that ended the current step
+static volatile int stopping=0;
+static cpu_set_t hostCpu;            // cpu of worker 0, the calling thread, in a step
+static int hostPinned=0;
+
+// grid, tiles and wave fields of the current step
+
+static int gsx, gsy, gsz, gbord;
+static float gdx, gdy, gdz, gdt;
+static int nTiles, nTilesY;
+static float *gpp, *gpc, *gqp, *gqc;
+static const CoefT *gcoef;
+
+// load balance statistics
+
+static double *busy=NULL;           // per worker time running tiles
+static long *tilesRun=NULL;         // per worker tiles run
+static long *tilesStolen=NULL;      // per worker tiles stolen from others
+static double stepTime=0.0;
+static int nSteps=0;
+
+
+// PropagateTile: one time step over the z planes and y lines of a tile
+
+
+static void PropagateTile(int tile,
+			  int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt,
+			  const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+
+#define SAMPLE_PRE_LOOP
+#include "../sample.h"
+#undef SAMPLE_PRE_LOOP
+
+  const int iz0=bord+(tile/nTilesY)*WS_TILE_Z;
+  const int iy0=bord+(tile%nTilesY)*WS_TILE_Y;
+  const int iz1=(iz0+WS_TILE_Z < sz-bord) ? iz0+WS_TILE_Z : sz-bord;
+  const int iy1=(iy0+WS_TILE_Y < sy-bord) ? iy0+WS_TILE_Y : sy-bord;
+
+  for (int iz=iz0; iz<iz1; iz++) {
+    for (int iy=iy0; iy<iy1; iy++) {
+      for (int ix=bord; ix<sx-bord; ix++) {
+
+
+#define SAMPLE_LOOP
+#include "../sample.h"
+#undef SAMPLE_LOOP
+
+
+      }
+    }
+  }
+}
+
+
+// NextTile: next tile for worker w, from its own deque or stolen; -1 if none is left
+
+
+static int NextTile(int w) {
+  int tile=-1;
+
+  pthread_spin_lock(&deque[w].lock);
+  if (deque[w].lo < deque[w].hi)
+    tile=deque[w].lo++;
+  pthread_spin_unlock(&deque[w].lock);
+  if (tile >= 0)
+    return tile;
+
+  // tiles are never added during a step, so one empty sweep means the step is claimed
+
+  for (int k=1; k<nThreads; k++) {
+    const int v=(w+k)%nThreads;
+    pthread_spin_lock(&deque[v].lock);
+    if (deque[v].lo < deque[v].hi)
+      tile=--deque[v].hi;
+    pthread_spin_unlock(&deque[v].lock);
+    if (tile >= 0) {
+      tilesStolen[w]++;
+      return tile;
+    }
+  }
+  return -1;
+}
+
+
+// RunStep: worker w runs tiles of the current step until none is left
+
+
+static void RunStep(int w) {
+  const double t0=wtime();
+  int tile;
+  while ((tile=NextTile(w)) >= 0) {
+    TRACE_BEGIN(tTrace);
+    PropagateTile(tile,
+		  gsx, gsy, gsz, gbord,
+		  gdx, gdy, gdz, gdt,
+		  gcoef, gpp, gpc, gqp, gqc);
+    TRACE_END(tTrace, TRACE_KERNEL, tile);
+    tilesRun[w]++;
+    __atomic_fetch_sub(&remaining, 1, __ATOMIC_RELEASE);
+  }
+  busy[w]+=wtime()-t0;
+}
+
+
+// Worker: run released steps until shutdown
+
+
+static void *Worker(void *arg) {
+  const int w=(int)(intptr_t)arg;
+
+  int seen=0;
+  for (;;) {
+    int spins=0;
+    while (__atomic_load_n(&generation, __ATOMIC_ACQUIRE) == seen) {
+      if (stopping) return NULL;
+      if (++spins > SPIN_LIMIT) {
+	sched_yield();
+	spins=0;
+      }
+    }
+    seen++;
+    RunStep(w);
+    __atomic_fetch_add(&finished, 1, __ATOMIC_RELEASE);
+  }
+}
+
+
+// WORKSTEAL_Initialize: start the workers
+
+
+void WORKSTEAL_Initialize(int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt) {
+
+  gsx=sx; gsy=sy; gsz=sz; gbord=bord;
+  gdx=dx; gdy=dy; gdz=dz; gdt=dt;
+  nTilesY=(sy-2*bord+WS_TILE_Y-1)/WS_TILE_Y;
+  nTiles=((sz-2*bord+WS_TILE_Z-1)/WS_TILE_Z)*nTilesY;
+
+  // threads from OMP_NUM_THREADS, as set by env.sh, or all cores
+
+  const char *env=getenv("OMP_NUM_THREADS");
+  nThreads=(env != NULL) ? atoi(env) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (nThreads < 1)
+    nThreads=1;
+
+  thread=(pthread_t *) malloc(nThreads*sizeof(pthread_t));
+  busy=(double *) calloc(nThreads, sizeof(double));
+  tilesRun=(long *) calloc(nThreads, sizeof(long));
+  tilesStolen=(long *) calloc(nThreads, sizeof(long));
+  if (posix_memalign((void **) &deque, CACHE_LINE, nThreads*sizeof(Deque)) != 0) {
+    printf("WORKSTEAL_Initialize: allocation of deques failed\n");
+    exit(-1);
+  }
+  for (int w=0; w<nThreads; w++) {
+    pthread_spin_init(&deque[w].lock, PTHREAD_PROCESS_PRIVATE);
+    deque[w].lo=deque[w].hi=0;
+  }
+
+  // the calling thread is worker 0
+
+  generation=0;
+  stopping=0;
+  thread[0]=pthread_self();
+  for (int w=1; w<nThreads; w++)
+    pthread_create(&thread[w], NULL, Worker, (void *)(intptr_t) w);
+
+  // worker w pinned to the w-th cpu this process may run on, cycling if fewer;
+  // the calling thread only while it runs a step, see WORKSTEAL_Propagate
+
+  cpu_set_t allowed;
+  int cpu[CPU_SETSIZE], nCpus=0, pinned=0;
+  hostPinned=0;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    printf("Work stealing: cpus of the process unknown (%s); workers not pinned\n", strerror(errno));
+  else
+    for (int c=0; c<CPU_SETSIZE; c++)
+      if (CPU_ISSET(c, &allowed))
+	cpu[nCpus++]=c;
+  if (nCpus > 0) {
+    CPU_ZERO(&hostCpu);
+    CPU_SET(cpu[0], &hostCpu);
+    hostPinned=1;
+    pinned++;
+  }
+  for (int w=1; w<nThreads && nCpus>0; w++) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu[w%nCpus], &set);
+    const int err=pthread_setaffinity_np(thread[w], sizeof(set), &set);
+    if (err != 0)
+      printf("Work stealing: worker %d not pinned to cpu %d: %s\n", w, cpu[w%nCpus], strerror(err));
+    else
+      pinned++;
+  }
+
+  printf("Work stealing pool of %d workers, %d pinned to %d allowed cpus, on %d tiles of (%d,%d) z planes and y lines\n",
+	 nThreads, pinned, nCpus, nTiles, WS_TILE_Z, WS_TILE_Y);
+}
+
+
+// Propagate: using Fletcher's equations, propagate waves one dt,
+//            either forward or backward in time; the calling thread works as worker 0,
+//            pinned to its cpu only for its tiles, so that the threads it creates
+//            between steps (consumers, server workers) inherit its own cpus
+
+
+void WORKSTEAL_Propagate(int sx, int sy, int sz, int bord,
+	       float dx, float dy, float dz, float dt, int it,
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+
+  const double t0=wtime();
+
+  gpp=pp; gpc=pc; gqp=qp; gqc=qc;
+  gcoef=coef;
+  for (int w=0; w<nThreads; w++) {
+    deque[w].lo=(int)(((long)nTiles*w)/nThreads);
+    deque[w].hi=(int)(((long)nTiles*(w+1))/nThreads);
+  }
+  remaining=nTiles;
+  finished=0;
+  __atomic_fetch_add(&generation, 1, __ATOMIC_RELEASE);
+
+  cpu_set_t callerCpus;
+  int pin=hostPinned && pthread_getaffinity_np(pthread_self(), sizeof(callerCpus), &callerCpus) == 0;
+  if (pin) {
+    const int err=pthread_setaffinity_np(pthread_self(), sizeof(hostCpu), &hostCpu);
+    if (err != 0) {
+      printf("Work stealing: worker 0 not pinned: %s; left unpinned\n", strerror(err));
+      hostPinned=pin=0;
+    }
+  }
+  RunStep(0);
+  if (pin)
+    pthread_setaffinity_np(pthread_self(), sizeof(callerCpus), &callerCpus);
+
+  // every tile is done and no worker still sweeps the deques of this step
+
+  while (__atomic_load_n(&remaining, __ATOMIC_ACQUIRE) > 0 ||
+	 __atomic_load_n(&finished, __ATOMIC_ACQUIRE) < nThreads-1)
+    sched_yield();
+
+  stepTime+=wtime()-t0;
+  nSteps++;
+}
+
+
+// WORKSTEAL_Finalize: stop and join the workers and report load balance
+
+
+void WORKSTEAL_Finalize() {
+
+  stopping=1;
+  for (int w=1; w<nThreads; w++)
+    pthread_join(thread[w], NULL);
+
+  double sumBusy=0.0, maxBusy=0.0;
+  long stolen=0;
+  for (int w=0; w<nThreads; w++) {
+    sumBusy+=busy[w];
+    if (busy[w] > maxBusy)
+      maxBusy=busy[w];
+    stolen+=tilesStolen[w];
+  }
+  const double avgBusy=sumBusy/nThreads;
+  printf("Work stealing: load imbalance (max/avg busy time) %.3lf; %.1lf%% of tiles stolen\n",
+	 (avgBusy > 0.0) ? maxBusy/avgBusy : 1.0,
+	 (nSteps > 0) ? 100.0*(double)stolen/((double)nTiles*nSteps) : 0.0);
+  printf("Work stealing: workers busy %.1lf%% of the %.3lf s spent in steps\n",
+	 (stepTime > 0.0) ? 100.0*avgBusy/stepTime : 0.0, stepTime);
+  for (int w=0; w<nThreads; w++)
+    printf("Work stealing: worker %d ran %ld tiles (%ld stolen) in %.3lf s\n",
+	   w, tilesRun[w], tilesStolen[w], busy[w]);
+
+  for (int w=0; w<nThreads; w++)
+    pthread_spin_destroy(&deque[w].lock);
+  free(thread);
+  free(busy);
+  free(tilesRun);
+  free(tilesStolen);
+  free(deque);
+  stepTime=0.0;
+  nSteps=0;
+}
@@ -0,0 +1,44 @@
+#ifndef _WORKSTEAL_PROPAGATE
+#define _WORKSTEAL_PROPAGATE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "../coef.h"
+
+
+// Persistent pool of workers sharing each time step as (z,y) tiles, pinned to the
+// cpus the process may run on, the calling thread included.
+// Every worker starts with a contiguous range of tiles and, once it is empty,
+// steals tiles from the back of the other workers ranges.
+
+
+#define WS_TILE_Z 4     // z planes per tile
+#define WS_TILE_Y 16    // y lines per tile
+
+
+// WORKSTEAL_Initialize: start the workers
+
+
+void WORKSTEAL_Initialize(int sx, int sy, int sz, int bord,
+			  float dx, float dy, float dz, float dt);
+
+
+// Propagate: using Fletcher's equations, propagate waves one dt,
+//            either forward or backward in time; the calling thread works as worker 0,
+//            pinned to its cpu only for its tiles, so that the threads it creates
+//            between steps (consumers, server workers) inherit its own cpus
+
+
+void WORKSTEAL_Propagate(int sx, int sy, int sz, int bord,
+	       float dx, float dy, float dz, float dt, int it, 
+	       const CoefT *coef, float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
+
+
+// WORKSTEAL_Finalize: stop and join the workers and report load balance
+
+
+void WORKSTEAL_Finalize();
+
+#endif
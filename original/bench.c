@@ -0,0 +1,688 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "utils.h"
+#include "driver.h"
+#include "fletcher.h"
+#include "medium.h"
+#include "zgrid.h"
+#include "sample.h"
+#include "walltime.h"
+#include "metrics.h"
+#include "history.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef BACKEND
+#define BACKEND "unknown"
+#endif
+
+
+// Benchmark.exe: kernel microbenchmarks built from the sources of ModelagemFletcher.exe
+//
+// usage: Benchmark.exe [-n sizes] [-t threads] [-f formulations] [-r trials] [-o file]
+//        Benchmark.exe -s strong|weak [-p policies] [-n size] [-t threads] [-f formulation] ...
+//        sizes, threads, formulations and policies are comma separated lists
+//
+// For every formulation, grid of n^3 internal points and thread count, times the
+// stencil components (Der2 along x and z, Der1 along z, DerCross in xz), the ISO, VTI
+// and TTI variants of the full sample of sample.h, and DRIVER_Propagate of the backend.
+// Each time is the median over trials of one sweep, after BENCH_WARMUP sweeps, with the
+// median absolute deviation. Results go to stdout and to the file, one line per time,
+// always in the same order and format, to be compared between commits and machines.
+// Where the RAPL zones of /sys/class/powercap are readable, each line also gives the
+// package and DRAM energy per sweep and MSamples per joule.
+//
+// Scaling mode (-s) times DRIVER_Propagate along a ladder of thread counts (default
+// powers of two up to all cpus) for each pinning policy of OpenMP threads (close fills
+// a socket first, spread alternates sockets, none leaves threads unpinned). Strong
+// scaling keeps the n^3 grid, weak scaling stacks n^3 points per thread along z over
+// a model allocated once for the largest grid. Rows give speedup, parallel efficiency
+// and the effective bandwidth, from which the saturation point of one socket follows;
+// the table goes to Scaling.dat.
+//
+// Every trial is also appended to the results history (history.h) under the git
+// revision of the build, for ModelagemFletcher.exe HISTORY to compare revisions.
+
+
+#define BENCH_SIZES "32,64,128"     // in cache to DRAM bound
+#define BENCH_FORMS "ISO,VTI,TTI"
+#define BENCH_TRIALS 11
+#define BENCH_WARMUP 2
+#define BENCH_MAX_LIST 16
+#define BENCH_FILE "Benchmark.dat"
+#define BENCH_SCALING_FILE "Scaling.dat"
+#define BENCH_POLICIES "close,spread"
+#define BENCH_MAX_CPUS 1024
+#define BENCH_SATURATION 0.25       // fraction of the ideal bandwidth gain of a rung
+#define BENCH_H 12.5f               // grid step
+#define BENCH_DT 0.001f             // time step, stable for the media of medium.c at BENCH_H
+
+
+// bricked layout rounds grids up to whole bricks
+
+#ifdef BRICK
+#define BRICK_X_OR_1 BRICK_X
+#define BRICK_Y_OR_1 BRICK_Y
+#define BRICK_Z_OR_1 BRICK_Z
+#else
+#define BRICK_X_OR_1 1
+#define BRICK_Y_OR_1 1
+#define BRICK_Z_OR_1 1
+#endif
+
+
+enum Kernel {DER2_X, DER2_Z, DER1_Z, DERCROSS_XZ, SAMPLE_ISO_K, SAMPLE_VTI_K, SAMPLE_TTI_K,
+	     PROPAGATE, NKERNELS};
+
+static const char *kernelName[NKERNELS]={"Der2_x", "Der2_z", "Der1_z", "DerCross_xz",
+					 "sample_ISO", "sample_VTI", "sample_TTI", "propagate"};
+
+
+// ParseList: comma separated integers; returns how many
+
+
+static int ParseList(const char *s, int *v) {
+  int n=0;
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", s);
+  for (char *tok=strtok(buf, ","); tok != NULL && n < BENCH_MAX_LIST; tok=strtok(NULL, ","))
+    v[n++]=atoi(tok);
+  return n;
+}
+
+
+// Component: one sweep of a stencil component over the internal points into out
+
+
+#define BENCH_LOOP(stmt)						\
+  _Pragma("omp parallel for")						\
+  for (int iz=bord; iz<sz-bord; iz++)					\
+    for (int iy=bord; iy<sy-bord; iy++)					\
+      for (int ix=bord; ix<sx-bord; ix++) {				\
+	const int i=ind(ix,iy,iz);					\
+	stmt;								\
+      }
+
+static void Component(int k, int sx, int sy, int sz, int bord,
+		      float dx, float dz, const float * restrict pc, float * restrict out) {
+  const int strideX=ind(1,0,0)-ind(0,0,0);
+  const int strideZ=ind(0,0,1)-ind(0,0,0);
+  const float dxxinv=1.0f/(dx*dx);
+  const float dzzinv=1.0f/(dz*dz);
+  const float dzinv=1.0f/dz;
+  const float dxzinv=1.0f/(dx*dz);
+  switch (k) {
+  case DER2_X:
+    BENCH_LOOP(out[i]=Der2(pc, i, strideX, dxxinv));
+    break;
+  case DER2_Z:
+    BENCH_LOOP(out[i]=Der2(pc, i, strideZ, dzzinv));
+    break;
+  case DER1_Z:
+    BENCH_LOOP(out[i]=Der1(pc, i, strideZ, dzinv));
+    break;
+  default:
+    BENCH_LOOP(out[i]=DerCross(pc, i, strideX, strideZ, dxzinv));
+    break;
+  }
+}
+
+
+// SampleISO, SampleVTI, SampleTTI: one sweep of the sample variant over the internal points
+
+
+static void SampleISO(int sx, int sy, int sz, int bord,
+		      float dx, float dy, float dz, float dt, const CoefT *coef,
+		      float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+#define SAMPLE_PRE_LOOP
+#include "sample.h"
+#undef SAMPLE_PRE_LOOP
+#pragma omp parallel for
+  for (int iz=bord; iz<sz-bord; iz++)
+    for (int iy=bord; iy<sy-bord; iy++)
+      for (int ix=bord; ix<sx-bord; ix++) {
+#define SAMPLE_ISO
+#define SAMPLE_LOOP
+#include "sample.h"
+#undef SAMPLE_LOOP
+#undef SAMPLE_ISO
+      }
+}
+
+static void SampleVTI(int sx, int sy, int sz, int bord,
+		      float dx, float dy, float dz, float dt, const CoefT *coef,
+		      float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+#define SAMPLE_PRE_LOOP
+#include "sample.h"
+#undef SAMPLE_PRE_LOOP
+#pragma omp parallel for
+  for (int iz=bord; iz<sz-bord; iz++)
+    for (int iy=bord; iy<sy-bord; iy++)
+      for (int ix=bord; ix<sx-bord; ix++) {
+#define SAMPLE_VTI
+#define SAMPLE_LOOP
+#include "sample.h"
+#undef SAMPLE_LOOP
+#undef SAMPLE_VTI
+      }
+}
+
+static void SampleTTI(int sx, int sy, int sz, int bord,
+		      float dx, float dy, float dz, float dt, const CoefT *coef,
+		      float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc) {
+#define SAMPLE_PRE_LOOP
+#include "sample.h"
+#undef SAMPLE_PRE_LOOP
+#pragma omp parallel for
+  for (int iz=bord; iz<sz-bord; iz++)
+    for (int iy=bord; iy<sy-bord; iy++)
+      for (int ix=bord; ix<sx-bord; ix++) {
+#define SAMPLE_LOOP
+#include "sample.h"
+#undef SAMPLE_LOOP
+      }
+}
+
+
+// Statistics: median and median absolute deviation of n times, sorted in place
+
+
+static int CompareDouble(const void *a, const void *b) {
+  const double x=*(const double *)a, y=*(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static double Median(double *v, int n) {
+  qsort(v, n, sizeof(double), CompareDouble);
+  return (n%2) ? v[n/2] : 0.5*(v[n/2-1]+v[n/2]);
+}
+
+static void Statistics(double *t, int n, double *median, double *mad) {
+  double *dev=(double *) malloc(n*sizeof(double));
+  *median=Median(t, n);
+  for (int r=0; r<n; r++)
+    dev[r]=fabs(t[r]-*median);
+  *mad=Median(dev, n);
+  free(dev);
+}
+
+
+// Record: every trial of a timing as one observation of the results history
+
+
+static void Record(const char *source, const char *form, const char *variant,
+		   int nx, int ny, int nz, int threads, long samples, const double *t, int trials) {
+  for (int r=0; r<trials; r++)
+    HistoryAppend(source, form, variant, nx, ny, nz, threads, 1.0e-6*samples/t[r], -1);
+}
+
+
+// BenchModel: medium, precomputed coefficients and wave fields of a grid
+
+
+typedef struct {
+  int sx, sy, sz, bord;
+  float dx, dy, dz, dt;
+  float *zPlane, *vpz, *vsv, *epsilon, *delta, *phi, *theta;
+  CoefT coef;
+  float *pp, *pc, *qp, *qc;
+} BenchModel;
+
+
+// RoundGrid: grid dimension with border for n internal points; bricked layout
+//            rounds it up to whole bricks
+
+
+static int RoundGrid(int n, int brick) {
+  const int s=n+2*STENCIL_RADIUS;
+  return ((s+brick-1)/brick)*brick;
+}
+
+
+// ModelFields: wave fields of normal (not subnormal) values
+
+
+static void ModelFields(BenchModel *m) {
+  const long n=(long)m->sx*m->sy*m->sz;
+  for (long i=0; i<n; i++) {
+    m->pp[i]=m->qp[i]=1.0f+sinf(1.0e-3f*i);
+    m->pc[i]=m->qc[i]=1.0f+cosf(1.0e-3f*i);
+  }
+}
+
+
+// ModelAllocate: model of formulation prob on a grid of sx*sy*sz points with border
+
+
+static void ModelAllocate(enum Form prob, int sx, int sy, int sz, BenchModel *m) {
+  const int bord=STENCIL_RADIUS;
+  const long n=(long)sx*sy*sz;
+  m->sx=sx; m->sy=sy; m->sz=sz; m->bord=bord;
+  m->dx=BENCH_H; m->dy=BENCH_H; m->dz=BENCH_H; m->dt=BENCH_DT;
+
+  float *zPlane=m->zPlane=(float *) malloc(sz*sizeof(float));
+  ZGridPlanes(prob, sz, bord, m->dz, zPlane);
+  float *vpz=m->vpz=(float *) malloc(n*sizeof(float));
+  float *vsv=m->vsv=(float *) malloc(n*sizeof(float));
+  float *epsilon=m->epsilon=(float *) malloc(n*sizeof(float));
+  float *delta=m->delta=(float *) malloc(n*sizeof(float));
+  float *phi=m->phi=(float *) malloc(n*sizeof(float));
+  float *theta=m->theta=(float *) malloc(n*sizeof(float));
+  Medium(prob, sx, sy, sz, zPlane, SIGMA, vpz, vsv, epsilon, delta, phi, theta);
+  CoefInitialize(&m->coef, sx, sy, sz, bord, vpz, vsv, epsilon, delta, phi, theta, zPlane);
+
+  m->pp=(float *) malloc(n*sizeof(float));
+  m->pc=(float *) malloc(n*sizeof(float));
+  m->qp=(float *) malloc(n*sizeof(float));
+  m->qc=(float *) malloc(n*sizeof(float));
+  ModelFields(m);
+}
+
+
+// ModelFree: release the model and the precomputed coefficients
+
+
+static void ModelFree(BenchModel *m) {
+  free(m->pp); free(m->pc); free(m->qp); free(m->qc);
+  CoefFree(&m->coef);
+  free(m->vpz); free(m->vsv); free(m->epsilon); free(m->delta); free(m->phi); free(m->theta);
+  free(m->zPlane);
+}
+
+
+// SetThreads: threads of OpenMP teams and of the pools of the Pthreads and work stealing backends
+
+
+static void SetThreads(int threads) {
+  char buf[16];
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+  snprintf(buf, sizeof(buf), "%d", threads);
+  setenv("OMP_NUM_THREADS", buf, 1);
+}
+
+
+// Energy: package and DRAM energy (J) so far; negative without readable RAPL zones
+
+
+static double Energy() {
+  double package, dram;
+  return MetricsEnergy(&package, &dram) ? package+dram : -1.0;
+}
+
+
+// PrintEnergy: energy per sweep and MSamples per joule of trials sweeps, or - without energy
+
+
+static void PrintEnergy(char *line, int len, double joules, long samples, int trials) {
+  if (joules > 0.0)
+    snprintf(line, len, " %.4e %9.3f", joules/trials, 1.0e-6*samples*trials/joules);
+  else
+    snprintf(line, len, " - -");
+}
+
+
+// Propagate: times of BENCH_WARMUP+trials DRIVER_Propagate steps over the first sz planes
+//            of the model, and energy of the trials
+
+
+static void Propagate(BenchModel *m, int sz, int trials, double *t, double *joules) {
+  const int sx=m->sx, sy=m->sy, bord=m->bord;
+  DRIVER_Initialize(sx, sy, sz, bord, m->dx, m->dy, m->dz, m->dt,
+		    m->vpz, m->vsv, m->epsilon, m->delta, m->phi, m->theta, &m->coef,
+		    m->pp, m->pc, m->qp, m->qc);
+  *joules=0.0;
+  for (int r=0; r<trials+BENCH_WARMUP; r++) {
+    const double e0=(r >= BENCH_WARMUP) ? Energy() : -1.0;
+    const double t0=wtime();
+    DRIVER_Propagate(sx, sy, sz, bord, m->dx, m->dy, m->dz, m->dt, r+1, &m->coef,
+		     m->pp, m->pc, m->qp, m->qc);
+    SwapArrays(&m->pp, &m->pc, &m->qp, &m->qc);
+    t[r]=wtime()-t0;
+    if (e0 >= 0.0)
+      *joules+=Energy()-e0;
+  }
+  DRIVER_Finalize();
+}
+
+
+// CPU topology: cpus in the order of the close (fill a socket first) and spread
+//               (alternate sockets) pinning policies
+
+
+static int nCpus=0, nSockets=1;
+static int cpuClose[BENCH_MAX_CPUS], cpuSpread[BENCH_MAX_CPUS];
+
+static void Topology() {
+  int socket[BENCH_MAX_CPUS];
+  nCpus=(int) sysconf(_SC_NPROCESSORS_ONLN);
+  if (nCpus > BENCH_MAX_CPUS)
+    nCpus=BENCH_MAX_CPUS;
+  nSockets=1;
+  for (int c=0; c<nCpus; c++) {
+    char name[128];
+    snprintf(name, sizeof(name), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", c);
+    FILE *fp=fopen(name, "r");
+    socket[c]=0;
+    if (fp != NULL) {
+      if (fscanf(fp, "%d", &socket[c]) != 1 || socket[c] < 0)
+	socket[c]=0;
+      fclose(fp);
+    }
+    if (socket[c]+1 > nSockets)
+      nSockets=socket[c]+1;
+  }
+  int k=0;
+  for (int s=0; s<nSockets; s++)
+    for (int c=0; c<nCpus; c++)
+      if (socket[c] == s)
+	cpuClose[k++]=c;
+  int next[BENCH_MAX_CPUS];
+  for (int s=0; s<nSockets; s++)
+    next[s]=0;
+  for (k=0; k<nCpus; ) {
+    for (int s=0; s<nSockets && k<nCpus; s++) {
+      while (next[s] < nCpus && socket[next[s]] != s)
+	next[s]++;
+      if (next[s] < nCpus)
+	cpuSpread[k++]=next[s]++;
+    }
+  }
+}
+
+
+// Pin: pin the threads of OpenMP teams of threads threads by policy close, spread or none;
+//      the threads of the team run the parallel regions of the kernels that follow
+
+
+static void Pin(const char *policy, int threads) {
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+  {
+    const int t=omp_get_thread_num();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (strcmp(policy, "close") == 0)
+      CPU_SET(cpuClose[t%nCpus], &set);
+    else if (strcmp(policy, "spread") == 0)
+      CPU_SET(cpuSpread[t%nCpus], &set);
+    else
+      for (int c=0; c<nCpus; c++)
+	CPU_SET(c, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+#endif
+}
+
+
+// Scaling: strong (fixed n^3 grid) or weak (n^3 points per thread, stacked along z)
+//          scaling of DRIVER_Propagate over the thread ladder and pinning policies;
+//          the model is allocated once for the largest grid
+
+
+static void Scaling(int weak, enum Form prob, const char *formName, int n,
+		    const int *thread, int nThreads, const char *policyList,
+		    int trials, FILE *out) {
+
+  Topology();
+  int maxThreads=1;
+  for (int k=0; k<nThreads; k++)
+    if (thread[k] > maxThreads)
+      maxThreads=thread[k];
+
+  BenchModel m;
+  ModelAllocate(prob, RoundGrid(n, BRICK_X_OR_1), RoundGrid(n, BRICK_Y_OR_1),
+		RoundGrid(weak ? n*maxThreads : n, BRICK_Z_OR_1), &m);
+
+  double flops, bytes;
+  const char *variant=MetricsKernel(formName, &flops, &bytes);
+
+  char line[512];
+  snprintf(line, sizeof(line),
+	   "# %s scaling of %s (%s kernel, %.0lf bytes per sample), %d points per axis%s, %d cpus on %d sockets\n"
+	   "# policy threads sz median_s mad_s msamples_per_s speedup efficiency gbytes_per_s "
+	   "joules_per_step msamples_per_j\n",
+	   weak ? "weak" : "strong", formName, variant, bytes, n, weak ? " per thread" : "",
+	   nCpus, nSockets);
+  printf("%s", line);
+  fprintf(out, "%s", line);
+
+  double *t=(double *) malloc((trials+BENCH_WARMUP)*sizeof(double));
+  double *gbytes=(double *) malloc(nThreads*sizeof(double));
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", policyList);
+  for (char *policy=strtok(buf, ","); policy != NULL; policy=strtok(NULL, ",")) {
+    double t1=0.0;
+    for (int k=0; k<nThreads; k++) {
+      const int sz=weak ? RoundGrid(n*thread[k], BRICK_Z_OR_1) : m.sz;
+      const long samples=(long)(m.sx-2*m.bord)*(m.sy-2*m.bord)*(sz-2*m.bord);
+      SetThreads(thread[k]);
+      Pin(policy, thread[k]);
+      ModelFields(&m);
+      double joules;
+      Propagate(&m, sz, trials, t, &joules);
+      char variant[32];
+      snprintf(variant, sizeof(variant), "propagate-%s", policy);
+      Record(weak ? "weak" : "strong", formName, variant, n, n, weak ? n*thread[k] : n,
+	     thread[k], samples, t+BENCH_WARMUP, trials);
+      double median, mad;
+      Statistics(t+BENCH_WARMUP, trials, &median, &mad);
+
+      // the first rung is the reference; weak scaling compares time per step only
+
+      if (k == 0)
+	t1=median*(weak ? 1.0 : thread[0]);
+      const double speedup=weak ? t1*thread[k]/median : t1/median;
+      const double efficiency=speedup/thread[k];
+      gbytes[k]=1.0e-9*bytes*samples/median;
+      char energy[64];
+      PrintEnergy(energy, sizeof(energy), joules, samples, trials);
+      snprintf(line, sizeof(line), "%-7s %4d %6d %.4e %.4e %10.2f %8.2f %6.3f %8.2f%s\n",
+	       policy, thread[k], sz, median, mad, 1.0e-6*samples/median, speedup, efficiency, gbytes[k],
+	       energy);
+      printf("%s", line);
+      fprintf(out, "%s", line);
+    }
+
+    // bandwidth saturates where a rung within one socket adds less than
+    // BENCH_SATURATION of the bandwidth its extra threads would add at no contention
+
+    const int perSocket=nCpus/nSockets;
+    int saturated=-1;
+    for (int k=1; k<nThreads && thread[k] <= perSocket; k++) {
+      const double ideal=gbytes[k-1]*(thread[k]-thread[k-1])/thread[k-1];
+      if (ideal > 0.0 && (gbytes[k]-gbytes[k-1]) < BENCH_SATURATION*ideal) {
+	saturated=k-1;
+	break;
+      }
+    }
+    if (saturated >= 0)
+      snprintf(line, sizeof(line), "# %s: bandwidth per socket saturates at %d threads, %.2lf GB/s\n",
+	       policy, thread[saturated], gbytes[saturated]);
+    else
+      snprintf(line, sizeof(line), "# %s: bandwidth per socket does not saturate up to %d threads\n",
+	       policy, perSocket);
+    printf("%s", line);
+    fprintf(out, "%s", line);
+  }
+  free(t);
+  free(gbytes);
+  ModelFree(&m);
+}
+
+
+int main(int argc, char** argv) {
+
+  const char *sizeList=BENCH_SIZES;
+  const char *formList=BENCH_FORMS;
+  const char *threadList=NULL;
+  const char *outName=NULL;
+  const char *scaling=NULL;
+  const char *policyList=BENCH_POLICIES;
+  int trials=BENCH_TRIALS;
+  for (int a=1; a<argc; a++) {
+    if (a+1 < argc && strcmp(argv[a], "-n") == 0)
+      sizeList=argv[++a];
+    else if (a+1 < argc && strcmp(argv[a], "-t") == 0)
+      threadList=argv[++a];
+    else if (a+1 < argc && strcmp(argv[a], "-f") == 0)
+      formList=argv[++a];
+    else if (a+1 < argc && strcmp(argv[a], "-r") == 0)
+      trials=atoi(argv[++a]);
+    else if (a+1 < argc && strcmp(argv[a], "-o") == 0)
+      outName=argv[++a];
+    else if (a+1 < argc && strcmp(argv[a], "-s") == 0 &&
+	     (strcmp(argv[a+1], "strong") == 0 || strcmp(argv[a+1], "weak") == 0))
+      scaling=argv[++a];
+    else if (a+1 < argc && strcmp(argv[a], "-p") == 0)
+      policyList=argv[++a];
+    else {
+      printf("usage: %s [-n sizes] [-t threads] [-f formulations] [-r trials] [-o file]\n"
+	     "       %s -s strong|weak [-p policies] [-n size] [-t threads] [-f formulation] [-r trials] [-o file]\n",
+	     argv[0], argv[0]);
+      exit(-1);
+    }
+  }
+  if (trials < 1)
+    trials=1;
+  if (outName == NULL)
+    outName=(scaling != NULL) ? BENCH_SCALING_FILE : BENCH_FILE;
+
+  // thread counts: given, or 1 and all; scaling doubles them from 1 to all
+
+  int size[BENCH_MAX_LIST], thread[BENCH_MAX_LIST];
+  const int nSizes=ParseList(sizeList, size);
+  int nThreads;
+  if (threadList != NULL)
+    nThreads=ParseList(threadList, thread);
+  else {
+#ifdef _OPENMP
+    const int all=(scaling != NULL) ? omp_get_num_procs() : omp_get_max_threads();
+#else
+    const int all=1;
+#endif
+    nThreads=0;
+    for (int k=1; k<all && nThreads<BENCH_MAX_LIST-1; k*=2)
+      if (scaling != NULL || k == 1)
+	thread[nThreads++]=k;
+    thread[nThreads++]=all;
+  }
+
+  enum Form forms[BENCH_MAX_LIST];
+  char formName[BENCH_MAX_LIST][16];
+  int nForms=0;
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", formList);
+  for (char *tok=strtok(buf, ","); tok != NULL && nForms < BENCH_MAX_LIST; tok=strtok(NULL, ",")) {
+    if (!MediumForm(tok, &forms[nForms])) {
+      printf("Input problem formulation (%s) is unknown\n", tok);
+      exit(-1);
+    }
+    snprintf(formName[nForms++], 16, "%s", tok);
+  }
+
+  FILE *out=fopen(outName, "w");
+  if (out == NULL) {
+    printf("cannot write %s\n", outName);
+    exit(-1);
+  }
+  char line[512];
+  snprintf(line, sizeof(line),
+	   "# Benchmark.exe backend %s stencil_order %d time_order %d trials %d warmup %d\n",
+	   BACKEND, 2*STENCIL_RADIUS, TIME_ORDER, trials, BENCH_WARMUP);
+  printf("%s", line);
+  fprintf(out, "%s", line);
+
+  // scaling study of the first formulation and size
+
+  if (scaling != NULL) {
+    Scaling(strcmp(scaling, "weak") == 0, forms[0], formName[0], size[0],
+	    thread, nThreads, policyList, trials, out);
+    fclose(out);
+    return 0;
+  }
+
+  snprintf(line, sizeof(line), "# kernel form n threads median_s mad_s msamples_per_s joules_per_sweep msamples_per_j\n");
+  printf("%s", line);
+  fprintf(out, "%s", line);
+
+  double *t=(double *) malloc((trials+BENCH_WARMUP)*sizeof(double));
+
+  for (int f=0; f<nForms; f++) {
+    for (int s=0; s<nSizes; s++) {
+
+      BenchModel m;
+      ModelAllocate(forms[f], RoundGrid(size[s], BRICK_X_OR_1), RoundGrid(size[s], BRICK_Y_OR_1),
+		    RoundGrid(size[s], BRICK_Z_OR_1), &m);
+      const int sx=m.sx, sy=m.sy, sz=m.sz, bord=m.bord;
+      const long n=(long)sx*sy*sz;
+      const long samples=(long)(sx-2*bord)*(sy-2*bord)*(sz-2*bord);
+
+      for (int th=0; th<nThreads; th++) {
+	SetThreads(thread[th]);
+
+	for (int k=0; k<NKERNELS; k++) {
+#ifdef BRICK
+	  // components and samples assume row-major storage
+	  if (k != PROPAGATE)
+	    continue;
+#endif
+	  double joules=0.0;
+	  if (k == PROPAGATE)
+	    Propagate(&m, sz, trials, t, &joules);
+	  else
+	    for (int r=0; r<trials+BENCH_WARMUP; r++) {
+	      const double e0=(r >= BENCH_WARMUP) ? Energy() : -1.0;
+	      const double t0=wtime();
+	      switch (k) {
+	      case SAMPLE_ISO_K:
+		SampleISO(sx, sy, sz, bord, m.dx, m.dy, m.dz, m.dt, &m.coef, m.pp, m.pc, m.qp, m.qc);
+		break;
+	      case SAMPLE_VTI_K:
+		SampleVTI(sx, sy, sz, bord, m.dx, m.dy, m.dz, m.dt, &m.coef, m.pp, m.pc, m.qp, m.qc);
+		break;
+	      case SAMPLE_TTI_K:
+		SampleTTI(sx, sy, sz, bord, m.dx, m.dy, m.dz, m.dt, &m.coef, m.pp, m.pc, m.qp, m.qc);
+		break;
+	      default:
+		Component(k, sx, sy, sz, bord, m.dx, m.dz, m.pc, m.pp);
+	      }
+	      t[r]=wtime()-t0;
+	      if (e0 >= 0.0)
+		joules+=Energy()-e0;
+
+	      // samples rewrite pp and qp from pc and qc: restore them to keep values normal
+
+	      for (long i=0; i<n; i++)
+		m.pp[i]=m.qp[i]=1.0f+sinf(1.0e-3f*i);
+	    }
+
+	  Record("bench", formName[f], kernelName[k], size[s], size[s], size[s],
+		 thread[th], samples, t+BENCH_WARMUP, trials);
+	  double median, mad;
+	  Statistics(t+BENCH_WARMUP, trials, &median, &mad);
+	  char energy[64];
+	  PrintEnergy(energy, sizeof(energy), joules, samples, trials);
+	  snprintf(line, sizeof(line), "%-12s %-4s %5d %4d %.4e %.4e %10.2f%s\n",
+		   kernelName[k], formName[f], size[s], thread[th], median, mad, 1.0e-6*samples/median,
+		   energy);
+	  printf("%s", line);
+	  fprintf(out, "%s", line);
+	  fflush(out);
+	}
+      }
+      ModelFree(&m);
+    }
+  }
+  free(t);
+  fclose(out);
+  return 0;
+}
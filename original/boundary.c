@@ -21,7 +21,8 @@ void RandomVelocityBoundary(int sx, int sy, int sz,
   maxP=0.0; maxS=0.0;
   for (iz=bord+absorb; iz<nz+bord+absorb; iz++) {
     for (iy=bord+absorb; iy<ny+bord+absorb; iy++) {
-      for (i=ind(bord+absorb,iy,iz); i<ind(nx+bord+absorb,iy,iz); i++) {
+      for (ix=bord+absorb; ix<nx+bord+absorb; ix++) {
+	i=ind(ix,iy,iz);
 	maxP=fmaxf(vpz[i],maxP);
 	maxS=fmaxf(vsv[i],maxS);
       }
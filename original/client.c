@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+
+
+// client.exe: submit propagation jobs to a ModelagemFletcher.exe server (SERVE mode)
+// and report their queueing and latency.
+//
+// usage: client.exe socket submit name ix iy iz tmax [count [dtOutput]]
+//            count jobs at once (named name, or name_0 ... with count>1), waiting for all;
+//            ix, iy, iz grid indices of the source (-1 for the centre), tmax<=0 for the
+//            tmax of the server
+//        client.exe socket stats        queue of the server
+//        client.exe socket shutdown     stop the server once its queue is empty
+
+
+#define CLIENT_MAX_JOBS 1024
+
+
+static double Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec+1.0e-9*ts.tv_nsec;
+}
+
+
+// Connect: connection to the server, -1 if there is none
+
+
+static int Connect(const char *socketName) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  strncpy(addr.sun_path, socketName, sizeof(addr.sun_path)-1);
+  const int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+    printf("cannot connect to %s\n", socketName);
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+// ReadLine: next reply line of a connection, without the newline; 0 if there is none
+
+
+static int ReadLine(int fd, char *line) {
+  int n=0;
+  while (n < SERVER_LINE-1) {
+    const ssize_t r=read(fd, line+n, 1);
+    if (r <= 0 || line[n] == '\n')
+      break;
+    n++;
+  }
+  line[n]='\0';
+  return n > 0;
+}
+
+
+// Request: one request and its single reply
+
+
+static int Request(const char *socketName, const char *request, char *reply) {
+  const int fd=Connect(socketName);
+  if (fd < 0)
+    return 0;
+  write(fd, request, strlen(request));
+  const int ok=ReadLine(fd, reply);
+  close(fd);
+  return ok;
+}
+
+
+static int CompareDouble(const void *a, const void *b) {
+  const double x=*(const double *)a, y=*(const double *)b;
+  return (x > y) - (x < y);
+}
+
+
+// Submit: count jobs at once; every job is answered on its own connection
+
+
+static int Submit(const char *socketName, const char *name, int ix, int iy, int iz,
+		  float tmax, int count, float dtOutput) {
+  int fd[CLIENT_MAX_JOBS], ahead[CLIENT_MAX_JOBS];
+  double tSent[CLIENT_MAX_JOBS], latency[CLIENT_MAX_JOBS], wait[CLIENT_MAX_JOBS], run[CLIENT_MAX_JOBS];
+  char line[SERVER_LINE];
+  for (int k=0; k<count; k++) {
+    char jobName[SERVER_LINE/2];
+    if (count > 1)
+      snprintf(jobName, sizeof(jobName), "%s_%d", name, k);
+    else
+      snprintf(jobName, sizeof(jobName), "%s", name);
+    if (dtOutput > 0.0f)
+      snprintf(line, SERVER_LINE, "RUN %d %d %d %f %s %f\n", ix, iy, iz, tmax, jobName, dtOutput);
+    else
+      snprintf(line, SERVER_LINE, "RUN %d %d %d %f %s\n", ix, iy, iz, tmax, jobName);
+    tSent[k]=Now();
+    if ((fd[k]=Connect(socketName)) < 0)
+      return 1;
+    write(fd[k], line, strlen(line));
+    int id;
+    if (!ReadLine(fd[k], line) || sscanf(line, "QUEUED %d %d", &id, &ahead[k]) != 2) {
+      printf("job %s not queued: %s\n", jobName, line);
+      close(fd[k]);
+      fd[k]=-1;
+    }
+  }
+
+  // answers in the order the jobs end
+
+  int done=0, failed=0, pending=0;
+  struct pollfd pfd[CLIENT_MAX_JOBS];
+  for (int k=0; k<count; k++) {
+    pfd[k].fd=fd[k];
+    pfd[k].events=POLLIN;
+    pending+=(fd[k] >= 0);
+    failed+=(fd[k] < 0);
+  }
+  while (pending > 0 && poll(pfd, count, -1) > 0)
+    for (int k=0; k<count; k++) {
+      if (pfd[k].fd < 0 || pfd[k].revents == 0)
+	continue;
+      const double t=Now();
+      char path[SERVER_LINE];
+      int id, steps;
+      double setup, msamples;
+      if (ReadLine(fd[k], line) &&
+	  sscanf(line, "DONE %d %s %d %lf %lf %lf %lf", &id, path, &steps,
+		 &wait[done], &setup, &run[done], &msamples) == 7) {
+	latency[done]=t-tSent[k];
+	printf("job %d: %d steps, %.0lf MSamples/s, queued behind %d; latency %.3lf s (wait %.3lf, setup %.3lf, run %.3lf) -> %s\n",
+	       id, steps, msamples, ahead[k], latency[done], wait[done], setup, run[done], path);
+	done++;
+      } else {
+	printf("job failed: %s\n", line);
+	failed++;
+      }
+      close(fd[k]);
+      pfd[k].fd=-1;
+      pending--;
+    }
+
+  if (done > 0) {
+    double sum=0.0, waitSum=0.0, runSum=0.0;
+    for (int k=0; k<done; k++) {
+      sum+=latency[k];
+      waitSum+=wait[k];
+      runSum+=run[k];
+    }
+    qsort(latency, done, sizeof(double), CompareDouble);
+    printf("%d jobs done, %d failed in %.3lf s; latency min %.3lf p50 %.3lf mean %.3lf max %.3lf s; "
+	   "wait mean %.3lf s; run mean %.3lf s\n",
+	   done, failed, latency[done-1], latency[0], latency[done/2], sum/done, latency[done-1],
+	   waitSum/done, runSum/done);
+  }
+  return failed > 0;
+}
+
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    printf("usage: %s socket submit name ix iy iz tmax [count [dtOutput]]\n", argv[0]);
+    printf("       %s socket stats|shutdown\n", argv[0]);
+    exit(-1);
+  }
+  const char *socketName=argv[1];
+  char reply[SERVER_LINE];
+
+  if (strcmp(argv[2], "submit") == 0) {
+    if (argc < 8) {
+      printf("submit requires name ix iy iz tmax\n");
+      exit(-1);
+    }
+    int count=(argc > 8) ? atoi(argv[8]) : 1;
+    if (count < 1 || count > CLIENT_MAX_JOBS) {
+      printf("count must be in 1..%d\n", CLIENT_MAX_JOBS);
+      exit(-1);
+    }
+    exit(Submit(socketName, argv[3], atoi(argv[4]), atoi(argv[5]), atoi(argv[6]), atof(argv[7]),
+		count, (argc > 9) ? atof(argv[9]) : 0.0f));
+  } else if (strcmp(argv[2], "stats") == 0) {
+    int workers, queued, running, done, failed;
+    double wait, run;
+    if (!Request(socketName, "STATS\n", reply) ||
+	sscanf(reply, "STATS %d %d %d %d %d %lf %lf", &workers, &queued, &running, &done, &failed,
+	       &wait, &run) != 7) {
+      printf("no answer from %s\n", socketName);
+      exit(1);
+    }
+    printf("%d workers: %d jobs queued, %d running, %d done, %d failed; wait mean %.3lf s, run mean %.3lf s\n",
+	   workers, queued, running, done, failed, wait, run);
+  } else if (strcmp(argv[2], "shutdown") == 0) {
+    if (!Request(socketName, "SHUTDOWN\n", reply)) {
+      printf("no answer from %s\n", socketName);
+      exit(1);
+    }
+    printf("%s\n", reply);
+  } else {
+    printf("unknown command %s\n", argv[2]);
+    exit(-1);
+  }
+  return 0;
+}
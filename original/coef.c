@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "coef.h"
+#include "map.h"
+#include "zgrid.h"
+#include "sample.h"
+#include "metrics.h"
+
+
+// CoefInitialize: coefficients of the medium of a grid of sx*sy*sz points with border bord;
+//                 zPlane is the z coordinate of each plane
+
+
+void CoefInitialize(CoefT *coef, int sx, int sy, int sz, int bord,
+		    const float *vpz, const float *vsv, const float *epsilon, const float *delta,
+		    const float *phi, const float *theta, const float *zPlane) {
+  memset(coef, 0, sizeof(CoefT));
+  CoefReserve(coef, (long)sx*sy*sz, sz);
+  CoefUpdate(coef, COEF_ALL, sx, sy, sz, bord, vpz, vsv, epsilon, delta, phi, theta, zPlane);
+}
+
+
+// CoefReserve: room for grids of up to points grid points and planes planes; arrays
+//              that grow lose their contents
+
+
+void CoefReserve(CoefT *coef, long points, int planes) {
+  if (points > coef->points) {
+    float **array[10]={&coef->ch1dxx, &coef->ch1dyy, &coef->ch1dzz, &coef->ch1dxy, &coef->ch1dyz,
+		       &coef->ch1dxz, &coef->v2px, &coef->v2pz, &coef->v2sz, &coef->v2pn};
+    for (int k=0; k<10; k++) {
+      free(*array[k]);
+      *array[k]=(float *) malloc(points*sizeof(float));
+    }
+#ifdef SPECIALIZE
+    // one class per block, fewer blocks than points
+    free(coef->tileClass);
+    coef->tileClass=(unsigned char *) malloc(points*sizeof(unsigned char));
+#endif
+    coef->points=points;
+  }
+#ifdef NONUNIFORM_Z
+  if (planes > coef->planes) {
+    free(coef->zd1);
+    free(coef->zw2);
+    coef->zd1=(float *) malloc(planes*sizeof(float));
+    coef->zw2=(float *) malloc(planes*STENCIL_WIDTH*sizeof(float));
+    coef->planes=planes;
+  }
+#endif
+}
+
+
+// CoefUpdate: recompute the parts (COEF_*) of the coefficients that depend on a changed
+//             medium of a grid of sx*sy*sz points, that must fit in the room reserved
+
+
+void CoefUpdate(CoefT *coef, int parts, int sx, int sy, int sz, int bord,
+		const float *vpz, const float *vsv, const float *epsilon, const float *delta,
+		const float *phi, const float *theta, const float *zPlane) {
+
+  float *ch1dxx=coef->ch1dxx, *ch1dyy=coef->ch1dyy, *ch1dzz=coef->ch1dzz;
+  float *ch1dxy=coef->ch1dxy, *ch1dyz=coef->ch1dyz, *ch1dxz=coef->ch1dxz;
+  float *v2px=coef->v2px, *v2pz=coef->v2pz, *v2sz=coef->v2sz, *v2pn=coef->v2pn;
+#ifdef SPECIALIZE
+  unsigned char *tileClass=coef->tileClass;
+#endif
+#ifdef NONUNIFORM_Z
+  float *zd1=coef->zd1, *zw2=coef->zw2;
+#endif
+
+#define MODEL_INITIALIZE
+#include "precomp.h"
+#undef MODEL_INITIALIZE
+}
+
+
+// CoefFree: release the coefficients
+
+
+void CoefFree(CoefT *coef) {
+  free(coef->ch1dxx); free(coef->ch1dyy); free(coef->ch1dzz);
+  free(coef->ch1dxy); free(coef->ch1dyz); free(coef->ch1dxz);
+  free(coef->v2px); free(coef->v2pz); free(coef->v2sz); free(coef->v2pn);
+  free(coef->tileClass);
+  free(coef->zd1);
+  free(coef->zw2);
+  memset(coef, 0, sizeof(CoefT));
+}
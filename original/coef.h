@@ -0,0 +1,74 @@
+#ifndef _COEF
+#define _COEF
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// Coefficients of Fletcher's equations at every grid point, precomputed from the
+// medium (precomp.h). They belong to one model: kernels read them through the
+// CoefT handed to the driver, so that several models live in one process. The arrays
+// have room for a number of grid points and planes, so that a CoefT is reused across
+// grids up to that size, and recomputed in parts when only part of the medium changes.
+
+
+#define COEF_ANGLES 1            // ch1d*, from phi and theta
+#define COEF_VELOCITIES 2        // v2*, from vpz, vsv, epsilon and delta
+#define COEF_PLANES 4            // zd1 and zw2, from the z coordinate of the planes
+#define COEF_ALL (COEF_ANGLES | COEF_VELOCITIES | COEF_PLANES)
+
+
+typedef struct {
+  float *ch1dxx;             // coeficients of derivatives at H1 operator
+  float *ch1dyy;
+  float *ch1dzz;
+  float *ch1dxy;
+  float *ch1dyz;
+  float *ch1dxz;
+  float *v2px;               // coeficient of H2(p)
+  float *v2pz;               // coeficient of H1(q)
+  float *v2sz;               // coeficient of H1(p-q) and H2(p-q)
+  float *v2pn;               // coeficient of H2(p)
+  unsigned char *tileClass;  // sample variant of each block (SPECIALIZE)
+  float *zd1;                // derivative of the plane index with respect to z (NONUNIFORM_Z)
+  float *zw2;                // weights of the second z derivative at each plane (NONUNIFORM_Z)
+  long points;               // grid points the arrays have room for
+  int planes;                // planes zd1 and zw2 have room for
+} CoefT;
+
+
+// CoefInitialize: coefficients of the medium of a grid of sx*sy*sz points with border bord;
+//                 zPlane is the z coordinate of each plane
+
+
+void CoefInitialize(CoefT *coef, int sx, int sy, int sz, int bord,
+		    const float *vpz, const float *vsv, const float *epsilon, const float *delta,
+		    const float *phi, const float *theta, const float *zPlane);
+
+
+// CoefReserve: room for grids of up to points grid points and planes planes; arrays
+//              that grow lose their contents
+
+
+void CoefReserve(CoefT *coef, long points, int planes);
+
+
+// CoefUpdate: recompute the parts (COEF_*) of the coefficients that depend on a changed
+//             medium of a grid of sx*sy*sz points, that must fit in the room reserved
+
+
+void CoefUpdate(CoefT *coef, int parts, int sx, int sy, int sz, int bord,
+		const float *vpz, const float *vsv, const float *epsilon, const float *delta,
+		const float *phi, const float *theta, const float *zPlane);
+
+
+// CoefFree: release the coefficients
+
+
+void CoefFree(CoefT *coef);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -15,3 +15,66 @@ PGCC_LIBS=-lm
 
 # PAPI flags
 PAPI_LIBS=-lpapi
+
+# Optional features (make FEATURE=1), seen by the main Makefile and by the backends
+
+# bricked storage of all grid arrays; brick size with -DBRICK_X=.. -DBRICK_Y=.. -DBRICK_Z=.. in COMMON_FLAGS
+ifdef BRICK
+override COMMON_FLAGS += -DBRICK
+endif
+
+# half precision storage of the wave fields in the OpenMP backend (HALF=fp16 or HALF=bf16)
+ifeq ($(HALF),fp16)
+override COMMON_FLAGS += -DHALF -DHALF_FP16
+endif
+ifeq ($(HALF),bf16)
+override COMMON_FLAGS += -DHALF -DHALF_BF16
+endif
+
+# per block ISO/VTI/TTI sample variants in the OpenMP backend
+ifdef SPECIALIZE
+override COMMON_FLAGS += -DSPECIALIZE
+endif
+
+# stencil order (STENCIL_ORDER=2, 4, 8, 12 or 16; default 8) and
+# dispersion optimized coefficients (STENCIL_OPTIMIZED=1), see dispersion.exe
+ifdef STENCIL_ORDER
+override COMMON_FLAGS += -DSTENCIL_ORDER=$(STENCIL_ORDER)
+endif
+ifdef STENCIL_OPTIMIZED
+override COMMON_FLAGS += -DSTENCIL_OPTIMIZED
+endif
+
+# time integrator order (TIME_ORDER=2 or 4; default 2); 4 in the OpenMP backend only
+ifdef TIME_ORDER
+override COMMON_FLAGS += -DTIME_ORDER=$(TIME_ORDER)
+endif
+
+# leapfrog with the source as a forcing at its own time, as TIME_ORDER=4 does, instead of
+# added to the current field (SOURCE_FORCING=1, OpenMP backend only)
+ifdef SOURCE_FORCING
+override COMMON_FLAGS += -DSOURCE_FORCING
+endif
+
+# stretched z axis following the velocity with depth (CPU backends), outputs regridded to uniform z
+ifdef NONUNIFORM_Z
+override COMMON_FLAGS += -DNONUNIFORM_Z
+endif
+
+# fused energy, max |p| and non finite count in the OpenMP propagate kernel, logged
+# every FLETCHER_DIAG_EVERY steps; on divergence the fields are dumped and the run stops
+ifdef DIAG
+override COMMON_FLAGS += -DDIAG
+endif
+
+# per thread timeline of kernel chunks, source insertion, swaps and outputs, written
+# at exit as a Chrome trace to $FLETCHER_TRACE when set
+ifdef TRACE
+override COMMON_FLAGS += -DTRACE
+endif
+
+# run time specialized propagate kernel in the OpenMP backend, loaded with dlopen
+ifdef JIT
+override COMMON_FLAGS += -DJIT
+GCC_LIBS += -ldl
+endif
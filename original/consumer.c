@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "consumer.h"
+#include "map.h"
+#include "walltime.h"
+#include "trace.h"
+
+#define CONSUMER_NAME 256
+
+
+// one of the two buffers of published snapshots
+
+typedef struct {
+  float *p, *q;
+  int it;
+  float t;
+  int hasQ;
+  int ready;                 // published and not yet consumed
+  double tPublish;           // wtime of the publication
+} SlotT;
+
+
+struct ConsumerS {
+  int sx, sy, sz, bord;
+  int nFn;
+  ConsumerFn fn[CONSUMER_MAX];
+  void *arg[CONSUMER_MAX];
+
+  SlotT slot[2];
+  int next;                  // slot of the next publication
+  int started, stop;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;    // a slot was published or consumed, or stop was set
+
+  // measurements, in seconds
+
+  int nSnap;
+  double copy, stall, stallMax;
+  double run, runMax;        // callbacks of a snapshot
+  double latency, latencyMax;  // from publication to the end of its callbacks
+};
+
+
+// Consume: thread of the consumer; runs the callbacks of every snapshot in the order published
+
+
+static void *Consume(void *a) {
+  ConsumerT *c=(ConsumerT *) a;
+  for (int k=0; ; k^=1) {
+    SlotT *s=&c->slot[k];
+    pthread_mutex_lock(&c->lock);
+    while (!s->ready && !c->stop)
+      pthread_cond_wait(&c->changed, &c->lock);
+    const int ready=s->ready;
+    pthread_mutex_unlock(&c->lock);
+    if (!ready)
+      break;
+
+    const SnapshotT snap={s->it, s->t, c->sx, c->sy, c->sz, c->bord,
+			  s->p, s->hasQ ? s->q : NULL};
+    const double t0=wtime();
+    TRACE_BEGIN(tConsumer);
+    for (int f=0; f<c->nFn; f++)
+      c->fn[f](&snap, c->arg[f]);
+    TRACE_END(tConsumer, TRACE_CONSUMER, s->it);
+    const double t1=wtime();
+
+    pthread_mutex_lock(&c->lock);
+    c->run+=t1-t0;
+    c->runMax=fmax(c->runMax, t1-t0);
+    c->latency+=t1-s->tPublish;
+    c->latencyMax=fmax(c->latencyMax, t1-s->tPublish);
+    s->ready=0;
+    pthread_cond_broadcast(&c->changed);
+    pthread_mutex_unlock(&c->lock);
+  }
+  return NULL;
+}
+
+
+// ConsumerCreate: consumer of snapshots of a grid of sx*sy*sz points with border bord,
+//                 with no callbacks; its thread starts at the first publication
+
+
+ConsumerT *ConsumerCreate(int sx, int sy, int sz, int bord) {
+  ConsumerT *c=(ConsumerT *) calloc(1, sizeof(ConsumerT));
+  c->sx=sx; c->sy=sy; c->sz=sz; c->bord=bord;
+  pthread_mutex_init(&c->lock, NULL);
+  pthread_cond_init(&c->changed, NULL);
+  return c;
+}
+
+
+// ConsumerRegister: add callback fn with argument arg, before the first publication;
+//                   returns 0 if there is no room or publishing has started
+
+
+int ConsumerRegister(ConsumerT *c, ConsumerFn fn, void *arg) {
+  if (c->started || c->nFn == CONSUMER_MAX)
+    return 0;
+  c->fn[c->nFn]=fn;
+  c->arg[c->nFn]=arg;
+  c->nFn++;
+  return 1;
+}
+
+
+// ConsumerPublish: hand the p and q (may be NULL) fields of time step it at simulated
+//                  time t to the callbacks; the fields may change once it returns
+
+
+void ConsumerPublish(ConsumerT *c, int it, float t, const float *p, const float *q) {
+  if (c->nFn == 0)
+    return;
+  const long n=(long)c->sx*c->sy*c->sz;
+  if (!c->started) {
+    for (int k=0; k<2; k++) {
+      c->slot[k].p=(float *) malloc(n*sizeof(float));
+      c->slot[k].q=(float *) malloc(n*sizeof(float));
+    }
+    c->started=1;
+    pthread_create(&c->thread, NULL, Consume, c);
+  }
+
+  // wait for the callbacks of the snapshot published two calls ago
+
+  SlotT *s=&c->slot[c->next];
+  const double t0=wtime();
+  TRACE_BEGIN(tStall);
+  pthread_mutex_lock(&c->lock);
+  while (s->ready)
+    pthread_cond_wait(&c->changed, &c->lock);
+  pthread_mutex_unlock(&c->lock);
+  TRACE_END(tStall, TRACE_STALL, it);
+  const double t1=wtime();
+
+  // the consumer thread does not touch a slot that is not ready
+
+  memcpy(s->p, p, n*sizeof(float));
+  if (q != NULL)
+    memcpy(s->q, q, n*sizeof(float));
+  s->hasQ=(q != NULL);
+  s->it=it;
+  s->t=t;
+  const double t2=wtime();
+
+  pthread_mutex_lock(&c->lock);
+  s->tPublish=t2;
+  s->ready=1;
+  c->nSnap++;
+  c->stall+=t1-t0;
+  c->stallMax=fmax(c->stallMax, t1-t0);
+  c->copy+=t2-t1;
+  pthread_cond_broadcast(&c->changed);
+  pthread_mutex_unlock(&c->lock);
+  c->next^=1;
+}
+
+
+// ConsumerFree: wait for the callbacks of every published snapshot, report their
+//               latency and the stall time of publishing, and release the consumer
+
+
+void ConsumerFree(ConsumerT *c) {
+  if (c->started) {
+    pthread_mutex_lock(&c->lock);
+    c->stop=1;
+    pthread_cond_broadcast(&c->changed);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+  }
+  if (c->nSnap > 0) {
+    printf("Snapshot consumers: %d snapshots to %d callbacks, copy %.3lf ms per snapshot\n",
+	   c->nSnap, c->nFn, 1.0e3*c->copy/c->nSnap);
+    printf("Consumer callbacks (ms): mean %.3lf max %.3lf; latency from publication mean %.3lf max %.3lf; "
+	   "publication stalls %.3lf total, max %.3lf\n",
+	   1.0e3*c->run/c->nSnap, 1.0e3*c->runMax, 1.0e3*c->latency/c->nSnap, 1.0e3*c->latencyMax,
+	   1.0e3*c->stall, 1.0e3*c->stallMax);
+  }
+  for (int k=0; k<2; k++) {
+    free(c->slot[k].p);
+    free(c->slot[k].q);
+  }
+  pthread_cond_destroy(&c->changed);
+  pthread_mutex_destroy(&c->lock);
+  free(c);
+}
+
+
+// Summary: built-in callback; maximum magnitude and rms of p over the internal points
+
+
+static void Summary(const SnapshotT *snap, void *arg) {
+  const int sx=snap->sx, sy=snap->sy, sz=snap->sz, bord=snap->bord;
+  double maxP=0.0, sum2=0.0;
+  for (int iz=bord; iz<sz-bord; iz++)
+    for (int iy=bord; iy<sy-bord; iy++)
+      for (int ix=bord; ix<sx-bord; ix++) {
+	const double v=snap->p[ind(ix,iy,iz)];
+	maxP=fmax(maxP, fabs(v));
+	sum2+=v*v;
+      }
+  const double n=(double)(sx-2*bord)*(sy-2*bord)*(sz-2*bord);
+  printf("consumer: step %d time %f max|p| %e rms(p) %e\n", snap->it, snap->t, maxP, sqrt(sum2/n));
+}
+
+
+// ConsumerBuiltin: consumer with the built-in callbacks named in $FLETCHER_CONSUMER
+//                  (comma separated: summary); NULL if it names none
+
+
+ConsumerT *ConsumerBuiltin(int sx, int sy, int sz, int bord) {
+  const char *env=getenv("FLETCHER_CONSUMER");
+  if (env == NULL || env[0] == '\0')
+    return NULL;
+  char names[CONSUMER_NAME];
+  strncpy(names, env, CONSUMER_NAME-1);
+  names[CONSUMER_NAME-1]='\0';
+
+  ConsumerT *c=ConsumerCreate(sx, sy, sz, bord);
+  for (char *save, *name=strtok_r(names, ",", &save); name != NULL; name=strtok_r(NULL, ",", &save))
+    if (strcmp(name, "summary") == 0)
+      ConsumerRegister(c, Summary, NULL);
+    else
+      printf("ConsumerBuiltin: unknown consumer %s\n", name);
+  if (c->nFn == 0) {
+    ConsumerFree(c);
+    return NULL;
+  }
+  return c;
+}
@@ -0,0 +1,76 @@
+#ifndef _CONSUMER
+#define _CONSUMER
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// In-process consumers of the output snapshots: callbacks registered on a ConsumerT
+// get a read-only view of the p and q fields of every published output step, with
+// its step metadata, and run in registration order on a thread of the ConsumerT.
+// Publishing copies the fields into the free one of two buffers and returns, so
+// propagation overlaps the callbacks of the previous snapshot; it waits (a stall)
+// only when the callbacks fall more than one snapshot behind. ModelagemFletcher.exe
+// publishes its outputs to the built-in consumers named by $FLETCHER_CONSUMER.
+
+
+#define CONSUMER_MAX 8           // callbacks of a ConsumerT
+
+
+typedef struct ConsumerS ConsumerT;
+
+
+typedef struct {
+  int it;                    // time step of the snapshot
+  float t;                   // simulated time
+  int sx, sy, sz, bord;      // grid dimensions and border
+  const float *p;            // p field over the whole grid
+  const float *q;            // q field over the whole grid; NULL if not published
+} SnapshotT;
+
+
+// ConsumerFn: callback of a snapshot; the view is valid until the callback returns
+
+
+typedef void (*ConsumerFn)(const SnapshotT *snap, void *arg);
+
+
+// ConsumerCreate: consumer of snapshots of a grid of sx*sy*sz points with border bord,
+//                 with no callbacks; its thread starts at the first publication
+
+
+ConsumerT *ConsumerCreate(int sx, int sy, int sz, int bord);
+
+
+// ConsumerRegister: add callback fn with argument arg, before the first publication;
+//                   returns 0 if there is no room or publishing has started
+
+
+int ConsumerRegister(ConsumerT *c, ConsumerFn fn, void *arg);
+
+
+// ConsumerPublish: hand the p and q (may be NULL) fields of time step it at simulated
+//                  time t to the callbacks; the fields may change once it returns
+
+
+void ConsumerPublish(ConsumerT *c, int it, float t, const float *p, const float *q);
+
+
+// ConsumerFree: wait for the callbacks of every published snapshot, report their
+//               latency and the stall time of publishing, and release the consumer
+
+
+void ConsumerFree(ConsumerT *c);
+
+
+// ConsumerBuiltin: consumer with the built-in callbacks named in $FLETCHER_CONSUMER
+//                  (comma separated: summary); NULL if it names none
+
+
+ConsumerT *ConsumerBuiltin(int sx, int sy, int sz, int bord);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -7,6 +7,22 @@
 #include <string.h>
 
 
+// stencil order (make STENCIL_ORDER=2, 4, 8, 12 or 16; default 8) and coefficient set:
+// Taylor coefficients of maximum order or, with make STENCIL_OPTIMIZED=1, dispersion
+// optimized ones that keep the relative error of the derivatives below 1e-3 up to higher
+// wavenumbers, hence at fewer points per wavelength; dispersion.exe prints both sets and
+// their accuracy against cost. The border (bord) and tile halos are STENCIL_RADIUS points.
+
+
+#ifndef STENCIL_ORDER
+#define STENCIL_ORDER 8
+#endif
+
+#if STENCIL_ORDER == 8 && !defined(STENCIL_OPTIMIZED)
+
+#define STENCIL_RADIUS 4
+
+
 // eight order finite differences coefficients of the first derivative
 
 
@@ -67,4 +83,224 @@
        L34*(p[i+(3*s21)+(4*s11)]-p[i+(3*s21)-(4*s11)]-p[i-(3*s21)+(4*s11)]+p[i-(3*s21)-(4*s11)]+p[i+(4*s21)+(3*s11)]-p[i+(4*s21)-(3*s11)]-p[i-(4*s21)+(3*s11)]+p[i-(4*s21)-(3*s11)])+  \
        L44*(p[i+(4*s21)+(4*s11)]-p[i+(4*s21)-(4*s11)]-p[i-(4*s21)+(4*s11)]+p[i-(4*s21)-(4*s11)]))*(dinv))
 
+#else
+
+
+// coefficients of the first (L) and second (K) derivatives, as printed by dispersion.exe -c
+
+
+#if STENCIL_ORDER == 2
+
+#define STENCIL_RADIUS 1
+
+#ifdef STENCIL_OPTIMIZED
+#error "order 2 has no dispersion optimized coefficients: its single coefficient is fixed by consistency"
+#endif
+#define L1 0.5f
+#define K0 -2.0f
+#define K1 1.0f
+
+#elif STENCIL_ORDER == 4
+
+#define STENCIL_RADIUS 2
+
+#ifdef STENCIL_OPTIMIZED
+#define L1 0.6784315748523293f
+#define L2 -0.089215787426164692f
+#define K0 -2.5408261178685749f
+#define K1 1.3605507452457166f
+#define K2 -0.090137686311429183f
+#else
+#define L1 0.66666666666666663f
+#define L2 -0.083333333333333329f
+#define K0 -2.5f
+#define K1 1.3333333333333333f
+#define K2 -0.083333333333333329f
+#endif
+
+#elif STENCIL_ORDER == 8
+
+#define STENCIL_RADIUS 4
+
+#ifdef STENCIL_OPTIMIZED
+#define L1 0.85428418896121072f
+#define L2 -0.26047800879071742f
+#define L3 0.069379043872842994f
+#define L4 -0.010366325749576232f
+#define K0 -3.0100957623911122f
+#define K1 1.7358427410595596f
+#define K2 -0.27713743561197635f
+#define K3 0.052682030082745572f
+#define K4 -0.0063394543347727681f
+#else
+#define L1 0.80000000000000004f
+#define L2 -0.20000000000000001f
+#define L3 0.038095238095238092f
+#define L4 -0.0035714285714285713f
+#define K0 -2.8472222222222223f
+#define K1 1.6000000000000001f
+#define K2 -0.20000000000000001f
+#define K3 0.025396825396825397f
+#define K4 -0.0017857142857142857f
+#endif
+
+#elif STENCIL_ORDER == 12
+
+#define STENCIL_RADIUS 6
+
+#ifdef STENCIL_OPTIMIZED
+#define L1 0.92360651399876526f
+#define L2 -0.36182146494168266f
+#define L3 0.15731869308895413f
+#define L4 -0.061479702025359483f
+#define L5 0.018679269147141315f
+#define L6 -0.0032328668360885136f
+#define K0 -3.1667990662894745f
+#define K1 1.8798530062037344f
+#define K2 -0.38818646056669504f
+#define K3 0.12294983401880623f
+#define K4 -0.040756445382079308f
+#define K5 0.011361645758899001f
+#define K6 -0.0018220468879282282f
+#else
+#define L1 0.8571428571428571f
+#define L2 -0.26785714285714285f
+#define L3 0.079365079365079361f
+#define L4 -0.017857142857142856f
+#define L5 0.0025974025974025974f
+#define L6 -0.00018037518037518035f
+#define K0 -2.9827777777777773f
+#define K1 1.7142857142857142f
+#define K2 -0.26785714285714285f
+#define K3 0.052910052910052907f
+#define K4 -0.0089285714285714281f
+#define K5 0.001038961038961039f
+#define K6 -6.0125060125060114e-05f
+#endif
+
+#elif STENCIL_ORDER == 16
+
+#define STENCIL_RADIUS 8
+
+#ifdef STENCIL_OPTIMIZED
+#define L1 0.95459871656194528f
+#define L2 -0.41439554437076143f
+#define L3 0.21679626535313465f
+#define L4 -0.11395291033796479f
+#define L5 0.055847704845928672f
+#define L6 -0.023949826409309531f
+#define L7 0.0081428787594112709f
+#define L8 -0.0016155624522040193f
+#define K0 -3.2252017779377757f
+#define K1 1.9361148826577312f
+#define K2 -0.43840095684544772f
+#define K3 0.16424725802211884f
+#define K4 -0.071728335448663f
+#define K5 0.032184995282595392f
+#define K6 -0.013581257785445573f
+#define K7 0.0046465339726109271f
+#define K8 -0.00088223088661221432f
+#else
+#define L1 0.88888888888888884f
+#define L2 -0.31111111111111106f
+#define L3 0.1131313131313131f
+#define L4 -0.035353535353535345f
+#define L5 0.0087024087024087007f
+#define L6 -0.0015540015540015538f
+#define L7 0.00017760017760017757f
+#define L8 -9.7125097125097108e-06f
+#define K0 -3.0548441043083892f
+#define K1 1.7777777777777777f
+#define K2 -0.31111111111111106f
+#define K3 0.075420875420875402f
+#define K4 -0.017676767676767673f
+#define K5 0.0034809634809634805f
+#define K6 -0.00051800051800051793f
+#define K7 5.0742907885765017e-05f
+#define K8 -2.4281274281274277e-06f
+#endif
+
+#else
+#error "STENCIL_ORDER must be 2, 4, 8, 12 or 16"
+#endif
+
+
+// sums over the stencil points at distance 1 to k, unscaled
+
+
+#define STENCIL_CAT(a, b) STENCIL_CAT2(a, b)
+#define STENCIL_CAT2(a, b) a##b
+
+#define STENCIL_D1_1(p, i, s) (L1*(p[(i)+(s)]-p[(i)-(s)]))
+#define STENCIL_D1_2(p, i, s) (STENCIL_D1_1(p, i, s) + L2*(p[(i)+2*(s)]-p[(i)-2*(s)]))
+#define STENCIL_D1_3(p, i, s) (STENCIL_D1_2(p, i, s) + L3*(p[(i)+3*(s)]-p[(i)-3*(s)]))
+#define STENCIL_D1_4(p, i, s) (STENCIL_D1_3(p, i, s) + L4*(p[(i)+4*(s)]-p[(i)-4*(s)]))
+#define STENCIL_D1_5(p, i, s) (STENCIL_D1_4(p, i, s) + L5*(p[(i)+5*(s)]-p[(i)-5*(s)]))
+#define STENCIL_D1_6(p, i, s) (STENCIL_D1_5(p, i, s) + L6*(p[(i)+6*(s)]-p[(i)-6*(s)]))
+#define STENCIL_D1_7(p, i, s) (STENCIL_D1_6(p, i, s) + L7*(p[(i)+7*(s)]-p[(i)-7*(s)]))
+#define STENCIL_D1_8(p, i, s) (STENCIL_D1_7(p, i, s) + L8*(p[(i)+8*(s)]-p[(i)-8*(s)]))
+
+#define STENCIL_D2_1(p, i, s) (K1*(p[(i)+(s)]+p[(i)-(s)]))
+#define STENCIL_D2_2(p, i, s) (STENCIL_D2_1(p, i, s) + K2*(p[(i)+2*(s)]+p[(i)-2*(s)]))
+#define STENCIL_D2_3(p, i, s) (STENCIL_D2_2(p, i, s) + K3*(p[(i)+3*(s)]+p[(i)-3*(s)]))
+#define STENCIL_D2_4(p, i, s) (STENCIL_D2_3(p, i, s) + K4*(p[(i)+4*(s)]+p[(i)-4*(s)]))
+#define STENCIL_D2_5(p, i, s) (STENCIL_D2_4(p, i, s) + K5*(p[(i)+5*(s)]+p[(i)-5*(s)]))
+#define STENCIL_D2_6(p, i, s) (STENCIL_D2_5(p, i, s) + K6*(p[(i)+6*(s)]+p[(i)-6*(s)]))
+#define STENCIL_D2_7(p, i, s) (STENCIL_D2_6(p, i, s) + K7*(p[(i)+7*(s)]+p[(i)-7*(s)]))
+#define STENCIL_D2_8(p, i, s) (STENCIL_D2_7(p, i, s) + K8*(p[(i)+8*(s)]+p[(i)-8*(s)]))
+
+// the cross derivative is the first derivative along s21 of first derivatives along s11
+
+#define STENCIL_D1(p, i, s) STENCIL_CAT(STENCIL_D1_, STENCIL_RADIUS)(p, i, s)
+
+#define STENCIL_DC_1(p, i, s11, s21) (L1*(STENCIL_D1(p, (i)+(s21), s11)-STENCIL_D1(p, (i)-(s21), s11)))
+#define STENCIL_DC_2(p, i, s11, s21) (STENCIL_DC_1(p, i, s11, s21) + L2*(STENCIL_D1(p, (i)+2*(s21), s11)-STENCIL_D1(p, (i)-2*(s21), s11)))
+#define STENCIL_DC_3(p, i, s11, s21) (STENCIL_DC_2(p, i, s11, s21) + L3*(STENCIL_D1(p, (i)+3*(s21), s11)-STENCIL_D1(p, (i)-3*(s21), s11)))
+#define STENCIL_DC_4(p, i, s11, s21) (STENCIL_DC_3(p, i, s11, s21) + L4*(STENCIL_D1(p, (i)+4*(s21), s11)-STENCIL_D1(p, (i)-4*(s21), s11)))
+#define STENCIL_DC_5(p, i, s11, s21) (STENCIL_DC_4(p, i, s11, s21) + L5*(STENCIL_D1(p, (i)+5*(s21), s11)-STENCIL_D1(p, (i)-5*(s21), s11)))
+#define STENCIL_DC_6(p, i, s11, s21) (STENCIL_DC_5(p, i, s11, s21) + L6*(STENCIL_D1(p, (i)+6*(s21), s11)-STENCIL_D1(p, (i)-6*(s21), s11)))
+#define STENCIL_DC_7(p, i, s11, s21) (STENCIL_DC_6(p, i, s11, s21) + L7*(STENCIL_D1(p, (i)+7*(s21), s11)-STENCIL_D1(p, (i)-7*(s21), s11)))
+#define STENCIL_DC_8(p, i, s11, s21) (STENCIL_DC_7(p, i, s11, s21) + L8*(STENCIL_D1(p, (i)+8*(s21), s11)-STENCIL_D1(p, (i)-8*(s21), s11)))
+
+
+// Der1: computes first derivative
+
+
+#define Der1(p, i, s, dinv) (STENCIL_D1(p, i, s)*(dinv))
+
+
+// Der2: computes second derivative
+
+
+#define Der2(p, i, s, d2inv) ((K0*p[i] + STENCIL_CAT(STENCIL_D2_, STENCIL_RADIUS)(p, i, s))*(d2inv))
+
+
+// DerCross: computes cross derivative
+
+
+#define DerCross(p, i, s11, s21, dinv) (STENCIL_CAT(STENCIL_DC_, STENCIL_RADIUS)(p, i, s11, s21)*(dinv))
+
+#endif
+
+#define STENCIL_WIDTH (2*STENCIL_RADIUS+1)
+
+
+// stretched z axis (make NONUNIFORM_Z=1): second z derivative with per plane weights w,
+// centered on the plane (w[-STENCIL_RADIUS..STENCIL_RADIUS]) and already scaled by the spacing
+
+
+#ifdef NONUNIFORM_Z
+
+
+// Der2Z: computes second derivative along z
+
+
+static inline float Der2Z(const float * restrict p, int i, int s, const float * restrict w) {
+  float d=w[0]*p[i];
+  for (int k=1; k<=STENCIL_RADIUS; k++)
+    d+=w[k]*p[i+k*s] + w[-k]*p[i-k*s];
+  return d;
+}
+
+#endif
 #endif
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+
+// dispersion.exe: coefficients of the centered finite difference stencils of
+// derivatives.h and a study of their accuracy against cost.
+//
+// usage: dispersion.exe [tol]       study, relative error tolerance tol (default 1e-3)
+//        dispersion.exe -c [tol]    coefficients as in derivatives.h
+//
+// For radius R the second derivative stencil has symbol 2*sum_k K_k*(1-cos(k*kh))/h^2
+// and the first derivative stencil 2*sum_k L_k*sin(k*kh)/h. Taylor coefficients cancel
+// the error up to order 2R at kh=0. Dispersion optimized coefficients keep consistency
+// (the error is O(kh^2) at kh=0) and minimize, in least squares, the relative error of
+// the symbol over [0,khMax], where khMax maximizes the band in which the relative error
+// stays below tol.
+
+
+#define MAX_RADIUS 8
+#define NKH 2000              // wavenumbers sampled in a band
+#define NSCAN 400             // khMax values scanned by the optimization
+
+
+static const int orders[]={2, 4, 8, 12, 16};
+#define NORDERS ((int)(sizeof(orders)/sizeof(orders[0])))
+
+
+// Error2, Error1: relative error of the second and first derivative symbols at kh
+
+
+static double Error2(int r, const double *K, double kh) {
+  double s=0.0;
+  for (int k=1; k<=r; k++)
+    s+=2.0*K[k]*(1.0-cos(k*kh));
+  return s/(kh*kh)-1.0;
+}
+
+static double Error1(int r, const double *L, double kh) {
+  double s=0.0;
+  for (int k=1; k<=r; k++)
+    s+=2.0*L[k]*sin(k*kh);
+  return s/kh-1.0;
+}
+
+
+// Band: largest kh such that the relative error stays within tol in (0,kh]
+
+
+static double Band(int r, const double *C, int second, double tol) {
+  const double dkh=M_PI/NKH;
+  for (int n=1; n<=NKH; n++) {
+    const double kh=n*dkh;
+    const double e=second ? Error2(r, C, kh) : Error1(r, C, kh);
+    if (fabs(e) > tol)
+      return (n-1)*dkh;
+  }
+  return M_PI;
+}
+
+
+// Taylor: maximum order coefficients, in closed form
+
+
+static void Taylor(int r, double *K, double *L) {
+  double f=1.0;   // (r!)^2/((r-k)!(r+k)!), updated with k
+  K[0]=0.0;
+  for (int k=1; k<=r; k++) {
+    f*=(double)(r-k+1)/(double)(r+k);
+    const double sign=(k%2) ? 1.0 : -1.0;
+    K[k]=2.0*sign*f/((double)k*k);
+    L[k]=sign*f/(double)k;
+    K[0]-=2.0*K[k];
+  }
+}
+
+
+// Solve: Gaussian elimination with partial pivoting of the n x n system a x = b
+
+
+static void Solve(int n, double a[][MAX_RADIUS+1], double *b, double *x) {
+  for (int c=0; c<n; c++) {
+    int p=c;
+    for (int r=c+1; r<n; r++)
+      if (fabs(a[r][c]) > fabs(a[p][c])) p=r;
+    for (int k=0; k<n; k++) {
+      const double t=a[c][k]; a[c][k]=a[p][k]; a[p][k]=t;
+    }
+    const double t=b[c]; b[c]=b[p]; b[p]=t;
+    for (int r=c+1; r<n; r++) {
+      const double m=a[r][c]/a[c][c];
+      for (int k=c; k<n; k++)
+	a[r][k]-=m*a[c][k];
+      b[r]-=m*b[c];
+    }
+  }
+  for (int r=n-1; r>=0; r--) {
+    double s=b[r];
+    for (int k=r+1; k<n; k++)
+      s-=a[r][k]*x[k];
+    x[r]=s/a[r][r];
+  }
+}
+
+
+// Fit: constrained least squares coefficients C[1..r] of the second (or first)
+//      derivative over (0,khMax]; the constraint keeps the symbol exact at kh=0
+
+
+static void Fit(int r, int second, double khMax, double *C) {
+  double a[MAX_RADIUS+1][MAX_RADIUS+1], b[MAX_RADIUS+1], x[MAX_RADIUS+1], f[MAX_RADIUS+1];
+  memset(a, 0, sizeof(a));
+  memset(b, 0, sizeof(b));
+
+  // normal equations of min sum (sum_k C_k f_k(kh) - 1)^2, plus a Lagrange multiplier row
+
+  for (int n=1; n<=NKH; n++) {
+    const double kh=n*khMax/NKH;
+    for (int k=1; k<=r; k++)
+      f[k-1]=second ? 2.0*(1.0-cos(k*kh))/(kh*kh) : 2.0*sin(k*kh)/kh;
+    for (int j=0; j<r; j++) {
+      for (int k=0; k<r; k++)
+	a[j][k]+=f[j]*f[k];
+      b[j]+=f[j];
+    }
+  }
+  for (int k=1; k<=r; k++) {
+    const double c=second ? (double)k*k : 2.0*k;   // f_k(0)
+    a[k-1][r]=c;
+    a[r][k-1]=c;
+  }
+  a[r][r]=0.0;
+  b[r]=1.0;
+  Solve(r+1, a, b, x);
+  for (int k=1; k<=r; k++)
+    C[k]=x[k-1];
+}
+
+
+// Optimized: dispersion optimized coefficients for tolerance tol
+
+
+static void Optimized(int r, double tol, double *K, double *L) {
+  double T[MAX_RADIUS+1], C[MAX_RADIUS+1];
+  for (int second=0; second<=1; second++) {
+    double *best=second ? K : L;
+    Taylor(r, second ? best : T, second ? T : best);
+    if (r == 1)
+      continue;   // a single coefficient is fixed by consistency
+    double bestBand=Band(r, best, second, tol);
+    for (int n=1; n<=NSCAN; n++) {
+      Fit(r, second, n*M_PI/NSCAN, C);
+      const double band=Band(r, C, second, tol);
+      if (band > bestBand) {
+	bestBand=band;
+	for (int k=1; k<=r; k++)
+	  best[k]=C[k];
+      }
+    }
+  }
+  K[0]=0.0;
+  for (int k=1; k<=r; k++)
+    K[0]-=2.0*K[k];
+}
+
+
+// MaxSymbol: maximum of the second derivative symbol times h^2, that bounds the stable dt
+
+
+static double MaxSymbol(int r, const double *K) {
+  double m=0.0;
+  for (int n=1; n<=NKH; n++) {
+    const double kh=n*M_PI/NKH;
+    m=fmax(m, (Error2(r, K, kh)+1.0)*kh*kh);
+  }
+  return m;
+}
+
+
+// Flops: floating point operations of one sample of the TTI kernel (sample.h) per field;
+//        Der2 adds symmetric pairs first, DerCross groups the 4 corners of each L_a*L_b
+
+
+static int Flops(int r) {
+  const int der2=r + (r+1) + r + 1;
+  const int derCross=4*r*r - 1 + r*(r+1)/2 + r*(r+1)/2 + 1;
+  return 3*der2 + 3*derCross + 20;
+}
+
+
+// PrintCoefficients: coefficients as float literals
+
+
+static void PrintLiteral(char name, int k, double c) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.17g", c);
+  printf("#define %c%d %s%sf\n", name, k, buf, strpbrk(buf, ".e") ? "" : ".0");
+}
+
+static void PrintCoefficients(int r, const char *set, const double *K, const double *L) {
+  printf("// order %d, %s\n", 2*r, set);
+  for (int k=1; k<=r; k++)
+    PrintLiteral('L', k, L[k]);
+  for (int k=0; k<=r; k++)
+    PrintLiteral('K', k, K[k]);
+  printf("\n");
+}
+
+
+// Cost: relative cost of a run at the tolerance: flops per sample, times ppw^3 grid
+//       points, times steps, that grow with ppw and with the maximum symbol
+
+
+static double Cost(int r, const double *K, const double *L, double tol) {
+  const double ppw=2.0*M_PI/fmin(Band(r, K, 1, tol), Band(r, L, 0, tol));
+  return Flops(r)*ppw*ppw*ppw*ppw*sqrt(MaxSymbol(r, K));
+}
+
+
+int main(int argc, char** argv) {
+  int coefficients=0;
+  double tol=1.0e-3;
+  for (int a=1; a<argc; a++) {
+    if (strcmp(argv[a], "-c") == 0)
+      coefficients=1;
+    else
+      tol=atof(argv[a]);
+  }
+  if (!(tol > 0.0)) {
+    printf("usage: %s [-c] [tol]\n", argv[0]);
+    exit(-1);
+  }
+
+  // the 8th order Taylor stencil is the reference
+
+  double K8[MAX_RADIUS+1], L8[MAX_RADIUS+1];
+  Taylor(4, K8, L8);
+  const double cost8=Cost(4, K8, L8, tol);
+  const double symbol8=MaxSymbol(4, K8);
+
+  if (!coefficients) {
+    printf("relative error tolerance %g of the derivative symbols\n", tol);
+    printf("band: largest kh/pi within tolerance, of Der2 and Der1 (DerCross)\n");
+    printf("ppw: points per wavelength at the band edge\n");
+    printf("dt: stable time step relative to the 8th order Taylor stencil\n");
+    printf("cost: flops * ppw^3 grid points * steps, relative to the 8th order Taylor stencil,\n");
+    printf("      for the same tolerance on the same model; time discretization error is not included\n\n");
+    printf("order  coefficients  band(Der2)  band(Der1)    ppw   points  flops      dt      cost\n");
+  }
+
+  for (int o=0; o<NORDERS; o++) {
+    const int r=orders[o]/2;
+    for (int opt=0; opt<=(r > 1); opt++) {
+      double K[MAX_RADIUS+1], L[MAX_RADIUS+1];
+      if (opt)
+	Optimized(r, tol, K, L);
+      else
+	Taylor(r, K, L);
+
+      if (coefficients) {
+	PrintCoefficients(r, opt ? "dispersion optimized" : "Taylor", K, L);
+	continue;
+      }
+
+      const double band2=Band(r, K, 1, tol);
+      const double band1=Band(r, L, 0, tol);
+      printf("%5d  %-12s  %10.3f  %10.3f  %5.2f  %7d  %5d  %6.3f  %8.3f\n",
+	     2*r, opt ? "optimized" : "Taylor", band2/M_PI, band1/M_PI,
+	     2.0*M_PI/fmin(band2, band1), 6*r+1+12*r*r, Flops(r),
+	     sqrt(symbol8/MaxSymbol(r, K)), Cost(r, K, L, tol)/cost8);
+    }
+  }
+  return 0;
+}
@@ -1,26 +1,37 @@
 #ifndef __driver_h__
 #define __driver_h__
 
+#include "coef.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// DRIVER_Initialize is called again, after DRIVER_Finalize, whenever FletcherReset or
+// FletcherReuse restart a context (server jobs, sweep runs), possibly with a smaller
+// grid and another source: a backend keeps no state of an earlier run across them
+
 void DRIVER_Initialize(const int sx, const int sy, const int sz, const int bord,
 		       float dx, float dy, float dz, float dt,
 		       float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
-		       float * restrict phi, float * restrict theta,
+		       float * restrict phi, float * restrict theta, const CoefT *coef,
 		       float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc);
 
 void DRIVER_Finalize();
 
 void DRIVER_Propagate(const int sx, const int sy, const int sz, const int bord,
 	       const float dx, const float dy, const float dz, const float dt, const int it, 
-	       float * pp, float * pc, float * qp, float * qc);
+	       const CoefT *coef, float * pp, float * pc, float * qp, float * qc);
 
 void DRIVER_Update_pointers(const int sx, const int sy, const int sz, float *pc);
 
 void DRIVER_InsertSource(float dt, int it, int iSource, float *p, float*q, float src);
 
+#ifdef DIAG
+// time step at which the wave fields diverged, 0 if they did not (fused diagnostics)
+int DRIVER_Diverged();
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,4 +1,5 @@
 #define MI 0.2           // stability factor to compute dt
+#define DT_SAFETY 0.9    // fraction of the stability limit used by automatic dt
 #define ARGS 11          // tokens in executable command
 
 #define _DUMP       // execution summary dump
@@ -10,4 +11,17 @@
 #define SIGMA  0.75      // value of sigma on formula 7 of Fletcher's paper
 #define MAX_SIGMA 10.0   // above this value, SIGMA is considered infinite; as so, vsz=0
 
+// time integrator (make TIME_ORDER=4): 2nd order leapfrog is stable for dt^2*lambda <= 4,
+// 4th order modified equation (Lax-Wendroff) for dt^2*lambda <= 12, lambda the largest
+// eigenvalue of the spatial operator
 
+#ifndef TIME_ORDER
+#define TIME_ORDER 2
+#endif
+#if TIME_ORDER == 4
+#define TIME_STABILITY 3.4641016f  // sqrt(12)
+#elif TIME_ORDER == 2
+#define TIME_STABILITY 2.0f        // sqrt(4)
+#else
+#error "TIME_ORDER must be 2 or 4"
+#endif
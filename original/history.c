@@ -0,0 +1,282 @@
+#include <time.h>
+#include <unistd.h>
+#include "history.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef GIT_REV
+#define GIT_REV "unknown"
+#endif
+#ifndef BACKEND
+#define BACKEND "unknown"
+#endif
+
+#define HISTORY_LINE 512
+
+
+typedef struct {
+  char key[5*HISTORY_NAME];  // backend source form variant grid threads
+  int side;                  // 0 for revA, 1 for revB
+  double msamples;
+  double hwmKB;
+} ObsT;
+
+
+// Revision: git revision of the build, "unknown" outside a work tree
+
+
+static const char *Revision() {
+  return (GIT_REV[0] != '\0') ? GIT_REV : "unknown";
+}
+
+
+// HistoryHost: host name and a hash of cpu model, cpu count and memory size, so that
+//              a host keeps its fingerprint and a changed machine gets a new one
+
+
+const char *HistoryHost() {
+  static char host[2*HISTORY_NAME]="";
+  if (host[0] != '\0')
+    return host;
+
+  unsigned int hash=2166136261u;    // FNV-1a
+  char line[HISTORY_LINE];
+  const char *file[2]={"/proc/cpuinfo", "/proc/meminfo"};
+  const char *field[2]={"model name", "MemTotal"};
+  for (int k=0; k<2; k++) {
+    FILE *fp=fopen(file[k], "r");
+    if (fp == NULL)
+      continue;
+    while (fgets(line, HISTORY_LINE, fp) != NULL)
+      if (strncmp(line, field[k], strlen(field[k])) == 0) {
+	for (const char *c=line; *c != '\0'; c++)
+	  hash=(hash^(unsigned char)*c)*16777619u;
+	break;
+      }
+    fclose(fp);
+  }
+  const long cpus=sysconf(_SC_NPROCESSORS_ONLN);
+  for (int b=0; b<(int)sizeof(cpus); b++)
+    hash=(hash^((cpus>>(8*b))&0xff))*16777619u;
+
+  char name[HISTORY_NAME]="unknown";
+  gethostname(name, HISTORY_NAME-1);
+  name[HISTORY_NAME-1]='\0';
+  snprintf(host, sizeof(host), "%s-%08x", name, hash);
+  return host;
+}
+
+
+// HistoryThreads: threads of this run
+
+
+int HistoryThreads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  const char *env=getenv("OMP_NUM_THREADS");
+  return (env != NULL) ? atoi(env) : 1;
+#endif
+}
+
+
+// FileName: history file, NULL if disabled
+
+
+static const char *FileName() {
+  const char *env=getenv("FLETCHER_HISTORY");
+  if (env == NULL)
+    return HISTORY_FILE;
+  return (env[0] != '\0') ? env : NULL;
+}
+
+
+// HistoryAppend: append one observation of throughput msamples (MSamples/s) and memory
+//                hwmKB (negative if not measured) on threads (0 for those of this run)
+
+
+void HistoryAppend(const char *source, const char *form, const char *variant,
+		   int nx, int ny, int nz, int threads, double msamples, long hwmKB) {
+  const char *name=FileName();
+  if (name == NULL)
+    return;
+  FILE *fp=fopen(name, "a");
+  if (fp == NULL) {
+    printf("HistoryAppend: cannot append to %s\n", name);
+    return;
+  }
+  if (ftell(fp) == 0)
+    fprintf(fp, "# rev host date backend source form variant grid threads msamples_per_s hwm_kb\n");
+  if (threads <= 0)
+    threads=HistoryThreads();
+  char stamp[32];
+  const time_t now=time(NULL);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+  fprintf(fp, "%s %s %s %s %s %s %s %dx%dx%d %d %.4lf %ld\n",
+	  Revision(), HistoryHost(), stamp, BACKEND, source, form, variant,
+	  nx, ny, nz, threads, msamples, hwmKB);
+  fclose(fp);
+}
+
+
+// TQuantile: two sided 95% quantile of Student's t with df degrees of freedom;
+//            tabulated to 30, Cornish-Fisher expansion beyond
+
+
+static double TQuantile(double df) {
+  static const double table[30]={12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+				 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+				 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+				 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (df < 1.0)
+    df=1.0;
+  if (df < 31.0)
+    return table[(int)df-1];
+  const double z=1.959964, z2=z*z;
+  return z+z*(z2+1.0)/(4.0*df)+z*((5.0*z2+16.0)*z2+3.0)/(96.0*df*df);
+}
+
+
+// Stats: mean and variance of field (0 throughput, 1 memory) of the observations of key on side
+
+
+static int Stats(const ObsT *obs, int n, const char *key, int side, int field,
+		 double *mean, double *var) {
+  int count=0;
+  double sum=0.0, sum2=0.0;
+  for (int k=0; k<n; k++)
+    if (obs[k].side == side && strcmp(obs[k].key, key) == 0) {
+      const double v=(field == 0) ? obs[k].msamples : obs[k].hwmKB;
+      if (v < 0.0)
+	return 0;
+      sum+=v;
+      sum2+=v*v;
+      count++;
+    }
+  if (count == 0)
+    return 0;
+  *mean=sum/count;
+  *var=(count > 1) ? fmax(0.0, (sum2-sum*sum/count)/(count-1)) : 0.0;
+  return count;
+}
+
+
+// Change: relative change of the mean from revA to revB with its 95% Welch confidence
+//         interval; returns +1 if significantly higher, -1 if lower, 0 otherwise
+
+
+static int Change(int nA, double meanA, double varA, int nB, double meanB, double varB,
+		  double *change, double *lo, double *hi) {
+  const double diff=meanB-meanA;
+  const double seA=varA/nA, seB=varB/nB;
+  const double se=sqrt(seA+seB);
+  double half=0.0;
+  if (se > 0.0) {
+    // Welch-Satterthwaite degrees of freedom; a side of one observation has none
+    const double den=((nA > 1) ? seA*seA/(nA-1) : 0.0)+((nB > 1) ? seB*seB/(nB-1) : 0.0);
+    const double df=(den > 0.0) ? (seA+seB)*(seA+seB)/den : 1.0;
+    half=TQuantile(df)*se;
+  }
+  *change=diff/meanA;
+  *lo=(diff-half)/meanA;
+  *hi=(diff+half)/meanA;
+
+  // a single observation on both sides has no spread to test against
+
+  if (nA+nB < 3 || fabs(*change) < HISTORY_MIN_CHANGE)
+    return 0;
+  if (*lo > 0.0)
+    return 1;
+  if (*hi < 0.0)
+    return -1;
+  return 0;
+}
+
+
+// HistoryCompare: compare revision revB against revA on this host; returns the
+//                 number of significant regressions
+
+
+int HistoryCompare(const char *revA, const char *revB) {
+  const char *name=FileName();
+  FILE *fp=(name != NULL) ? fopen(name, "r") : NULL;
+  if (fp == NULL) {
+    printf("HistoryCompare: cannot read %s\n", (name != NULL) ? name : "history (disabled)");
+    return 0;
+  }
+
+  // observations of both revisions on this host
+
+  int n=0, room=256;
+  ObsT *obs=(ObsT *) malloc(room*sizeof(ObsT));
+  char line[HISTORY_LINE];
+  while (fgets(line, HISTORY_LINE, fp) != NULL) {
+    char rev[HISTORY_NAME], host[2*HISTORY_NAME], date[HISTORY_NAME], backend[HISTORY_NAME];
+    char source[HISTORY_NAME], form[HISTORY_NAME], variant[HISTORY_NAME], grid[HISTORY_NAME];
+    int threads;
+    double msamples, hwmKB;
+    if (line[0] == '#' ||
+	sscanf(line, "%63s %127s %63s %63s %63s %63s %63s %63s %d %lf %lf",
+	       rev, host, date, backend, source, form, variant, grid,
+	       &threads, &msamples, &hwmKB) != 11)
+      continue;
+    if (strcmp(host, HistoryHost()) != 0 || (strcmp(rev, revA) != 0 && strcmp(rev, revB) != 0))
+      continue;
+    if (n == room) {
+      room*=2;
+      obs=(ObsT *) realloc(obs, room*sizeof(ObsT));
+    }
+    snprintf(obs[n].key, sizeof(obs[n].key), "%s %s %s %s %s %d",
+	     backend, source, form, variant, grid, threads);
+    obs[n].side=(strcmp(rev, revA) == 0) ? 0 : 1;
+    obs[n].msamples=msamples;
+    obs[n].hwmKB=hwmKB;
+    n++;
+  }
+  fclose(fp);
+
+  printf("History of %s on host %s: %s against %s, 95%% confidence intervals\n",
+	 name, HistoryHost(), revB, revA);
+  printf("%-52s %4s %10s %4s %10s %9s %21s  %s\n",
+	 "backend source form variant grid threads", "nA", "MSamples/s", "nB", "MSamples/s",
+	 "change", "interval", "verdict");
+
+  // each key once, in order of first observation
+
+  int regressions=0, compared=0;
+  for (int k=0; k<n; k++) {
+    int seen=0;
+    for (int j=0; j<k && !seen; j++)
+      seen=(strcmp(obs[j].key, obs[k].key) == 0);
+    if (seen)
+      continue;
+    double meanA, varA, meanB, varB, change, lo, hi;
+    const int nA=Stats(obs, n, obs[k].key, 0, 0, &meanA, &varA);
+    const int nB=Stats(obs, n, obs[k].key, 1, 0, &meanB, &varB);
+    if (nA == 0 || nB == 0 || !(meanA > 0.0))
+      continue;
+    compared++;
+    const int speed=Change(nA, meanA, varA, nB, meanB, varB, &change, &lo, &hi);
+    printf("%-52s %4d %10.2lf %4d %10.2lf %+8.1lf%% [%+8.1lf%%, %+8.1lf%%]  %s\n",
+	   obs[k].key, nA, meanA, nB, meanB, 100.0*change, 100.0*lo, 100.0*hi,
+	   (speed < 0) ? "throughput regression" : (speed > 0) ? "throughput improvement" : "-");
+    regressions+=(speed < 0);
+
+    // memory, where measured
+
+    const int mA=Stats(obs, n, obs[k].key, 0, 1, &meanA, &varA);
+    const int mB=Stats(obs, n, obs[k].key, 1, 1, &meanB, &varB);
+    if (mA == 0 || mB == 0 || !(meanA > 0.0))
+      continue;
+    const int memory=Change(mA, meanA, varA, mB, meanB, varB, &change, &lo, &hi);
+    if (memory != 0 || fabs(change) >= HISTORY_MIN_CHANGE)
+      printf("%-52s %4d %8.0lfkB %4d %8.0lfkB %+8.1lf%% [%+8.1lf%%, %+8.1lf%%]  %s\n",
+	     "  memory high water mark", mA, meanA, mB, meanB, 100.0*change, 100.0*lo, 100.0*hi,
+	     (memory > 0) ? "memory regression" : (memory < 0) ? "memory improvement" : "-");
+    regressions+=(memory > 0);
+  }
+  free(obs);
+  printf("%d keys compared, %d significant regressions\n", compared, regressions);
+  return regressions;
+}
@@ -0,0 +1,52 @@
+#ifndef _HISTORY
+#define _HISTORY
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+
+// Results history: every run and every Benchmark.exe timing appends one observation
+// to History.dat (or $FLETCHER_HISTORY; empty disables it), keyed by the git revision
+// of the build, a fingerprint of the host, backend, source (run, bench, strong, weak),
+// formulation, kernel variant, grid and threads. The file is append only and plain
+// text, one observation per line. The HISTORY mode compares two revisions on this
+// host: per key, the change of mean throughput and memory high water mark with its
+// 95% Welch confidence interval, flagging significant regressions.
+
+
+#define HISTORY_FILE "History.dat"
+#define HISTORY_ARGS 4                // tokens in the comparison command
+#define HISTORY_NAME 64               // length of each field
+#define HISTORY_MIN_CHANGE 0.01       // smallest relative change flagged
+
+
+// HistoryAppend: append one observation of throughput msamples (MSamples/s) and memory
+//                hwmKB (negative if not measured) on threads (0 for those of this run)
+
+
+void HistoryAppend(const char *source, const char *form, const char *variant,
+		   int nx, int ny, int nz, int threads, double msamples, long hwmKB);
+
+
+// HistoryHost: host name and a hash of cpu model, cpu count and memory size, so that
+//              a host keeps its fingerprint and a changed machine gets a new one
+
+
+const char *HistoryHost();
+
+
+// HistoryThreads: threads of this run
+
+
+int HistoryThreads();
+
+
+// HistoryCompare: compare revision revB against revA on this host; returns the
+//                 number of significant regressions
+
+
+int HistoryCompare(const char *revA, const char *revB);
+
+#endif
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libfletcher.h"
+#include "coef.h"
+#include "driver.h"
+#include "map.h"
+#include "utils.h"
+#include "walltime.h"
+#include "trace.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef BACKEND
+#define BACKEND "unknown"
+#endif
+
+
+struct FletcherS {
+  int sx, sy, sz, bord;
+  float dx, dy, dz, dt;
+  int threads;
+  long points;               // grid points the wave fields have room for
+  int it;                    // time steps done
+  float *vpz, *vsv, *epsilon, *delta, *phi, *theta;  // medium, kept by the caller
+  CoefT coef;
+  float *pp, *pc, *qp, *qc;  // wave fields at previous and current time steps
+  double tPrecompute, tSetup;
+};
+
+
+// contexts alive; backends that keep state of their own allow one
+
+static int live=0;
+
+
+// Reentrant: the backend keeps no state of its own between calls
+
+
+static int Reentrant() {
+#if defined(HALF) || defined(JIT) || defined(DIAG) || TIME_ORDER == 4
+  return 0;
+#else
+  return strcmp(BACKEND, "OpenMP") == 0;
+#endif
+}
+
+
+// Team: make the calling thread run parallel regions on the team of the context;
+//       returns the team size it had before
+
+
+static int Team(const FletcherT *ctx) {
+#ifdef _OPENMP
+  const int before=omp_get_max_threads();
+  if (ctx->threads > 0)
+    omp_set_num_threads(ctx->threads);
+  return before;
+#else
+  return 0;
+#endif
+}
+
+static void TeamRestore(int before) {
+#ifdef _OPENMP
+  omp_set_num_threads(before);
+#endif
+}
+
+
+// Restart: null wave fields, zeroed by the team of the context, at time step 0, and
+//          the backend set up on them
+
+
+static void Restart(FletcherT *ctx) {
+  const long n=(long)ctx->sx*ctx->sy*ctx->sz;
+  float *pp=ctx->pp, *pc=ctx->pc, *qp=ctx->qp, *qc=ctx->qc;
+#pragma omp parallel for
+  for (long i=0; i<n; i++)
+    pp[i]=pc[i]=qp[i]=qc[i]=0.0f;
+  ctx->it=0;
+
+  const double t0=wtime();
+  DRIVER_Initialize(ctx->sx, ctx->sy, ctx->sz, ctx->bord,
+		    ctx->dx, ctx->dy, ctx->dz, ctx->dt,
+		    ctx->vpz, ctx->vsv, ctx->epsilon, ctx->delta, ctx->phi, ctx->theta, &ctx->coef,
+		    ctx->pp, ctx->pc, ctx->qp, ctx->qc);
+  ctx->tSetup=wtime()-t0;
+}
+
+
+// Room: wave fields with room for points grid points; their contents are lost if they grow
+
+
+static void Room(FletcherT *ctx, long points) {
+  if (points <= ctx->points)
+    return;
+  free(ctx->pp); free(ctx->pc); free(ctx->qp); free(ctx->qc);
+  ctx->pp=(float *) malloc(points*sizeof(float));
+  ctx->pc=(float *) malloc(points*sizeof(float));
+  ctx->qp=(float *) malloc(points*sizeof(float));
+  ctx->qc=(float *) malloc(points*sizeof(float));
+  ctx->points=points;
+}
+
+
+// FletcherInit: context of a grid of medium (vpz, vsv, epsilon, delta, phi, theta) at
+//               every point, with the z coordinate of each plane in zPlane, and null
+//               wave fields; NULL if no more contexts can be created. The medium
+//               arrays must outlive the context
+
+
+FletcherT *FletcherInit(const FletcherGridT *grid,
+			float *vpz, float *vsv, float *epsilon, float *delta,
+			float *phi, float *theta, const float *zPlane) {
+
+  if (__atomic_fetch_add(&live, 1, __ATOMIC_ACQ_REL) > 0 && !Reentrant()) {
+    __atomic_fetch_sub(&live, 1, __ATOMIC_ACQ_REL);
+    printf("FletcherInit: backend %s runs one context at a time\n", BACKEND);
+    return NULL;
+  }
+
+  FletcherT *ctx=(FletcherT *) calloc(1, sizeof(FletcherT));
+  ctx->sx=grid->sx; ctx->sy=grid->sy; ctx->sz=grid->sz; ctx->bord=grid->bord;
+  ctx->dx=grid->dx; ctx->dy=grid->dy; ctx->dz=grid->dz; ctx->dt=grid->dt;
+  ctx->threads=grid->threads;
+  ctx->vpz=vpz; ctx->vsv=vsv; ctx->epsilon=epsilon; ctx->delta=delta;
+  ctx->phi=phi; ctx->theta=theta;
+  const int before=Team(ctx);
+
+  const long n=(long)ctx->sx*ctx->sy*ctx->sz;
+  const long points=(grid->reserve > n) ? grid->reserve : n;
+
+  const double t0=wtime();
+  memset(&ctx->coef, 0, sizeof(CoefT));
+  CoefReserve(&ctx->coef, points, ctx->sz);
+  CoefUpdate(&ctx->coef, COEF_ALL, ctx->sx, ctx->sy, ctx->sz, ctx->bord,
+	     vpz, vsv, epsilon, delta, phi, theta, zPlane);
+  ctx->tPrecompute=wtime()-t0;
+
+  Room(ctx, points);
+  Restart(ctx);
+
+  TeamRestore(before);
+  return ctx;
+}
+
+
+// FletcherReset: null wave fields at time step 0, keeping the coefficients; the backend
+//               is set up again, which FletcherTimes reports as the setup time
+
+
+void FletcherReset(FletcherT *ctx) {
+  const int before=Team(ctx);
+  DRIVER_Finalize();
+  ctx->tPrecompute=0.0;
+  Restart(ctx);
+  TeamRestore(before);
+}
+
+
+// FletcherReuse: the context on grid, with null wave fields at time step 0; the medium
+//                changed in the parts (COEF_* of coef.h) of the coefficients recomputed,
+//                all of them if the grid changed. Grows the room of the context if needed
+
+
+void FletcherReuse(FletcherT *ctx, const FletcherGridT *grid, int parts,
+		   float *vpz, float *vsv, float *epsilon, float *delta,
+		   float *phi, float *theta, const float *zPlane) {
+  DRIVER_Finalize();
+  if (grid->sx != ctx->sx || grid->sy != ctx->sy || grid->sz != ctx->sz || grid->bord != ctx->bord)
+    parts=COEF_ALL;
+  ctx->sx=grid->sx; ctx->sy=grid->sy; ctx->sz=grid->sz; ctx->bord=grid->bord;
+  ctx->dx=grid->dx; ctx->dy=grid->dy; ctx->dz=grid->dz; ctx->dt=grid->dt;
+  ctx->threads=grid->threads;
+  ctx->vpz=vpz; ctx->vsv=vsv; ctx->epsilon=epsilon; ctx->delta=delta;
+  ctx->phi=phi; ctx->theta=theta;
+
+  const int before=Team(ctx);
+  const long n=(long)ctx->sx*ctx->sy*ctx->sz;
+  const long points=(grid->reserve > n) ? grid->reserve : n;
+  const double t0=wtime();
+  CoefReserve(&ctx->coef, points, ctx->sz);
+  CoefUpdate(&ctx->coef, parts, ctx->sx, ctx->sy, ctx->sz, ctx->bord,
+	     vpz, vsv, epsilon, delta, phi, theta, zPlane);
+  ctx->tPrecompute=wtime()-t0;
+
+  Room(ctx, points);
+  Restart(ctx);
+  TeamRestore(before);
+}
+
+
+// FletcherIndex: index of grid point (ix,iy,iz) in the wave fields of the context
+
+
+int FletcherIndex(const FletcherT *ctx, int ix, int iy, int iz) {
+  const int sx=ctx->sx, sy=ctx->sy;
+  return ind(ix,iy,iz);
+}
+
+
+// FletcherInject: add src to the current p and q fields at index, before the next step
+
+
+void FletcherInject(FletcherT *ctx, int index, float src) {
+  DRIVER_InsertSource(ctx->dt, ctx->it, index, ctx->pc, ctx->qc, src);
+}
+
+
+// FletcherStep: advance the wave fields n time steps; returns n, or with DIAG the steps
+//               done before the one at which the wave fields diverged, and 0 at later calls
+
+
+int FletcherStep(FletcherT *ctx, int n) {
+  const int before=Team(ctx);
+  int k;
+  for (k=0; k<n; k++) {
+#ifdef DIAG
+    if (DRIVER_Diverged())
+      break;
+#endif
+    ctx->it++;
+    TRACE_BEGIN(tPropagate);
+    DRIVER_Propagate(ctx->sx, ctx->sy, ctx->sz, ctx->bord,
+		     ctx->dx, ctx->dy, ctx->dz, ctx->dt, ctx->it,
+		     &ctx->coef, ctx->pp, ctx->pc, ctx->qp, ctx->qc);
+    TRACE_END(tPropagate, TRACE_PROPAGATE, ctx->it);
+
+    TRACE_BEGIN(tSwap);
+    SwapArrays(&ctx->pp, &ctx->pc, &ctx->qp, &ctx->qc);
+    TRACE_END(tSwap, TRACE_SWAP, -1);
+#ifdef DIAG
+    if (DRIVER_Diverged())
+      break;
+#endif
+  }
+  TeamRestore(before);
+  return k;
+}
+
+
+// FletcherIteration: time steps done
+
+
+int FletcherIteration(const FletcherT *ctx) {
+  return ctx->it;
+}
+
+
+// FletcherSnapshot: current p field over the whole grid, valid until the next step
+
+
+const float *FletcherSnapshot(FletcherT *ctx) {
+  const int before=Team(ctx);
+  DRIVER_Update_pointers(ctx->sx, ctx->sy, ctx->sz, ctx->pc);
+  TeamRestore(before);
+  return ctx->pc;
+}
+
+
+// FletcherSample: current p field at n indices
+
+
+void FletcherSample(FletcherT *ctx, int n, const int *index, float *value) {
+  const float *p=FletcherSnapshot(ctx);
+  for (int k=0; k<n; k++)
+    value[k]=p[index[k]];
+}
+
+
+// FletcherFields: current p and q fields over the whole grid, valid until the next step;
+//                 q is NULL for the device backends (CUDA, OpenACC), that keep it on the device,
+//                 and under HALF, that decodes only p from its reduced precision storage
+
+
+void FletcherFields(FletcherT *ctx, const float **p, const float **q) {
+  *p=FletcherSnapshot(ctx);
+#ifdef HALF
+  *q=NULL;
+#else
+  *q=(strcmp(BACKEND, "CUDA") == 0 || strcmp(BACKEND, "OpenACC") == 0) ? NULL : ctx->qc;
+#endif
+}
+
+
+// FletcherTimes: seconds spent by the last FletcherInit, FletcherReset or FletcherReuse
+//                precomputing coefficients and setting up the backend
+
+
+void FletcherTimes(const FletcherT *ctx, double *precompute, double *setup) {
+  *precompute=ctx->tPrecompute;
+  *setup=ctx->tSetup;
+}
+
+
+// FletcherFree: release the context
+
+
+void FletcherFree(FletcherT *ctx) {
+  const int before=Team(ctx);
+  DRIVER_Finalize();
+  TeamRestore(before);
+  CoefFree(&ctx->coef);
+  free(ctx->pp);
+  free(ctx->pc);
+  free(ctx->qp);
+  free(ctx->qc);
+  free(ctx);
+  __atomic_fetch_sub(&live, 1, __ATOMIC_ACQ_REL);
+}
@@ -0,0 +1,120 @@
+#ifndef _LIBFLETCHER
+#define _LIBFLETCHER
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+// libfletcher: the propagator behind an opaque context. A context owns its grid, the
+// coefficients precomputed from the medium and the four wave fields; ModelagemFletcher.exe
+// runs one through Model. With the OpenMP backend contexts are independent: each one
+// steps on a team of its own size, so contexts driven by distinct host threads run
+// concurrently on disjoint teams. Backends and kernels that keep state of their own
+// (Pthreads, WorkStealing, CUDA, OpenACC; HALF, JIT, DIAG, TIME_ORDER=4) allow one
+// context at a time. Grid points are addressed by FletcherIndex.
+
+
+typedef struct FletcherS FletcherT;
+
+
+typedef struct {
+  int sx, sy, sz;            // grid dimensions (grid points + 2*border + 2*absortion)
+  int bord;                  // border size to apply the stencil at grid extremes
+  float dx, dy, dz;          // grid steps
+  float dt;                  // time advance at each time step
+  int threads;               // threads of the team of the context; 0 for the default
+  long reserve;              // grid points to make room for, if more than sx*sy*sz, so
+                             // that FletcherReuse on grids up to that size does not allocate
+} FletcherGridT;
+
+
+// FletcherInit: context of a grid of medium (vpz, vsv, epsilon, delta, phi, theta) at
+//               every point, with the z coordinate of each plane in zPlane, and null
+//               wave fields; NULL if no more contexts can be created. The medium
+//               arrays must outlive the context
+
+
+FletcherT *FletcherInit(const FletcherGridT *grid,
+			float *vpz, float *vsv, float *epsilon, float *delta,
+			float *phi, float *theta, const float *zPlane);
+
+
+// FletcherReset: null wave fields at time step 0, keeping the coefficients; the backend
+//               is set up again, which FletcherTimes reports as the setup time
+
+
+void FletcherReset(FletcherT *ctx);
+
+
+// FletcherReuse: the context on grid, with null wave fields at time step 0; the medium
+//                changed in the parts (COEF_* of coef.h) of the coefficients recomputed,
+//                all of them if the grid changed. Grows the room of the context if needed
+
+
+void FletcherReuse(FletcherT *ctx, const FletcherGridT *grid, int parts,
+		   float *vpz, float *vsv, float *epsilon, float *delta,
+		   float *phi, float *theta, const float *zPlane);
+
+
+// FletcherIndex: index of grid point (ix,iy,iz) in the wave fields of the context
+
+
+int FletcherIndex(const FletcherT *ctx, int ix, int iy, int iz);
+
+
+// FletcherInject: add src to the current p and q fields at index, before the next step
+
+
+void FletcherInject(FletcherT *ctx, int index, float src);
+
+
+// FletcherStep: advance the wave fields n time steps; returns n, or with DIAG the steps
+//               done before the one at which the wave fields diverged, and 0 at later calls
+
+
+int FletcherStep(FletcherT *ctx, int n);
+
+
+// FletcherIteration: time steps done
+
+
+int FletcherIteration(const FletcherT *ctx);
+
+
+// FletcherSample: current p field at n indices
+
+
+void FletcherSample(FletcherT *ctx, int n, const int *index, float *value);
+
+
+// FletcherSnapshot: current p field over the whole grid, valid until the next step
+
+
+const float *FletcherSnapshot(FletcherT *ctx);
+
+
+// FletcherFields: current p and q fields over the whole grid, valid until the next step;
+//                 q is NULL for the device backends (CUDA, OpenACC), that keep it on the device,
+//                 and under HALF, that decodes only p from its reduced precision storage
+
+
+void FletcherFields(FletcherT *ctx, const float **p, const float **q);
+
+
+// FletcherTimes: seconds spent by the last FletcherInit, FletcherReset or FletcherReuse
+//                precomputing coefficients and setting up the backend
+
+
+void FletcherTimes(const FletcherT *ctx, double *precompute, double *setup);
+
+
+// FletcherFree: release the context
+
+
+void FletcherFree(FletcherT *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -9,8 +9,16 @@
 #include "driver.h"
 #include "fletcher.h"
 #include "model.h"
-
-enum Form {ISO, VTI, TTI};
+#include "medium.h"
+#include "plan.h"
+#include "zgrid.h"
+#include "metrics.h"
+#include "walltime.h"
+#include "trace.h"
+#include "roofline.h"
+#include "history.h"
+#include "server.h"
+#include "sweep.h"
 
 int main(int argc, char** argv) {
 
@@ -18,7 +26,7 @@ int main(int argc, char** argv) {
   int nx;                // grid points in x
   int ny;                // grid points in y
   int nz;                // grid points in z
-  int bord=4;            // border size to apply the stencil at grid extremes
+  int bord=STENCIL_RADIUS; // border size to apply the stencil at grid extremes
   int absorb;            // absortion zone size
   int sx;                // grid dimension in x (grid points + 2*border + 2*absortion)
   int sy;                // grid dimension in y (grid points + 2*border + 2*absortion)
@@ -41,36 +49,109 @@ int main(int argc, char** argv) {
   const float dtOutput=0.01;
 
   it = 0; //PPL
+
+  // roofline mode: ROOFLINE measures the roof of the host and reports it for each
+  // kernel variant; with $FLETCHER_ROOFLINE set it is measured before the run and
+  // reported with it
+
+  // history mode: HISTORY revA revB compares the recorded results of two revisions
+  // on this host; the exit status is the number of significant regressions
+
+  if (argc>1 && strcmp(argv[1],"HISTORY")==0) {
+    if (argc<HISTORY_ARGS) {
+      printf("history comparison requires %d input arguments; execution halted\n",HISTORY_ARGS-2);
+      exit(-1);
+    }
+    exit(HistoryCompare(argv[2], argv[3]) > 0);
+  }
+
+  // server mode: SERVE socket <arguments of a run, or PLAN ... RUN> keeps the model
+  // resident and runs the propagation jobs submitted to the socket by client.exe
+
+  const char *serveSocket=NULL;
+  if (argc>2 && strcmp(argv[1],"SERVE")==0) {
+    serveSocket=argv[2];
+    argc-=2;
+    argv+=2;
+  }
+
+  RoofT roof;
+  const int roofMode=(argc>1 && strcmp(argv[1],"ROOFLINE")==0);
+  const int roofline=roofMode || getenv("FLETCHER_ROOFLINE")!=NULL;
+  if (roofline)
+    RooflineMeasure(&roof);
+  if (roofMode) {
+    RooflineReport(&roof);
+    exit(0);
+  }
+
+  const double tSetup=wtime();
+  TraceInitialize();
+
+  // sweep mode: SWEEP file runs every run described in file in this process, reusing
+  // the allocations of the medium, coefficients and wave fields from run to run
+
+  if (argc>1 && strcmp(argv[1],"SWEEP")==0) {
+    if (argc<SWEEP_ARGS) {
+      printf("sweep requires %d input arguments; execution halted\n",SWEEP_ARGS-2);
+      exit(-1);
+    }
+    exit(SweepRun(argv[2]) > 0);
+  }
     
   // input problem definition
   
-  if (argc<ARGS) {
-    printf("program requires %d input arguments; execution halted\n",ARGS-1);
-    exit(-1);
-  } 
-  strcpy(fNameSec,argv[1]);
-  nx=atoi(argv[2]);
-  ny=atoi(argv[3]);
-  nz=atoi(argv[4]);
-  absorb=atoi(argv[5]);
-  dx=atof(argv[6]);
-  dy=atof(argv[7]);
-  dz=atof(argv[8]);
-  dt=atof(argv[9]);
-  tmax=atof(argv[10]);
+  // planning mode: PLAN form lx ly lz absorb ppw tmax [RUN]
+  // derives grid and time step from the physical extent, prints the plan
+  // and runs it only if RUN is given
+
+  PlanT plan;
+  int planned=0;
+  if (argc>1 && strcmp(argv[1],"PLAN")==0) {
+    if (argc<PLAN_ARGS) {
+      printf("planning requires %d input arguments; execution halted\n",PLAN_ARGS-2);
+      exit(-1);
+    }
+    strcpy(fNameSec,argv[2]);
+    if (!MediumForm(fNameSec, &prob)) {
+      printf("Input problem formulation (%s) is unknown\n", fNameSec);
+      exit(-1);
+    }
+    absorb=atoi(argv[6]);
+    tmax=atof(argv[8]);
+    Plan(prob, fNameSec,
+	 atof(argv[3]), atof(argv[4]), atof(argv[5]),
+	 absorb, bord, atof(argv[7]), tmax, dtOutput, &plan);
+    if (argc==PLAN_ARGS || strcmp(argv[PLAN_ARGS],"RUN")!=0)
+      exit(0);
+    nx=plan.nx;
+    ny=plan.ny;
+    nz=plan.nz;
+    dx=plan.dx;
+    dy=plan.dy;
+    dz=plan.dz;
+    dt=plan.dt;
+    planned=1;
+  } else {
+    if (argc<ARGS) {
+      printf("program requires %d input arguments; execution halted\n",ARGS-1);
+      exit(-1);
+    } 
+    strcpy(fNameSec,argv[1]);
+    nx=atoi(argv[2]);
+    ny=atoi(argv[3]);
+    nz=atoi(argv[4]);
+    absorb=atoi(argv[5]);
+    dx=atof(argv[6]);
+    dy=atof(argv[7]);
+    dz=atof(argv[8]);
+    dt=atof(argv[9]);
+    tmax=atof(argv[10]);
+  }
 
   // verify problem formulation
 
-  if (strcmp(fNameSec,"ISO")==0) {
-    prob=ISO;
-  }
-  else if (strcmp(fNameSec,"VTI")==0) {
-    prob=VTI;
-  }
-  else if (strcmp(fNameSec,"TTI")==0) {
-    prob=TTI;
-  }
-  else {
+  if (!MediumForm(fNameSec, &prob)) {
     printf("Input problem formulation (%s) is unknown\n", fNameSec);
     exit(-1);
   }
@@ -87,6 +168,12 @@ int main(int argc, char** argv) {
   case TTI:
     printf("anisotropic with tilted transversely isotropy using sigma=%f\n", SIGMA);
     break;
+  case MIX:
+    printf("isotropic, VTI and TTI layers (top to bottom) using sigma=%f\n", SIGMA);
+    break;
+  case GRAD:
+    printf("isotropic with velocity growing linearly with depth, %.1f m/s per m\n", GRAD_K);
+    break;
   }
 #endif
 
@@ -96,9 +183,19 @@ int main(int argc, char** argv) {
   sy=ny+2*bord+2*absorb;
   sz=nz+2*bord+2*absorb;
 
-  // number of time iterations
+#ifdef BRICK
+  if (sx%BRICK_X!=0 || sy%BRICK_Y!=0 || sz%BRICK_Z!=0) {
+    printf("Grid (%d,%d,%d) must be a multiple of the brick (%d,%d,%d); execution halted\n",
+	   sx, sy, sz, BRICK_X, BRICK_Y, BRICK_Z);
+    exit(-1);
+  }
+#endif
 
-  st=ceil(tmax/dt);
+  // z coordinate of each plane, relative to the source plane
+
+  float *zPlane=NULL;
+  zPlane = (float *) malloc(sz*sizeof(float));
+  ZGridPlanes(prob, sz, bord+absorb, dz, zPlane);
 
   // source position
 
@@ -116,7 +213,20 @@ int main(int argc, char** argv) {
   printf("Wave is propagated at internal+absortion points of size (%d,%d,%d)\n",
 	 nx+2*absorb, ny+2*absorb, nz+2*absorb);
   printf("Source at coordinates (%d,%d,%d)\n", ixSource,iySource,izSource);
-  printf("Will run %d time steps of %f to reach time %f\n", st, dt, st*dt);
+#ifdef NONUNIFORM_Z
+  {
+    const int izFirst=bord+absorb;
+    const int izLast=bord+absorb+nz-1;
+    const float depth=zPlane[izLast]-zPlane[izFirst];
+    printf("Stretched z axis: %d planes span %.2f m with spacing from %.2f to %.2f; "
+	   "uniform spacing %.2f needs %d planes\n",
+	   nz, depth, ZGridSpacing(zPlane, sz, izFirst), ZGridSpacing(zPlane, sz, izLast),
+	   ZGridSpacing(zPlane, sz, izFirst), (int)ceilf(depth/ZGridSpacing(zPlane, sz, izFirst))+1);
+  }
+#endif
+#ifdef BRICK
+  printf("Arrays stored in bricks of (%d,%d,%d) points\n", BRICK_X, BRICK_Y, BRICK_Z);
+#endif
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -165,60 +275,7 @@ int main(int argc, char** argv) {
 
   // input anisotropy arrays for selected problem formulation
 
-  switch(prob) {
-
-  case ISO:
-
-    for (i=0; i<sx*sy*sz; i++) {
-      vpz[i]=3000.0;
-      epsilon[i]=0.0;
-      delta[i]=0.0;
-      phi[i]=0.0;
-      theta[i]=0.0;
-      vsv[i]=0.0;
-    }
-    break;
-
-  case VTI:
-
-    if (SIGMA > MAX_SIGMA) {
-      printf("Since sigma (%f) is greater that threshold (%f), sigma is considered infinity and vsv is set to zero\n", 
-		      SIGMA, MAX_SIGMA);
-    }
-    for (i=0; i<sx*sy*sz; i++) {
-      vpz[i]=3000.0;
-      epsilon[i]=0.24;
-      delta[i]=0.1;
-      phi[i]=0.0;
-      theta[i]=0.0;
-      if (SIGMA > MAX_SIGMA) {
-	vsv[i]=0.0;
-      } else {
-	vsv[i]=vpz[i]*sqrtf(fabsf(epsilon[i]-delta[i])/SIGMA);
-      }
-    }
-    break;
-
-  case TTI:
-
-    if (SIGMA > MAX_SIGMA) {
-      printf("Since sigma (%f) is greater that threshold (%f), sigma is considered infinity and vsv is set to zero\n", 
-		      SIGMA, MAX_SIGMA);
-    }
-    for (i=0; i<sx*sy*sz; i++) {
-      vpz[i]=3000.0;
-      epsilon[i]=0.24;
-      delta[i]=0.1;
-      //      phi[i]=0.0;
-      phi[i]=1.0; // evitando coeficientes nulos
-      theta[i]=atanf(1.0);
-      if (SIGMA > MAX_SIGMA) {
-	vsv[i]=0.0;
-      } else {
-	vsv[i]=vpz[i]*sqrtf(fabsf(epsilon[i]-delta[i])/SIGMA);
-      }
-    }
-  } // end switch
+  Medium(prob, sx, sy, sz, zPlane, SIGMA, vpz, vsv, epsilon, delta, phi, theta);
 
   // stability condition
   
@@ -232,10 +289,37 @@ int main(int argc, char** argv) {
     mindelta=dy;
   if (dz<mindelta)
     mindelta=dz;
+#ifdef NONUNIFORM_Z
+  for (int iz=0; iz<sz; iz++)
+    mindelta=fminf(mindelta, ZGridSpacing(zPlane, sz, iz));
+#endif
   float recdt;
   recdt=(MI*mindelta)/maxvel;
+
+  // stability limit of the time integrator
+
+  const float stabdt=MediumStability(sx, sy, sz, dx, dy, dz, zPlane, vpz, epsilon);
+
+  // automatic time step (input dt<=0): DT_SAFETY of the stability limit, shortened
+  // so that a whole number of steps spans dtOutput and outputs keep their times
+
+  if (dt <= 0.0f) {
+    const int stepsPerOutput=(int)ceilf(dtOutput/(DT_SAFETY*stabdt));
+    dt=dtOutput/stepsPerOutput;
+    printf("Automatic time step is %f, %d steps per output\n", dt, stepsPerOutput);
+  }
 #ifdef _DUMP
   printf("Recomended maximum time step is %f; used time step is %f\n", recdt, dt);
+  printf("Stability limit of the order %d time integrator is %f\n", TIME_ORDER, stabdt);
+#endif
+  if (dt > stabdt)
+    printf("**(main)**: time step %f exceeds the stability limit %f\n", dt, stabdt);
+
+  // number of time iterations
+
+  st=ceil(tmax/dt);
+#ifdef _DUMP
+  printf("Will run %d time steps of %f to reach time %f\n", st, dt, st*dt);
 #endif
 
   // random boundary speed
@@ -244,21 +328,6 @@ int main(int argc, char** argv) {
 			 nx, ny, nz,
 			 bord, absorb,
 			 vpz, vsv);
-  // pressure fields at previous, current and future time steps
-  
-  float *pp=NULL;
-  pp = (float *) malloc(sx*sy*sz*sizeof(float)); 
-  float *pc=NULL;
-  pc = (float *) malloc(sx*sy*sz*sizeof(float)); 
-  float *qp=NULL;
-  qp = (float *) malloc(sx*sy*sz*sizeof(float)); 
-  float *qc=NULL;
-  qc = (float *) malloc(sx*sy*sz*sizeof(float)); 
-  for (i=0; i<sx*sy*sz; i++) {
-    pp[i]=0.0f; pc[i]=0.0f; 
-    qp[i]=0.0f; qc[i]=0.0f;
-  }
-
   // slices
 
 //PPL  char fName[10];
@@ -269,31 +338,61 @@ int main(int argc, char** argv) {
   int izStart=0;
   int izEnd=sz-1;
 
+#ifdef NONUNIFORM_Z
+  // outputs are interpolated to a uniform z axis as fine as the finest plane spacing
+  float dzOut;
+  int kFirst;
+  izEnd=ZGridOutput(zPlane, sz, &dzOut, &kFirst)-1;
+#else
+  const float dzOut=dz;
+#endif
+
+  if (serveSocket != NULL) {
+    const ServerModelT model={sx, sy, sz, bord, dx, dy, dz, dt, tmax, dtOutput, izEnd, dzOut,
+			      vpz, vsv, epsilon, delta, phi, theta, zPlane};
+    exit(ServerRun(serveSocket, &model) > 0);
+  }
+
   SlicePtr sPtr;
   sPtr=OpenSliceFile(ixStart, ixEnd,
 		     iyStart, iyEnd,
 		     izStart, izEnd,
-		     dx, dy, dz, dt,
+		     dx, dy, dzOut, dt,
 		     fNameSec);
 
-  DumpSliceFile(sx,sy,sz,pc,sPtr);
+#ifdef NONUNIFORM_Z
+  printf("Output on a uniform z axis of %d planes of %f from %f relative to the source\n",
+	 izEnd+1, dzOut, kFirst*dzOut);
+#endif
 #ifdef _DUMP
   DumpSlicePtr(sPtr);
-  //  DumpSliceSummary(sx,sy,sz,sPtr,dt,it,pc,0);
 #endif
   
-  // Model do:
+  // setup is everything before Model; the wave fields are set up in Model
+
+  MetricsPhase(PHASE_SETUP, wtime()-tSetup);
+
+  // Model do, through a libfletcher context:
   // - Initialize
+  // - first (null) output
   // - time loop
   // - calls Propagate
   // - calls TimeForward
   // - calls InsertSource
   // - do AbsorbingBoundary and DumpSliceFile, if needed
   // - Finalize
-  Model(st,     iSource, dtOutput, sPtr,
-        sx,     sy,      sz,       bord,
-        dx,     dy,      dz,       dt,   it, 
-        pp,     pc,      qp,       qc,
-	vpz,    vsv,     epsilon,  delta,
-	phi,    theta, absorb);
+  if (!Model(st,     iSource, dtOutput, sPtr,    fNameSec,
+	     sx,     sy,      sz,       bord,
+	     dx,     dy,      dz,       dt,   it, 
+	     vpz,    vsv,     epsilon,  delta,
+	     phi,    theta, absorb,
+	     zPlane, NULL)) {
+    printf("Run stopped before its final time; execution halted\n");
+    exit(-1);
+  }
+
+  if (planned)
+    PlanReport(&plan);
+  if (roofline)
+    RooflineReport(&roof);
 }
@@ -6,8 +6,20 @@
 
 void coord(int i, int sx, int sy, int sz, int *ix, int *iy, int *iz) {
   int rem;
+#ifndef BRICK
   *ix=i%sx;
   rem=(i-*ix)/sx;
   *iy=rem%sy;
   *iz=(rem-*iy)/sy;
+#else
+  const int ib=i/BRICK_VOL;   // brick index
+  const int il=i%BRICK_VOL;   // index inside the brick
+  int bx, by;
+  bx=ib%(sx/BRICK_X);
+  rem=(ib-bx)/(sx/BRICK_X);
+  by=rem%(sy/BRICK_Y);
+  *iz=((rem-by)/(sy/BRICK_Y))*BRICK_Z+il/(BRICK_X*BRICK_Y);
+  *iy=by*BRICK_Y+(il/BRICK_X)%BRICK_Y;
+  *ix=bx*BRICK_X+il%BRICK_X;
+#endif
 }
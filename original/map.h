@@ -5,14 +5,64 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include "derivatives.h"
 
 
 // mapping 3D array [sz][sy][sx] into 1D [sx*sy*sz] in row-major ordering
 // use implicitly requires definition of the variables sx and sy at the place of call
 
 
+#ifndef BRICK
+
 #define ind(ix,iy,iz) (((iz)*sy+(iy))*sx+(ix))
 
+#else
+
+// bricked layout: the grid is split into BRICK_X*BRICK_Y*BRICK_Z bricks stored 
+// contiguously, bricks in row-major order and points inside a brick in row-major order;
+// sx, sy and sz must be multiples of the brick dimensions
+
+
+#ifndef BRICK_X
+#define BRICK_X 8
+#endif
+#ifndef BRICK_Y
+#define BRICK_Y 8
+#endif
+#ifndef BRICK_Z
+#define BRICK_Z 8
+#endif
+#define BRICK_VOL (BRICK_X*BRICK_Y*BRICK_Z)
+
+#define ind(ix,iy,iz) (((((iz)/BRICK_Z)*(sy/BRICK_Y)+(iy)/BRICK_Y)*(sx/BRICK_X)+(ix)/BRICK_X)*BRICK_VOL+ \
+		       ((((iz)%BRICK_Z)*BRICK_Y+(iy)%BRICK_Y)*BRICK_X+(ix)%BRICK_X))
+
+
+#endif
+
+
+// tiled kernels gather one block of BLOCK_X*BLOCK_Y*BLOCK_Z points plus a stencil halo 
+// into a row-major tile; with bricked layout a block is a brick
+
+
+#ifdef BRICK
+#define BLOCK_X BRICK_X
+#define BLOCK_Y BRICK_Y
+#define BLOCK_Z BRICK_Z
+#else
+#define BLOCK_X 32
+#define BLOCK_Y 8
+#define BLOCK_Z 8
+#endif
+
+#define TILE_HALO STENCIL_RADIUS
+#define TILE_X (BLOCK_X+2*TILE_HALO)
+#define TILE_Y (BLOCK_Y+2*TILE_HALO)
+#define TILE_Z (BLOCK_Z+2*TILE_HALO)
+#define TILE_VOL (TILE_X*TILE_Y*TILE_Z)
+
+#define tind(tx,ty,tz) (((tz)*TILE_Y+(ty))*TILE_X+(tx))
+
 
 // coord: given i, the map index, return ix, iy, iz
 
@@ -0,0 +1,231 @@
+#include "medium.h"
+#include "zgrid.h"
+
+
+// MediumForm: problem formulation named name; returns 0 if the name is unknown
+
+
+int MediumForm(const char *name, enum Form *prob) {
+  if (strcmp(name,"ISO")==0) {
+    *prob=ISO;
+  }
+  else if (strcmp(name,"VTI")==0) {
+    *prob=VTI;
+  }
+  else if (strcmp(name,"TTI")==0) {
+    *prob=TTI;
+  }
+  else if (strcmp(name,"MIX")==0) {
+    *prob=MIX;
+  }
+  else if (strcmp(name,"GRAD")==0) {
+    *prob=GRAD;
+  }
+  else {
+    return 0;
+  }
+  return 1;
+}
+
+
+// GradVelocity: qP velocity of GRAD at coordinate z relative to the source plane
+
+
+static float GradVelocity(float z) {
+  return fmaxf(GRAD_VMIN, GRAD_V0+GRAD_K*z);
+}
+
+
+// Medium: fill the anisotropy arrays of the selected problem formulation with sigma
+//         (SIGMA by default); zPlane holds the z coordinate of each plane relative to
+//         the source plane
+
+
+void Medium(enum Form prob, int sx, int sy, int sz, const float *zPlane, double sigma,
+	    float *vpz, float *vsv, float *epsilon, float *delta,
+	    float *phi, float *theta) {
+
+  int i;
+
+  switch(prob) {
+
+  case ISO:
+
+    for (i=0; i<sx*sy*sz; i++) {
+      vpz[i]=3000.0;
+      epsilon[i]=0.0;
+      delta[i]=0.0;
+      phi[i]=0.0;
+      theta[i]=0.0;
+      vsv[i]=0.0;
+    }
+    break;
+
+  case VTI:
+
+    if (sigma > MAX_SIGMA) {
+      printf("Since sigma (%f) is greater that threshold (%f), sigma is considered infinity and vsv is set to zero\n", 
+		      sigma, MAX_SIGMA);
+    }
+    for (i=0; i<sx*sy*sz; i++) {
+      vpz[i]=3000.0;
+      epsilon[i]=0.24;
+      delta[i]=0.1;
+      phi[i]=0.0;
+      theta[i]=0.0;
+      if (sigma > MAX_SIGMA) {
+	vsv[i]=0.0;
+      } else {
+	vsv[i]=vpz[i]*sqrtf(fabsf(epsilon[i]-delta[i])/sigma);
+      }
+    }
+    break;
+
+  case TTI:
+
+    if (sigma > MAX_SIGMA) {
+      printf("Since sigma (%f) is greater that threshold (%f), sigma is considered infinity and vsv is set to zero\n", 
+		      sigma, MAX_SIGMA);
+    }
+    for (i=0; i<sx*sy*sz; i++) {
+      vpz[i]=3000.0;
+      epsilon[i]=0.24;
+      delta[i]=0.1;
+      //      phi[i]=0.0;
+      phi[i]=1.0; // evitando coeficientes nulos
+      theta[i]=atanf(1.0);
+      if (sigma > MAX_SIGMA) {
+	vsv[i]=0.0;
+      } else {
+	vsv[i]=vpz[i]*sqrtf(fabsf(epsilon[i]-delta[i])/sigma);
+      }
+    }
+    break;
+
+  case MIX:
+
+    // isotropic upper third, VTI middle third and TTI lower third
+
+    if (sigma > MAX_SIGMA) {
+      printf("Since sigma (%f) is greater that threshold (%f), sigma is considered infinity and vsv is set to zero\n", 
+		      sigma, MAX_SIGMA);
+    }
+    for (i=0; i<sx*sy*sz; i++) {
+      int ix, iy, iz;
+      coord(i, sx, sy, sz, &ix, &iy, &iz);
+      vpz[i]=3000.0;
+      if (iz < sz/3) {
+	epsilon[i]=0.0;
+	delta[i]=0.0;
+	phi[i]=0.0;
+	theta[i]=0.0;
+      } else if (iz < (2*sz)/3) {
+	epsilon[i]=0.24;
+	delta[i]=0.1;
+	phi[i]=0.0;
+	theta[i]=0.0;
+      } else {
+	epsilon[i]=0.24;
+	delta[i]=0.1;
+	phi[i]=1.0;
+	theta[i]=atanf(1.0);
+      }
+      if (sigma > MAX_SIGMA || iz < sz/3) {
+	vsv[i]=0.0;
+      } else {
+	vsv[i]=vpz[i]*sqrtf(fabsf(epsilon[i]-delta[i])/sigma);
+      }
+    }
+    break;
+
+  case GRAD:
+
+    for (i=0; i<sx*sy*sz; i++) {
+      int ix, iy, iz;
+      coord(i, sx, sy, sz, &ix, &iy, &iz);
+      vpz[i]=GradVelocity(zPlane[iz]);
+      epsilon[i]=0.0;
+      delta[i]=0.0;
+      phi[i]=0.0;
+      theta[i]=0.0;
+      vsv[i]=0.0;
+    }
+  } // end switch
+}
+
+
+// MediumStability: stability limit of the time step of the time integrator for the medium
+//                  (vpz, epsilon) of a grid of steps dx, dy and planes at zPlane
+
+
+float MediumStability(int sx, int sy, int sz, float dx, float dy, float dz, const float *zPlane,
+		      const float *vpz, const float *epsilon) {
+
+  // dt^2 times the largest eigenvalue of the spatial operator, bounded by the velocity
+  // and the stencil symbol at the Nyquist wavenumber (Der2 of an alternating sequence),
+  // must not exceed TIME_STABILITY^2
+
+  float alternating[2*STENCIL_RADIUS+1];
+  for (int i=0; i<2*STENCIL_RADIUS+1; i++)
+    alternating[i]=(i%2) ? -1.0f : 1.0f;
+  const float symbol=fabsf(Der2(alternating, STENCIL_RADIUS, 1, 1.0f));
+#ifdef NONUNIFORM_Z
+  // stretched z axis: the largest over planes, with the velocity and spacing of each plane
+  float lambda=0.0f;
+  for (int iz=0; iz<sz; iz++) {
+    float vel=0.0f;
+    for (int iy=0; iy<sy; iy++)
+      for (int ix=0; ix<sx; ix++) {
+	const int i=ind(ix,iy,iz);
+	vel=fmaxf(vel,vpz[i]*sqrt(1.0+2*epsilon[i]));
+      }
+    const float h=ZGridSpacing(zPlane, sz, iz);
+    lambda=fmaxf(lambda, vel*vel*symbol*(1.0f/(dx*dx)+1.0f/(dy*dy)+1.0f/(h*h)));
+  }
+#else
+  float maxvel=vpz[0]*sqrt(1.0+2*epsilon[0]);
+  for (long i=1; i<(long)sx*sy*sz; i++)
+    maxvel=fmaxf(maxvel,vpz[i]*sqrt(1.0+2*epsilon[i]));
+  const float lambda=maxvel*maxvel*symbol*(1.0f/(dx*dx)+1.0f/(dy*dy)+1.0f/(dz*dz));
+#endif
+  return TIME_STABILITY/sqrtf(lambda);
+}
+
+
+// MediumBounds: slowest and fastest qP velocities of the formulation over lz meters
+//               centered on the source, scanned over a small grid
+
+
+void MediumBounds(enum Form prob, float lz, float *vmin, float *vmax) {
+  const int sx=BLOCK_X;
+  const int sy=BLOCK_Y;
+  const int sz=3*BLOCK_Z;
+  const int n=sx*sy*sz;
+  float zPlane[3*BLOCK_Z];
+  for (int iz=0; iz<sz; iz++)
+    zPlane[iz]=lz*((float)iz/(float)(sz-1)-0.5f);
+  float *vpz=(float *) malloc(6*n*sizeof(float));
+  Medium(prob, sx, sy, sz, zPlane, SIGMA, vpz, vpz+n, vpz+2*n, vpz+3*n, vpz+4*n, vpz+5*n);
+  const float *epsilon=vpz+2*n;
+  *vmin=vpz[0];
+  *vmax=vpz[0]*sqrtf(1.0f+2.0f*epsilon[0]);
+  for (int i=1; i<n; i++) {
+    *vmin=fminf(*vmin, vpz[i]);
+    *vmax=fmaxf(*vmax, vpz[i]*sqrtf(1.0f+2.0f*epsilon[i]));
+  }
+  free(vpz);
+}
+
+
+// MediumSlowest: slowest qP velocity of the formulation at coordinate z relative to the source plane
+
+
+float MediumSlowest(enum Form prob, float z) {
+
+  // the depth profile itself: a grid of one point does not fit the grid mapping of BRICK,
+  // and qP velocity changes with depth only in GRAD
+
+  if (prob == GRAD)
+    return GradVelocity(z);
+  return 3000.0f;
+}
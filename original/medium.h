@@ -0,0 +1,58 @@
+#ifndef _MEDIUM
+#define _MEDIUM
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "map.h"
+#include "fletcher.h"
+
+enum Form {ISO, VTI, TTI, MIX, GRAD};
+
+
+// GRAD: isotropic, qP velocity growing linearly with depth below the source plane,
+//       limited to GRAD_VMIN above it
+
+
+#define GRAD_V0 3000.0        // velocity at the source plane
+#define GRAD_K 2.0            // velocity gradient (1/s)
+#define GRAD_VMIN 1500.0      // slowest velocity
+
+
+// MediumForm: problem formulation named name; returns 0 if the name is unknown
+
+
+int MediumForm(const char *name, enum Form *prob);
+
+
+// Medium: fill the anisotropy arrays of the selected problem formulation with sigma
+//         (SIGMA by default); zPlane holds the z coordinate of each plane relative to
+//         the source plane
+
+
+void Medium(enum Form prob, int sx, int sy, int sz, const float *zPlane, double sigma,
+	    float *vpz, float *vsv, float *epsilon, float *delta,
+	    float *phi, float *theta);
+
+
+// MediumStability: stability limit of the time step of the time integrator for the medium
+//                  (vpz, epsilon) of a grid of steps dx, dy and planes at zPlane
+
+
+float MediumStability(int sx, int sy, int sz, float dx, float dy, float dz, const float *zPlane,
+		      const float *vpz, const float *epsilon);
+
+
+// MediumBounds: slowest and fastest qP velocities of the formulation over lz meters centered on the source
+
+
+void MediumBounds(enum Form prob, float lz, float *vmin, float *vmax);
+
+
+// MediumSlowest: slowest qP velocity of the formulation at coordinate z relative to the source plane
+
+
+float MediumSlowest(enum Form prob, float z);
+
+#endif
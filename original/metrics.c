@@ -0,0 +1,443 @@
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include "metrics.h"
+#include "medium.h"
+#include "derivatives.h"
+#include "sample.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef BACKEND
+#define BACKEND "unknown"
+#endif
+
+#define METRICS_NAME 256
+#define METRICS_POWERCAP "/sys/class/powercap"
+#define METRICS_ZONES 32
+
+
+static const char *phaseName[NPHASES]={"setup", "precompute", "source", "propagate", "output", "finalize"};
+
+static double phaseTime[NPHASES];
+static double reportedTime[NPHASES];     // phases of the last report
+static double *stepTime=NULL;
+static int nSteps=0;
+static int maxSteps=0;
+
+// RAPL zones of packages and DRAM, with the last reading and the energy since the first
+
+static int nZones=-1;
+static char zonePath[METRICS_ZONES][METRICS_NAME];
+static int zoneDram[METRICS_ZONES];
+static double zoneRange[METRICS_ZONES], zoneLast[METRICS_ZONES], zoneTotal[METRICS_ZONES];
+
+// energy of the time loop, negative if not measured
+
+static double loopPackage=-1.0, loopDram=-1.0, loopSeconds=0.0;
+
+
+// MetricsInitialize: room for the times of st propagate steps
+
+
+void MetricsInitialize(int st) {
+  free(stepTime);
+  stepTime=(double *) malloc((st > 0 ? st : 1)*sizeof(double));
+  maxSteps=st;
+  nSteps=0;
+}
+
+
+// MetricsPhase: add seconds to phase
+
+
+void MetricsPhase(enum Phase phase, double seconds) {
+  phaseTime[phase]+=seconds;
+}
+
+
+// MetricsReported: seconds of phase in the last MetricsReport
+
+
+double MetricsReported(enum Phase phase) {
+  return reportedTime[phase];
+}
+
+
+// MetricsStep: time of one propagate step, added to PHASE_PROPAGATE
+
+
+void MetricsStep(double seconds) {
+  phaseTime[PHASE_PROPAGATE]+=seconds;
+  if (nSteps < maxSteps)
+    stepTime[nSteps++]=seconds;
+}
+
+
+// ReadZone: value of file name in the directory of zone path; 0 on failure
+
+
+static int ReadZone(const char *path, const char *name, char *value, int len) {
+  char file[2*METRICS_NAME];
+  snprintf(file, sizeof(file), "%s/%s", path, name);
+  FILE *fp=fopen(file, "r");
+  if (fp == NULL)
+    return 0;
+  const int ok=(fgets(value, len, fp) != NULL);
+  fclose(fp);
+  return ok;
+}
+
+
+// Zones: the package and DRAM zones whose energy can be read; core, uncore
+//        and psys zones overlap them and are left out
+
+
+static void Zones() {
+  nZones=0;
+  DIR *dir=opendir(METRICS_POWERCAP);
+  if (dir == NULL)
+    return;
+  struct dirent *entry;
+  while ((entry=readdir(dir)) != NULL && nZones < METRICS_ZONES) {
+    if (strncmp(entry->d_name, "intel-rapl:", 11) != 0)
+      continue;
+    char path[METRICS_NAME], value[METRICS_NAME];
+    snprintf(path, METRICS_NAME, "%s/%s", METRICS_POWERCAP, entry->d_name);
+    if (!ReadZone(path, "name", value, METRICS_NAME))
+      continue;
+    const int dram=(strncmp(value, "dram", 4) == 0);
+    if (!dram && strncmp(value, "package", 7) != 0)
+      continue;
+    if (!ReadZone(path, "energy_uj", value, METRICS_NAME))
+      continue;
+    zoneLast[nZones]=atof(value);
+    zoneRange[nZones]=ReadZone(path, "max_energy_range_uj", value, METRICS_NAME) ? atof(value) : 0.0;
+    zoneTotal[nZones]=0.0;
+    zoneDram[nZones]=dram;
+    snprintf(zonePath[nZones++], METRICS_NAME, "%s", path);
+  }
+  closedir(dir);
+}
+
+
+// MetricsEnergy: package and DRAM energy (J) of all sockets since the first call; returns 0
+//                if no RAPL zone can be read. Counters wrap after minutes to hours:
+//                calls must be closer than that
+
+
+int MetricsEnergy(double *package, double *dram) {
+  if (nZones < 0)
+    Zones();
+  *package=*dram=0.0;
+  for (int z=0; z<nZones; z++) {
+    char value[METRICS_NAME];
+    if (ReadZone(zonePath[z], "energy_uj", value, METRICS_NAME)) {
+      const double now=atof(value);
+      double delta=now-zoneLast[z];
+      if (delta < 0.0)
+	delta+=zoneRange[z];
+      zoneTotal[z]+=delta;
+      zoneLast[z]=now;
+    }
+    if (zoneDram[z])
+      *dram+=1.0e-6*zoneTotal[z];
+    else
+      *package+=1.0e-6*zoneTotal[z];
+  }
+  return nZones > 0;
+}
+
+
+// MetricsLoopEnergy: package and DRAM energy of the time loop, and its length in seconds
+
+
+void MetricsLoopEnergy(double package, double dram, double seconds) {
+  loopPackage=package;
+  loopDram=dram;
+  loopSeconds=seconds;
+}
+
+
+// MetricsFileName: report file name with extension ext
+
+
+const char *MetricsFileName(const char *ext) {
+  static char name[METRICS_NAME];
+  const char *env=getenv("FLETCHER_REPORT");
+  snprintf(name, METRICS_NAME, "%s%s", (env != NULL) ? env : "Report", ext);
+  return name;
+}
+
+
+// SampleCounts: flops of the rhs of one sample of class (TILE_ISO, TILE_VTI, TILE_TTI) of
+//               sample.h, and arrays it reads: the two stencil fields and the coefficients
+
+
+static void SampleCounts(int class, double *flops, int *arrays) {
+  const int r=STENCIL_RADIUS;
+
+  // Der2 adds symmetric pairs first, DerCross groups the 4 corners of each L_a*L_b
+  // (as counted by dispersion.exe); a stretched z axis has an asymmetric Der2Z and
+  // one more product for the cross derivatives in z
+
+  const double der2=3*r+2;
+  const double derCross=5*r*r+r;
+#ifdef NONUNIFORM_Z
+  const double der2z=4*r+1;
+  const double derCrossZ=derCross+1;
+#else
+  const double der2z=der2;
+  const double derCrossZ=derCross;
+#endif
+
+  switch (class) {
+  case TILE_ISO:
+    *flops=2*der2+der2z+7;
+    *arrays=5;
+    break;
+  case TILE_VTI:
+    *flops=4*der2+2*der2z+14;
+    *arrays=6;
+    break;
+  default:
+    *flops=2*(2*der2+der2z+derCross+2*derCrossZ+14)+12;
+    *arrays=12;
+    break;
+  }
+}
+
+
+// MetricsClassCounts: flops and bytes of memory traffic per sample of the propagate kernel
+//                     running sample class (TILE_ISO, TILE_VTI, TILE_TTI), assuming every
+//                     array is read once and written once per step
+
+
+void MetricsClassCounts(int class, double *flops, double *bytes) {
+
+#ifdef HALF
+  const double field=2.0;   // fp16 and bf16
+#else
+  const double field=sizeof(float);
+#endif
+
+  double f;
+  int arrays;
+  SampleCounts(class, &f, &arrays);
+#if TIME_ORDER == 4
+  // rhs pass writes rp and rq; update pass applies the operator to them and
+  // reads pc, qc, pp and qp, writes pp and qp
+  *flops=2*f+18;
+  *bytes=sizeof(float)*(2*arrays+2+6);
+#elif defined(HALF)
+  // pc, qc, pp and qp in half precision, decoded and encoded with their scales
+  *flops=f+16;
+  *bytes=sizeof(float)*(arrays-2)+field*(2+4);
+#else
+  *flops=f+10;
+  *bytes=sizeof(float)*(arrays-2)+field*(2+4);
+#endif
+}
+
+
+// samples of the grid of the run in each class, from MetricsClasses
+
+static double classSamples[3]={0.0, 0.0, 0.0};
+
+
+// MetricsClasses: samples the propagate kernel runs in each class (TILE_ISO, TILE_VTI,
+//                 TILE_TTI), as classified by SPECIALIZE or JIT for the medium of the run
+
+
+void MetricsClasses(const long *samples) {
+  for (int class=TILE_ISO; class<=TILE_TTI; class++)
+    classSamples[class]=samples[class];
+}
+
+
+// MetricsKernel: flops and bytes per sample of the propagate kernel for formulation name;
+//                returns the sample classes it runs
+
+
+const char *MetricsKernel(const char *name, double *flops, double *bytes) {
+
+  // kernels specialized at run time or per block run the cheapest class of the
+  // formulation; JIT runs the whole grid in one class, TTI for MIX. The share of
+  // each class comes from MetricsClasses once the medium is classified, equal
+  // thirds of MIX before that; the generic kernel is TTI
+
+  double fraction[3]={0.0, 0.0, 1.0};
+  const char *variant="TTI";
+#if defined(SPECIALIZE) || defined(JIT)
+  enum Form prob;
+  if (MediumForm(name, &prob)) {
+    fraction[TILE_TTI]=0.0;
+    switch (prob) {
+    case ISO:
+    case GRAD:
+      fraction[TILE_ISO]=1.0;
+      variant="ISO";
+      break;
+    case VTI:
+      fraction[TILE_VTI]=1.0;
+      variant="VTI";
+      break;
+    case TTI:
+      fraction[TILE_TTI]=1.0;
+      break;
+    case MIX:
+#ifdef JIT
+      fraction[TILE_TTI]=1.0;
+#else
+      fraction[TILE_ISO]=fraction[TILE_VTI]=fraction[TILE_TTI]=1.0/3.0;
+      variant="ISO/VTI/TTI";
+#endif
+      break;
+    }
+  }
+  const double samples=classSamples[TILE_ISO]+classSamples[TILE_VTI]+classSamples[TILE_TTI];
+  if (samples > 0.0)
+    for (int class=TILE_ISO; class<=TILE_TTI; class++)
+      fraction[class]=classSamples[class]/samples;
+#endif
+
+  *flops=0.0;
+  *bytes=0.0;
+  for (int class=TILE_ISO; class<=TILE_TTI; class++) {
+    double f, b;
+    MetricsClassCounts(class, &f, &b);
+    *flops+=fraction[class]*f;
+    *bytes+=fraction[class]*b;
+  }
+  return variant;
+}
+
+
+// Percentile: nearest rank percentile p of n sorted values
+
+
+static double Percentile(const double *sorted, int n, double p) {
+  int k=(int)ceil(0.01*p*n)-1;
+  if (k < 0) k=0;
+  if (k > n-1) k=n-1;
+  return sorted[k];
+}
+
+
+static int CompareDouble(const void *a, const void *b) {
+  const double x=*(const double *)a, y=*(const double *)b;
+  return (x > y) - (x < y);
+}
+
+
+// MetricsReport: print the phase times and step percentiles and write the JSON report
+
+
+void MetricsReport(const char *name,
+		   int sx, int sy, int sz, int bord, int absorb,
+		   float dx, float dy, float dz, float dt, int st,
+		   long samples, long hwmKB) {
+
+  double flops, bytes;
+  const char *variant=MetricsKernel(name, &flops, &bytes);
+
+  // step percentiles
+
+  double *sorted=(double *) malloc((nSteps > 0 ? nSteps : 1)*sizeof(double));
+  memcpy(sorted, stepTime, nSteps*sizeof(double));
+  qsort(sorted, nSteps, sizeof(double), CompareDouble);
+  const int n=(nSteps > 0) ? nSteps : 1;
+  if (nSteps == 0)
+    sorted[0]=0.0;
+  const double stepMin=sorted[0], stepMax=sorted[n-1];
+  const double p50=Percentile(sorted, n, 50.0);
+  const double p90=Percentile(sorted, n, 90.0);
+  const double p99=Percentile(sorted, n, 99.0);
+  free(sorted);
+
+  const double tProp=phaseTime[PHASE_PROPAGATE];
+  const double perSecond=(tProp > 0.0) ? (double)samples/tProp : 0.0;
+  double total=0.0;
+  for (int k=0; k<NPHASES; k++)
+    total+=phaseTime[k];
+
+  printf("Phase times (s):");
+  for (int k=0; k<NPHASES; k++)
+    printf(" %s %.3lf;", phaseName[k], phaseTime[k]);
+  printf(" total %.3lf\n", total);
+  printf("Step times (ms): min %.3lf p50 %.3lf p90 %.3lf p99 %.3lf max %.3lf\n",
+	 1.0e3*stepMin, 1.0e3*p50, 1.0e3*p90, 1.0e3*p99, 1.0e3*stepMax);
+  printf("%s kernel, %.0lf flops and %.0lf bytes per sample: %.2lf GFLOP/s, %.2lf GB/s\n",
+	 variant, flops, bytes, 1.0e-9*flops*perSecond, 1.0e-9*bytes*perSecond);
+
+  // energy to solution of the time loop
+
+  const double joules=loopPackage+loopDram;
+  const int energy=(loopPackage >= 0.0 && joules > 0.0 && loopSeconds > 0.0);
+  if (energy)
+    printf("Energy of the time loop: package %.2lf J, DRAM %.2lf J, %.2lf W average, %.3lf MSamples/J\n",
+	   loopPackage, loopDram, joules/loopSeconds, 1.0e-6*samples/joules);
+  else
+    printf("Energy of the time loop: not measured, no readable RAPL zone in %s\n", METRICS_POWERCAP);
+
+  // JSON report
+
+  char host[METRICS_NAME]="unknown";
+  gethostname(host, METRICS_NAME-1);
+  char stamp[32];
+  const time_t now=time(NULL);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+#ifdef _OPENMP
+  const int threads=omp_get_max_threads();
+#else
+  const char *env=getenv("OMP_NUM_THREADS");
+  const int threads=(env != NULL) ? atoi(env) : 1;
+#endif
+
+  FILE *fp=fopen(MetricsFileName(".json"), "w");
+  if (fp == NULL) {
+    printf("MetricsReport: cannot write %s\n", MetricsFileName(".json"));
+    return;
+  }
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"formulation\": \"%s\",\n", name);
+  fprintf(fp, "  \"backend\": \"%s\",\n", BACKEND);
+  fprintf(fp, "  \"host\": \"%s\",\n", host);
+  fprintf(fp, "  \"threads\": %d,\n", threads);
+  fprintf(fp, "  \"date\": \"%s\",\n", stamp);
+  fprintf(fp, "  \"grid\": {\"sx\": %d, \"sy\": %d, \"sz\": %d, \"bord\": %d, \"absorb\": %d, "
+	  "\"dx\": %g, \"dy\": %g, \"dz\": %g, \"dt\": %g, \"st\": %d},\n",
+	  sx, sy, sz, bord, absorb, dx, dy, dz, dt, st);
+  fprintf(fp, "  \"kernel\": {\"variant\": \"%s\", \"stencil_order\": %d, \"time_order\": %d, "
+	  "\"flops_per_sample\": %.1lf, \"bytes_per_sample\": %.1lf},\n",
+	  variant, 2*STENCIL_RADIUS, TIME_ORDER, flops, bytes);
+  fprintf(fp, "  \"phases\": {");
+  for (int k=0; k<NPHASES; k++)
+    fprintf(fp, "\"%s\": %.6lf, ", phaseName[k], phaseTime[k]);
+  fprintf(fp, "\"total\": %.6lf},\n", total);
+  fprintf(fp, "  \"steps\": {\"count\": %d, \"min\": %.6le, \"p50\": %.6le, \"p90\": %.6le, "
+	  "\"p99\": %.6le, \"max\": %.6le, \"mean\": %.6le},\n",
+	  nSteps, stepMin, p50, p90, p99, stepMax, tProp/n);
+  fprintf(fp, "  \"rates\": {\"msamples_per_s\": %.3lf, \"gflops\": %.3lf, \"gbytes_per_s\": %.3lf},\n",
+	  1.0e-6*perSecond, 1.0e-9*flops*perSecond, 1.0e-9*bytes*perSecond);
+  if (energy)
+    fprintf(fp, "  \"energy\": {\"package_j\": %.3lf, \"dram_j\": %.3lf, \"watts\": %.3lf, "
+	    "\"msamples_per_j\": %.4lf},\n",
+	    loopPackage, loopDram, joules/loopSeconds, 1.0e-6*samples/joules);
+  else
+    fprintf(fp, "  \"energy\": null,\n");
+  fprintf(fp, "  \"memory\": {\"hwm_kb\": %ld}\n", hwmKB);
+  fprintf(fp, "}\n");
+  fclose(fp);
+
+  for (int k=0; k<NPHASES; k++) {
+    reportedTime[k]=phaseTime[k];
+    phaseTime[k]=0.0;
+  }
+  free(stepTime);
+  stepTime=NULL;
+  nSteps=maxSteps=0;
+  loopPackage=loopDram=-1.0;
+  loopSeconds=0.0;
+}
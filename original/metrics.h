@@ -0,0 +1,97 @@
+#ifndef _METRICS
+#define _METRICS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+
+// Per phase metrics of a run. Phases are timed by main and Model, propagate steps
+// one by one; at the end the effective bandwidth and flop rate of the propagate
+// kernel are derived from its bytes and flops per sample, and the report is written
+// in JSON next to the CSV report. Reports are named after $FLETCHER_REPORT, or
+// Report, with extensions .csv and .json. Where the RAPL zones of the Linux powercap
+// interface are readable, package and DRAM energy of the time loop are reported
+// as joules, average watts and MSamples per joule.
+
+
+enum Phase {PHASE_SETUP, PHASE_PRECOMPUTE, PHASE_SOURCE, PHASE_PROPAGATE,
+	    PHASE_OUTPUT, PHASE_FINALIZE, NPHASES};
+
+
+// MetricsInitialize: room for the times of st propagate steps
+
+
+void MetricsInitialize(int st);
+
+
+// MetricsPhase: add seconds to phase
+
+
+void MetricsPhase(enum Phase phase, double seconds);
+
+
+// MetricsReported: seconds of phase in the last MetricsReport, which starts the
+//                  phases of the next run in this process from zero
+
+
+double MetricsReported(enum Phase phase);
+
+
+// MetricsStep: time of one propagate step, added to PHASE_PROPAGATE
+
+
+void MetricsStep(double seconds);
+
+
+// MetricsEnergy: package and DRAM energy (J) of all sockets since the first call; returns 0
+//                if no RAPL zone can be read. Counters wrap after minutes to hours:
+//                calls must be closer than that
+
+
+int MetricsEnergy(double *package, double *dram);
+
+
+// MetricsLoopEnergy: package and DRAM energy of the time loop, and its length in seconds
+
+
+void MetricsLoopEnergy(double package, double dram, double seconds);
+
+
+// MetricsFileName: report file name with extension ext
+
+
+const char *MetricsFileName(const char *ext);
+
+
+// MetricsClassCounts: flops and bytes of memory traffic per sample of the propagate kernel
+//                     running sample class (TILE_ISO, TILE_VTI, TILE_TTI)
+
+
+void MetricsClassCounts(int class, double *flops, double *bytes);
+
+
+// MetricsClasses: samples the propagate kernel runs in each class (TILE_ISO, TILE_VTI,
+//                 TILE_TTI), as classified by SPECIALIZE or JIT for the medium of the run
+
+
+void MetricsClasses(const long *samples);
+
+
+// MetricsKernel: flops and bytes per sample of the propagate kernel for formulation name;
+//                returns the sample classes it runs
+
+
+const char *MetricsKernel(const char *name, double *flops, double *bytes);
+
+
+// MetricsReport: print the phase times and step percentiles and write the JSON report
+
+
+void MetricsReport(const char *name,
+		   int sx, int sy, int sz, int bord, int absorb,
+		   float dx, float dy, float dz, float dt, int st,
+		   long samples, long hwmKB);
+
+#endif
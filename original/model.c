@@ -1,17 +1,20 @@
 #include "utils.h"
 #include "source.h"
-#include "driver.h"
+#include "libfletcher.h"
+#include "consumer.h"
+#include "verify.h"
 #include "fletcher.h"
 #include "walltime.h"
 #include "model.h"
+#include "plan.h"
+#include "metrics.h"
+#include "trace.h"
+#include "roofline.h"
+#include "history.h"
+#include "zgrid.h"
 #ifdef PAPI
 #include "ModPAPI.h"
 #endif
-
-#define MODEL_GLOBALVARS
-#include "precomp.h"
-#undef MODEL_GLOBALVARS
-
 #include <time.h>
 #include <stdint.h>
 #include <inttypes.h>
@@ -40,12 +43,21 @@ void ReportMetricsCSV(double walltime, double MSamples,
 }
 
 
-void Model(const int st, const int iSource, const float dtOutput, SlicePtr sPtr, 
+// Verify: output of time step it against the reference ($FLETCHER_VERIFY); 0 if it
+//         has errors, and the run stops there
+
+
+static int Verify(VerifyT *verify, int it, const float *pc) {
+  return verify == NULL || VerifyStep(verify, it, pc) == 0;
+}
+
+
+int Model(const int st, const int iSource, const float dtOutput, SlicePtr sPtr, const char *form,
            const int sx, const int sy, const int sz, const int bord,
            const float dx, const float dy, const float dz, const float dt, const int it, 
-	   float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc,
 	   float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
-	   float * restrict phi, float * restrict theta, int absorb)
+	   float * restrict phi, float * restrict theta, int absorb,
+	   const float *zPlane, FletcherT *reuse)
 {
 
   float tSim=0.0;
@@ -56,77 +68,152 @@ void Model(const int st, const int iSource, const float dtOutput, SlicePtr sPtr,
   const long totalSamples=samplesPropagate*(long)st;
 
 #ifdef PAPI
-  long long values[NCOUNTERS];
-  long long ThisValues[NCOUNTERS];
-  for (int i=0; i<NCOUNTERS; i++) {
-    values[i]=0LL;
-    ThisValues[i]=0LL;
-  }
-
-  const int eventset=InitPAPI_CreateCounters();
+  InitPAPI_CreateCounters();
 #endif
 
-#define MODEL_INITIALIZE
-#include "precomp.h"
-#undef MODEL_INITIALIZE
+  MetricsInitialize(st);
+
+  // the propagator context precomputes the coefficients, allocates the wave
+  // fields and initializes the backend
+
+  const FletcherGridT grid={sx, sy, sz, bord, dx, dy, dz, dt, 0, 0};
+  FletcherT *ctx=(reuse != NULL) ? reuse :
+    FletcherInit(&grid, vpz, vsv, epsilon, delta, phi, theta, zPlane);
+  if (ctx == NULL)
+    exit(-1);
+  double tPrecompute, tSetup;
+  FletcherTimes(ctx, &tPrecompute, &tSetup);
+  MetricsPhase(PHASE_PRECOMPUTE, tPrecompute);
+  MetricsPhase(PHASE_SETUP, tSetup);
+
+  // initial (null) wave field, verified against a reference if $FLETCHER_VERIFY is set
+
+  double tPhase=wtime();
+  VerifyT *verify=VerifyOpen(sx, sy, sz, zPlane);
+#ifdef NONUNIFORM_Z
+  ZGridDump(sx,sy,sz,zPlane,FletcherSnapshot(ctx),sPtr);
+#else
+  DumpSliceFile(sx,sy,sz,FletcherSnapshot(ctx),sPtr);
+#endif
+  int differs=Verify(verify, 0, FletcherSnapshot(ctx)) ? -1 : 0;
+  MetricsPhase(PHASE_OUTPUT, wtime()-tPhase);
 
-  // DRIVER_Initialize initialize target, allocate data etc
-  DRIVER_Initialize(sx,   sy,   sz,   bord,
-		      dx,  dy,  dz,  dt,
-		      vpz,    vsv,    epsilon,    delta,
-		      phi,    theta,
-		      pp,    pc,    qp,    qc);
+  // in-process consumers of the outputs ($FLETCHER_CONSUMER), NULL if none
 
+  ConsumerT *consumer=ConsumerBuiltin(sx, sy, sz, bord);
   
   double walltime=0.0;
   double tdt=0.0;
   uint64_t stamp1 = get_timestamp_ns();
 
-  for (int it=1; it<=st; it++) {
+  // energy of the time loop, read again at every output so that no counter wraps unseen
+
+  double package0, dram0, package, dram;
+  const int energy=MetricsEnergy(&package0, &dram0);
+  const double tLoop=wtime();
+  int diverged=0;
+
+  for (int it=1; it<=st && differs < 0; it++) {
 
     // Calculate / obtain source value on i timestep
+    tPhase=wtime();
+    TRACE_BEGIN(tSource);
     float src = Source(dt, it-1);
     
-    DRIVER_InsertSource(dt,it-1,iSource,pc,qc,src);
+    FletcherInject(ctx,iSource,src);
+    TRACE_END(tSource, TRACE_SOURCE, -1);
+    MetricsPhase(PHASE_SOURCE, wtime()-tPhase);
+
+    // counters start and stop outside of the timed step
 
 #ifdef PAPI
-    StartCounters(eventset);
+    StartCounters(it);
 #endif
 
     const double t0=wtime();
-    DRIVER_Propagate(  sx,   sy,   sz,   bord,
-		       dx,   dy,   dz,   dt,   it,
-		       pp,    pc,    qp,    qc);
-
-    SwapArrays(&pp, &pc, &qp, &qc);
-    walltime+=wtime()-t0;
+    const int done=FletcherStep(ctx,1);
+    const double tStep=wtime()-t0;
+    walltime+=tStep;
+    MetricsStep(tStep);
 
 #ifdef PAPI
-    StopReadCounters(eventset, ThisValues);
-    for (int i=0; i<NCOUNTERS; i++) {
-      values[i]+=ThisValues[i];
-    }
+    StopReadCounters(it);
 #endif
+    if (done < 1) {
+      diverged=it;
+      break;
+    }
+
+    // half a step of slack keeps rounding from delaying outputs by one step
 
     tSim=it*dt;
-    if (tSim >= tOut) {
+    if (tSim >= tOut-0.5f*dt) {
 
-      DRIVER_Update_pointers(sx,sy,sz,pc);
+      tPhase=wtime();
+      TRACE_BEGIN(tOutput);
+      const float *pc=FletcherSnapshot(ctx);
 
       // double dd1 = wtime();
+#ifdef NONUNIFORM_Z
+      ZGridDump(sx,sy,sz,zPlane,pc,sPtr);
+#else
       DumpSliceFile_Nofor(sx,sy,sz,pc,sPtr);
+#endif
       // tdt+=wtime()-dd1;
+      if (!Verify(verify, it, pc))
+	differs=it;
+
+      if (consumer != NULL) {
+	const float *p, *q;
+	FletcherFields(ctx, &p, &q);
+	ConsumerPublish(consumer, it, tSim, p, q);
+      }
 
       tOut=(++nOut)*dtOutput;
 #ifdef _DUMP
-      DRIVER_Update_pointers(sx,sy,sz,pc);
       //      DumpSliceSummary(sx,sy,sz,sPtr,dt,it,pc,src);
 #endif
+      TRACE_END(tOutput, TRACE_OUTPUT, nOut-1);
+      MetricsPhase(PHASE_OUTPUT, wtime()-tPhase);
+      if (energy)
+	MetricsEnergy(&package, &dram);
     }
   }
+  if (energy) {
+    MetricsEnergy(&package, &dram);
+    MetricsLoopEnergy(package-package0, dram-dram0, wtime()-tLoop);
+  }
+
+  // callbacks still running on the last outputs finish before the report
+  if (consumer != NULL) {
+    tPhase=wtime();
+    ConsumerFree(consumer);
+    MetricsPhase(PHASE_OUTPUT, wtime()-tPhase);
+  }
 
   // close binary output file before measuring time to include total io time
+  tPhase=wtime();
+  if (verify != NULL)
+    VerifyClose(verify);
   CloseSliceFile(sPtr);
+  MetricsPhase(PHASE_OUTPUT, wtime()-tPhase);
+
+  // a diverged run, or one that differs from the reference, ends here, without
+  // reports or records of its throughput
+
+  if (diverged || differs >= 0) {
+    if (diverged)
+      printf("**(Model)**: wave fields diverged at time step %d of %d; run stopped\n", diverged, st);
+    else
+      printf("**(Model)**: output of time step %d differs from the reference; run stopped\n", differs);
+#ifdef PAPI
+    FinalizePAPI();
+#endif
+    if (reuse == NULL)
+      FletcherFree(ctx);
+    fflush(stdout);
+    return 0;
+  }
 
   uint64_t stamp2 = get_timestamp_ns();
 
@@ -159,14 +246,13 @@ void Model(const int st, const int iSource, const float dtOutput, SlicePtr sPtr,
   printf ("Memory High Water Mark is %ld %s\n",HWM, HWMUnit);
 
   printf("original,%s,%d,%d,%d,%d,%.2f,%.2f,%.2f,%f,%f,%lu,%lu,%lf,%lf,%.0lf\n", 
-          sPtr->fName, sx - 2*bord - 2*absorb, sy - 2*bord - 2*absorb, sz - 2*bord - 2*absorb, absorb, dx, dy, dz, dt, st*dt, 
+          form, sx - 2*bord - 2*absorb, sy - 2*bord - 2*absorb, sz - 2*bord - 2*absorb, absorb, dx, dy, dz, dt, st*dt, 
           stamp1, stamp2, walltime, execution_time, MSamples);
 
   // Dump Execution Metrics in CSV
   
   FILE *fr=NULL;
-  const char fName[]="Report.csv";
-  fr=fopen(fName,"w");
+  fr=fopen(MetricsFileName(".csv"),"w");
 
   // report problem size
 
@@ -178,19 +264,43 @@ void Model(const int st, const int iSource, const float dtOutput, SlicePtr sPtr,
 
   ReportMetricsCSV(walltime, MSamples,
 		   HWM, HWMUnit, fr);
+
+  // calibrate the planner throughput
+
+  PlanRecord(form, walltime, MSamples, HWM);
+  RooflineRecord(form, totalSamples, walltime);
+
+  // append the run to the results history
+
+  double flops, bytes;
+  HistoryAppend("run", form, MetricsKernel(form, &flops, &bytes),
+		sx-2*bord-2*absorb, sy-2*bord-2*absorb, sz-2*bord-2*absorb, 0, MSamples, HWM);
   
   // report PAPI metrics
 
 #ifdef PAPI
-  ReportRawCountersCSV (values, fr);
+  ReportRawCountersCSV (totalSamples, fr);
+  FinalizePAPI();
 #endif
   
   fclose(fr);
 
   fflush(stdout);
 
-  // DRIVER_Finalize deallocate data, clean-up things etc 
-  DRIVER_Finalize();
+  // FletcherFree finalizes the backend and releases the context; a reused one is the caller's
+  if (reuse == NULL) {
+    tPhase=wtime();
+    FletcherFree(ctx);
+    MetricsPhase(PHASE_FINALIZE, wtime()-tPhase);
+  }
+
+  // per phase metrics and derived rates in JSON
 
+  MetricsReport(form,
+		sx, sy, sz, bord, absorb,
+		dx, dy, dz, dt, st,
+		totalSamples, HWM);
+  fflush(stdout);
+  return 1;
 }
 
@@ -5,12 +5,23 @@
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include "utils.h"
+#include "libfletcher.h"
 
-void Model(const int st, const int iSource, const float dtOutput, SlicePtr sPtr, 
+
+// Model: st time steps of formulation form from null wave fields, with outputs every
+//        dtOutput to sPtr and the reports of the run; on the context reuse, set up for
+//        this grid and medium by the caller, or on a context of its own if NULL.
+//        Returns 1, or 0 if the wave fields diverged (DIAG) or an output differs
+//        from $FLETCHER_VERIFY: the run stops there, its outputs are closed and it
+//        is not reported
+
+
+int Model(const int st, const int iSource, const float dtOutput, SlicePtr sPtr, const char *form,
            const int sx, const int sy, const int sz, const int bord,
            const float dx, const float dy, const float dz, const float dt, const int it, 
-	   float * restrict pp, float * restrict pc, float * restrict qp, float * restrict qc,
 	   float * restrict vpz, float * restrict vsv, float * restrict epsilon, float * restrict delta,
-	   float * restrict phi, float * restrict theta, int absorb);
+	   float * restrict phi, float * restrict theta, int absorb,
+	   const float *zPlane, FletcherT *reuse);
 
 #endif
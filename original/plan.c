@@ -0,0 +1,194 @@
+#include <unistd.h>
+#include "plan.h"
+#include "history.h"
+#include "metrics.h"
+
+#ifndef BACKEND
+#define BACKEND "unknown"
+#endif
+
+
+// planning in use in this process, set by Plan
+
+static int planning=0;
+
+// metrics of the last run, from PlanRecord
+
+static double actualWalltime=0.0;
+static double actualMSamples=0.0;
+static long actualHWM=0;
+
+
+// CalibName: path of the calibration file
+
+
+static const char *CalibName() {
+  const char *env=getenv("FLETCHER_PLAN_CALIB");
+  return (env != NULL) ? env : "Plan.calib";
+}
+
+
+// CalibKey: calibration key of formulation name, as History.dat keys its runs:
+//           backend, formulation, kernel variant, threads and host
+
+
+static void CalibKey(const char *name, char *key) {
+  double flops, bytes;
+  snprintf(key, PLAN_KEY, "%s %s %s %d %s", BACKEND, name,
+	   MetricsKernel(name, &flops, &bytes), HistoryThreads(), HistoryHost());
+}
+
+
+// ReadCalib: keys and throughputs in the calibration file, one "key msamples" per
+//            line; returns how many
+
+
+static int ReadCalib(char key[][PLAN_KEY], double *msamples) {
+  int n=0;
+  FILE *fp=fopen(CalibName(), "r");
+  if (fp == NULL)
+    return 0;
+  char line[2*PLAN_KEY];
+  while (n < PLAN_CALIB_KEYS && fgets(line, sizeof(line), fp) != NULL) {
+    const char *last=strrchr(line, ' ');
+    if (last == NULL || sscanf(last, "%lf", &msamples[n]) != 1)
+      continue;
+    snprintf(key[n], PLAN_KEY, "%.*s", (int)(last-line), line);
+    n++;
+  }
+  fclose(fp);
+  return n;
+}
+
+
+// Plan: plan a run of formulation prob over the physical extent (lx,ly,lz) in meters
+
+
+void Plan(enum Form prob, const char *name,
+	  float lx, float ly, float lz, int absorb, int bord,
+	  float ppw, float tmax, float dtOutput, PlanT *plan) {
+
+  planning=1;
+
+  // shortest wavelength is the slowest qP velocity at the cutoff frequency
+
+  float vmin, vmax;
+  MediumBounds(prob, lz, &vmin, &vmax);
+  const float lambda=vmin/FCUT;
+  const float h=lambda/ppw;
+
+  plan->dx=plan->dy=plan->dz=h;
+  plan->nx=(int)ceilf(lx/h)+1;
+  plan->ny=(int)ceilf(ly/h)+1;
+  plan->nz=(int)ceilf(lz/h)+1;
+  plan->sx=plan->nx+2*bord+2*absorb;
+  plan->sy=plan->ny+2*bord+2*absorb;
+  plan->sz=plan->nz+2*bord+2*absorb;
+
+  // largest dt allowed by MI, shortened so that a whole number of steps spans dtOutput
+
+  const float recdt=(MI*h)/vmax;
+  const int stepsPerOutput=(int)ceilf(dtOutput/recdt);
+  plan->dt=dtOutput/stepsPerOutput;
+  plan->st=(int)ceilf(tmax/plan->dt);
+
+  // memory: anisotropy (6), wave field (4) and coefficient (10) arrays
+
+  const double points=(double)plan->sx*(double)plan->sy*(double)plan->sz;
+  int arrays=20;
+#if TIME_ORDER == 4
+  arrays+=2;
+#endif
+  plan->bytes=points*arrays*sizeof(float);
+
+  // propagation time from calibrated throughput
+
+  char key[PLAN_CALIB_KEYS][PLAN_KEY], own[PLAN_KEY];
+  double msamples[PLAN_CALIB_KEYS];
+  const int n=ReadCalib(key, msamples);
+  CalibKey(name, own);
+  plan->msamples=PLAN_DEFAULT_MSAMPLES;
+  plan->calibrated=0;
+  for (int k=0; k<n; k++)
+    if (strcmp(key[k], own) == 0) {
+      plan->msamples=msamples[k];
+      plan->calibrated=1;
+    }
+  const double samples=(double)(plan->sx-2*bord)*(double)(plan->sy-2*bord)*(double)(plan->sz-2*bord);
+  plan->seconds=samples*plan->st/(1.0e6*plan->msamples);
+
+  printf("Plan for %s over (%.1f,%.1f,%.1f) m, cutoff %.1f Hz, %.1f points per wavelength\n",
+	 name, lx, ly, lz, FCUT, ppw);
+  printf("  qP velocity from %.1f to %.1f m/s; shortest wavelength %.2f m\n", vmin, vmax, lambda);
+  printf("  grid (%d,%d,%d) with spacing (%.3f,%.3f,%.3f); dimensions (%d,%d,%d)\n",
+	 plan->nx, plan->ny, plan->nz, plan->dx, plan->dy, plan->dz, plan->sx, plan->sy, plan->sz);
+  printf("  time step %f (MI=%.2f), %d steps per output, %d steps to %f\n",
+	 plan->dt, MI, stepsPerOutput, plan->st, plan->st*plan->dt);
+  printf("  memory %.1f MB; propagation %.2f s at %.1f MSamples/s (%s)\n",
+	 plan->bytes/1.0e6, plan->seconds, plan->msamples,
+	 plan->calibrated ? "calibrated" : "not calibrated, default throughput");
+  printf("  command: %s %d %d %d %d %f %f %f %f %f\n",
+	 name, plan->nx, plan->ny, plan->nz, absorb, plan->dx, plan->dy, plan->dz, plan->dt, tmax);
+}
+
+
+// PlanRecord: record the metrics of a finished run, and its throughput in the calibration
+//             file when planning is in use or $FLETCHER_PLAN_CALIB is set
+
+
+void PlanRecord(const char *name, double walltime, double msamples, long hwmKB) {
+
+  actualWalltime=walltime;
+  actualMSamples=msamples;
+  actualHWM=hwmKB;
+  const char *env=getenv("FLETCHER_PLAN_CALIB");
+  if (!planning && (env == NULL || env[0] == '\0'))
+    return;
+
+  char key[PLAN_CALIB_KEYS][PLAN_KEY], own[PLAN_KEY];
+  double ms[PLAN_CALIB_KEYS];
+  int n=ReadCalib(key, ms);
+  CalibKey(name, own);
+  int k;
+  for (k=0; k<n; k++)
+    if (strcmp(key[k], own) == 0)
+      break;
+  if (k == n) {
+    if (n == PLAN_CALIB_KEYS) {
+      printf("PlanRecord: %s holds %d calibrations; %s not recorded\n", CalibName(), n, own);
+      return;
+    }
+    strcpy(key[k], own);
+    n++;
+  }
+  ms[k]=msamples;
+
+  // written aside and renamed over the file, so that readers never see it partial
+
+  char tmp[PLAN_KEY];
+  snprintf(tmp, PLAN_KEY, "%s.%d", CalibName(), (int)getpid());
+  FILE *fp=fopen(tmp, "w");
+  if (fp == NULL) {
+    printf("PlanRecord: cannot write %s\n", tmp);
+    return;
+  }
+  for (k=0; k<n; k++)
+    fprintf(fp, "%s %lf\n", key[k], ms[k]);
+  if (fclose(fp) != 0 || rename(tmp, CalibName()) != 0) {
+    printf("PlanRecord: cannot replace %s\n", CalibName());
+    unlink(tmp);
+  }
+}
+
+
+// PlanReport: print the plan alongside the metrics recorded by PlanRecord
+
+
+void PlanReport(const PlanT *plan) {
+  printf("Plan vs actual: propagation %.2f s planned, %.2f s measured (ratio %.2f)\n",
+	 plan->seconds, actualWalltime, (plan->seconds > 0.0) ? actualWalltime/plan->seconds : 0.0);
+  printf("Plan vs actual: throughput %.1f MSamples/s planned, %.1f measured\n",
+	 plan->msamples, actualMSamples);
+  printf("Plan vs actual: memory %.1f MB planned, %.1f MB high water mark\n",
+	 plan->bytes/1.0e6, actualHWM*1024.0/1.0e6);
+}
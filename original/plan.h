@@ -0,0 +1,58 @@
+#ifndef _PLAN
+#define _PLAN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "medium.h"
+#include "source.h"
+
+
+// Planning mode: the coarsest grid and largest stable dt that resolve the source
+// cutoff frequency FCUT with a target number of points per wavelength, and the
+// predicted memory and propagation time. Throughput comes from Plan.calib (or
+// $FLETCHER_PLAN_CALIB), keyed like History.dat by backend, formulation, kernel
+// variant, threads and host. Planned runs (PLAN ... RUN) record their measured
+// MSamples/s there; other runs only when $FLETCHER_PLAN_CALIB is set.
+
+
+#define PLAN_ARGS 9                   // tokens in planning command, without RUN
+#define PLAN_DEFAULT_MSAMPLES 100.0   // throughput assumed without calibration
+#define PLAN_CALIB_KEYS 64            // calibrations kept in the calibration file
+#define PLAN_KEY 256                  // length of a calibration key
+
+
+typedef struct {
+  int nx, ny, nz;          // grid points
+  int sx, sy, sz;          // grid dimensions with border and absortion
+  int st;                  // time steps
+  float dx, dy, dz, dt;    // grid steps and time step
+  double bytes;            // predicted memory
+  double seconds;          // predicted propagation time
+  double msamples;         // throughput used for the prediction
+  int calibrated;          // throughput read from the calibration file
+} PlanT;
+
+
+// Plan: plan a run of formulation prob over the physical extent (lx,ly,lz) in meters
+
+
+void Plan(enum Form prob, const char *name,
+	  float lx, float ly, float lz, int absorb, int bord,
+	  float ppw, float tmax, float dtOutput, PlanT *plan);
+
+
+// PlanRecord: record the metrics of a finished run, and its throughput in the calibration
+//             file when planning is in use or $FLETCHER_PLAN_CALIB is set
+
+
+void PlanRecord(const char *name, double walltime, double msamples, long hwmKB);
+
+
+// PlanReport: print the plan alongside the metrics recorded by PlanRecord
+
+
+void PlanReport(const PlanT *plan);
+
+#endif
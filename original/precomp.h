@@ -1,70 +1,110 @@
-#ifdef MODEL_GLOBALVARS
-float *ch1dxx=NULL;  // isotropy simetry deep angle
-float *ch1dyy=NULL;  // isotropy simetry deep angle
-float *ch1dzz=NULL;  // isotropy simetry deep angle
-float *ch1dxy=NULL;  // isotropy simetry deep angle
-float *ch1dyz=NULL;  // isotropy simetry deep angle
-float *ch1dxz=NULL;  // isotropy simetry deep angle
-float *v2px=NULL;  // coeficient of H2(p)
-float *v2pz=NULL;  // coeficient of H1(q)
-float *v2sz=NULL;  // coeficient of H1(p-q) and H2(p-q)
-float *v2pn=NULL;  // coeficient of H2(p)
-#endif
+// precomputed coefficients of CoefT (coef.h); MODEL_INITIALIZE needs them declared and
+// allocated, with the grid, the medium and the parts to compute (COEF_*), at the place
+// of inclusion (CoefUpdate)
 
 #ifdef MODEL_INITIALIZE
 // Precalcula campos abaixo
 
 // coeficients of derivatives at H1 operator
 
-ch1dxx = (float *) malloc(sx*sy*sz*sizeof(float));
-ch1dyy = (float *) malloc(sx*sy*sz*sizeof(float));
-ch1dzz = (float *) malloc(sx*sy*sz*sizeof(float));
-ch1dxy = (float *) malloc(sx*sy*sz*sizeof(float));
-ch1dyz = (float *) malloc(sx*sy*sz*sizeof(float));
-ch1dxz = (float *) malloc(sx*sy*sz*sizeof(float));
-for (int i=0; i<sx*sy*sz; i++) {
-  float sinTheta=sin(theta[i]);
-  float cosTheta=cos(theta[i]);
-  float sin2Theta=sin(2.0*theta[i]);
-  float sinPhi=sin(phi[i]);
-  float cosPhi=cos(phi[i]);
-  float sin2Phi=sin(2.0*phi[i]);
-  ch1dxx[i]=sinTheta*sinTheta * cosPhi*cosPhi;
-  ch1dyy[i]=sinTheta*sinTheta * sinPhi*sinPhi;
-  ch1dzz[i]=cosTheta*cosTheta;
-  ch1dxy[i]=sinTheta*sinTheta * sin2Phi;
-  ch1dyz[i]=sin2Theta         * sinPhi;
-  ch1dxz[i]=sin2Theta         * cosPhi;
-}
+if (parts & COEF_ANGLES) {
+  for (int i=0; i<sx*sy*sz; i++) {
+    float sinTheta=sin(theta[i]);
+    float cosTheta=cos(theta[i]);
+    float sin2Theta=sin(2.0*theta[i]);
+    float sinPhi=sin(phi[i]);
+    float cosPhi=cos(phi[i]);
+    float sin2Phi=sin(2.0*phi[i]);
+    ch1dxx[i]=sinTheta*sinTheta * cosPhi*cosPhi;
+    ch1dyy[i]=sinTheta*sinTheta * sinPhi*sinPhi;
+    ch1dzz[i]=cosTheta*cosTheta;
+    ch1dxy[i]=sinTheta*sinTheta * sin2Phi;
+    ch1dyz[i]=sin2Theta         * sinPhi;
+    ch1dxz[i]=sin2Theta         * cosPhi;
+  }
 #ifdef _DUMP
-{
-  const int iPrint=ind(bord+1,bord+1,bord+1);
-  printf("ch1dxx=%f; ch1dyy=%f; ch1dzz=%f; ch1dxy=%f; ch1dxz=%f; ch1dyz=%f\n",
-      ch1dxx[iPrint], ch1dyy[iPrint], ch1dzz[iPrint], ch1dxy[iPrint], ch1dxz[iPrint], ch1dyz[iPrint]);
-}
+  {
+    const int iPrint=ind(bord+1,bord+1,bord+1);
+    printf("ch1dxx=%f; ch1dyy=%f; ch1dzz=%f; ch1dxy=%f; ch1dxz=%f; ch1dyz=%f\n",
+        ch1dxx[iPrint], ch1dyy[iPrint], ch1dzz[iPrint], ch1dxy[iPrint], ch1dxz[iPrint], ch1dyz[iPrint]);
+  }
 #endif
+}
 
 // coeficients of H1 and H2 at PDEs
 
-v2px = (float *) malloc(sx*sy*sz*sizeof(float));
-v2pz = (float *) malloc(sx*sy*sz*sizeof(float));
-v2sz = (float *) malloc(sx*sy*sz*sizeof(float));
-v2pn = (float *) malloc(sx*sy*sz*sizeof(float));
-for (int i=0; i<sx*sy*sz; i++){
-  v2sz[i]=vsv[i]*vsv[i];
-  v2pz[i]=vpz[i]*vpz[i];
-  v2px[i]=v2pz[i]*(1.0+2.0*epsilon[i]);
-  v2pn[i]=v2pz[i]*(1.0+2.0*delta[i]);
-}
+if (parts & COEF_VELOCITIES) {
+  for (int i=0; i<sx*sy*sz; i++){
+    v2sz[i]=vsv[i]*vsv[i];
+    v2pz[i]=vpz[i]*vpz[i];
+    v2px[i]=v2pz[i]*(1.0+2.0*epsilon[i]);
+    v2pn[i]=v2pz[i]*(1.0+2.0*delta[i]);
+  }
 #ifdef _DUMP
-{
-  const int iPrint=ind(bord+1,bord+1,bord+1);
-  printf("vsv=%e; vpz=%e, v2pz=%e\n",
-         vsv[iPrint], vpz[iPrint], v2pz[iPrint]);
-  printf("v2sz=%e; v2pz=%e, v2px=%e, v2pn=%e\n",
-         v2sz[iPrint], v2pz[iPrint], v2px[iPrint], v2pn[iPrint]);
+  {
+    const int iPrint=ind(bord+1,bord+1,bord+1);
+    printf("vsv=%e; vpz=%e, v2pz=%e\n",
+           vsv[iPrint], vpz[iPrint], v2pz[iPrint]);
+    printf("v2sz=%e; v2pz=%e, v2px=%e, v2pn=%e\n",
+           v2sz[iPrint], v2pz[iPrint], v2px[iPrint], v2pn[iPrint]);
+  }
+#endif
+}
+
+#ifdef SPECIALIZE
+// class of each BLOCK_X*BLOCK_Y*BLOCK_Z block of internal points: the cheapest
+// sample variant that is exact at all its points
+
+if (parts & (COEF_ANGLES | COEF_VELOCITIES)) {
+  const int nbx=(sx-2*bord+BLOCK_X-1)/BLOCK_X;
+  const int nby=(sy-2*bord+BLOCK_Y-1)/BLOCK_Y;
+  const int nbz=(sz-2*bord+BLOCK_Z-1)/BLOCK_Z;
+  int nClass[3]={0, 0, 0};
+  long nSamples[3]={0, 0, 0};
+  for (int bz=0; bz<nbz; bz++) {
+    for (int by=0; by<nby; by++) {
+      for (int bx=0; bx<nbx; bx++) {
+	int tilted=0, coupled=0;
+	long points=0;
+	for (int iz=bord+bz*BLOCK_Z; iz<bord+(bz+1)*BLOCK_Z && iz<sz-bord; iz++) {
+	  for (int iy=bord+by*BLOCK_Y; iy<bord+(by+1)*BLOCK_Y && iy<sy-bord; iy++) {
+	    for (int ix=bord+bx*BLOCK_X; ix<bord+(bx+1)*BLOCK_X && ix<sx-bord; ix++) {
+	      const int i=ind(ix,iy,iz);
+	      tilted |= ch1dxx[i]!=0.0f || ch1dyy[i]!=0.0f || ch1dzz[i]!=1.0f ||
+		        ch1dxy[i]!=0.0f || ch1dyz[i]!=0.0f || ch1dxz[i]!=0.0f;
+	      coupled |= v2sz[i]!=0.0f;
+	      points++;
+	    }
+	  }
+	}
+	const int c=tilted ? TILE_TTI : (coupled ? TILE_VTI : TILE_ISO);
+	tileClass[(bz*nby+by)*nbx+bx]=c;
+	nClass[c]++;
+	nSamples[c]+=points;
+      }
+    }
+  }
+  const int nb=nbx*nby*nbz;
+  printf("blocks of %dx%dx%d points: %.1f%% ISO, %.1f%% VTI, %.1f%% TTI\n",
+	 BLOCK_X, BLOCK_Y, BLOCK_Z,
+	 100.0*nClass[TILE_ISO]/nb, 100.0*nClass[TILE_VTI]/nb, 100.0*nClass[TILE_TTI]/nb);
+  MetricsClasses(nSamples);
 }
 #endif
 
+#ifdef NONUNIFORM_Z
+// z derivatives on the stretched z axis: one factor and STENCIL_WIDTH weights per plane
+
+if (parts & COEF_PLANES) {
+  ZGridWeights(zPlane, sz, bord, zd1, zw2);
+#ifdef _DUMP
+  const int izPrint=sz/2;
+  printf("second z derivative weights at the source plane:");
+  for (int k=0; k<STENCIL_WIDTH; k++)
+    printf(" %e", zw2[izPrint*STENCIL_WIDTH+k]);
+  printf("\n");
+#endif
+}
 #endif
 
+#endif
@@ -0,0 +1,179 @@
+#include "roofline.h"
+#include "metrics.h"
+#include "sample.h"
+#include "walltime.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+// run recorded by RooflineRecord
+
+static char runName[16]="";
+static long runSamples=0;
+static double runWalltime=0.0;
+
+
+// Triad: best time of the STREAM triad a=b+s*c
+
+
+static double Triad(float *a, const float *b, const float *c, long n) {
+  double best=1.0e30;
+  for (int r=0; r<ROOF_REPEAT; r++) {
+    const double t0=wtime();
+#pragma omp parallel for
+    for (long i=0; i<n; i++)
+      a[i]=b[i]+3.0f*c[i];
+    const double t=wtime()-t0;
+    if (t < best) best=t;
+  }
+  return best;
+}
+
+
+// Chains: ROOF_FMA_ITERS multiply adds on each of ROOF_CHAINS independent chains;
+//         the chains fill the vector registers and hide the latency of the units
+
+
+static float Chains(float x) {
+  float acc[ROOF_CHAINS];
+  for (int k=0; k<ROOF_CHAINS; k++)
+    acc[k]=x+k;
+  for (long it=0; it<ROOF_FMA_ITERS; it++) {
+#pragma omp simd
+    for (int k=0; k<ROOF_CHAINS; k++)
+      acc[k]=acc[k]*0.999999f+0.000001f;
+  }
+  float sum=0.0f;
+  for (int k=0; k<ROOF_CHAINS; k++)
+    sum+=acc[k];
+  return sum;
+}
+
+
+// RooflineMeasure: measure bandwidth and peak throughput of the host
+
+
+void RooflineMeasure(RoofT *roof) {
+
+#ifdef _OPENMP
+  roof->threads=omp_get_max_threads();
+#else
+  roof->threads=1;
+#endif
+
+  // triad over arrays first touched by the threads that use them
+
+  const long n=ROOF_STREAM_FLOATS;
+  float *a=(float *) malloc(n*sizeof(float));
+  float *b=(float *) malloc(n*sizeof(float));
+  float *c=(float *) malloc(n*sizeof(float));
+  if (a == NULL || b == NULL || c == NULL) {
+    printf("RooflineMeasure: allocation of %ld MB failed\n", (3*n*(long)sizeof(float))>>20);
+    exit(-1);
+  }
+#pragma omp parallel for
+  for (long i=0; i<n; i++) {
+    a[i]=0.0f;
+    b[i]=1.0f;
+    c[i]=2.0f;
+  }
+  const double tTriad=Triad(a, b, c, n);
+  roof->gbytes=1.0e-9*3.0*sizeof(float)*n/tTriad;
+  free(a);
+  free(b);
+  free(c);
+
+  // multiply add chains on every thread; the sum keeps them from being optimized out
+
+  double best=1.0e30;
+  volatile float sink=0.0f;
+  for (int r=0; r<ROOF_REPEAT; r++) {
+    float sum=0.0f;
+    const double t0=wtime();
+#pragma omp parallel reduction(+:sum)
+    sum+=Chains(sink+1.0f);
+    const double t=wtime()-t0;
+    sink+=sum;
+    if (t < best) best=t;
+  }
+  roof->gflops=1.0e-9*2.0*ROOF_CHAINS*ROOF_FMA_ITERS*roof->threads/best;
+
+  printf("Roofline on %d threads: %.2lf GB/s triad bandwidth, %.2lf GFLOP/s fp32 peak, "
+	 "ridge at %.2lf flops/byte\n",
+	 roof->threads, roof->gbytes, roof->gflops, roof->gflops/roof->gbytes);
+}
+
+
+// RooflineRecord: record the propagation of a finished run of formulation name
+
+
+void RooflineRecord(const char *name, long samples, double walltime) {
+  snprintf(runName, sizeof(runName), "%s", name);
+  runSamples=samples;
+  runWalltime=walltime;
+}
+
+
+// Roof: attainable GFLOP/s at intensity flops/byte
+
+
+static double Roof(const RoofT *roof, double intensity) {
+  return fmin(roof->gflops, intensity*roof->gbytes);
+}
+
+
+// RooflineReport: roof of each kernel variant, and of the run recorded by RooflineRecord
+//                 if any; printed and written to ROOF_FILE
+
+
+void RooflineReport(const RoofT *roof) {
+  static const char *className[3]={"ISO", "VTI", "TTI"};
+
+  FILE *fp=fopen(ROOF_FILE, "w");
+  if (fp == NULL) {
+    printf("RooflineReport: cannot write %s\n", ROOF_FILE);
+    return;
+  }
+
+  // roof, in powers of two of the intensity around the ridge
+
+  fprintf(fp, "# roof: %.3lf GB/s, %.3lf GFLOP/s, %d threads\n", roof->gbytes, roof->gflops, roof->threads);
+  fprintf(fp, "# intensity(flops/byte) gflops\n");
+  for (double x=1.0/64.0; x<=1024.0; x*=2.0)
+    fprintf(fp, "%lf %lf\n", x, Roof(roof, x));
+
+  // kernel variants and the run
+
+  fprintf(fp, "\n\n# variant intensity(flops/byte) roof_gflops roof_msamples achieved_gflops percent_of_roof\n");
+  printf("Roofline:  variant  flops/sample  bytes/sample  intensity  roof GFLOP/s  roof MSamples/s  achieved  %% of roof\n");
+  for (int k=0; k<=3; k++) {
+    double flops, bytes;
+    const char *variant;
+    double achieved=-1.0;
+    if (k < 3) {
+      MetricsClassCounts(k, &flops, &bytes);
+      variant=className[k];
+    } else {
+      if (runSamples == 0 || !(runWalltime > 0.0))
+	break;
+      variant=MetricsKernel(runName, &flops, &bytes);
+      achieved=1.0e-9*flops*runSamples/runWalltime;
+    }
+    const double intensity=flops/bytes;
+    const double gflops=Roof(roof, intensity);
+    const double msamples=1.0e3*gflops/flops;
+    if (achieved < 0.0) {
+      printf("Roofline: %8s  %12.0lf  %12.0lf  %9.2lf  %12.2lf  %15.1lf\n",
+	     variant, flops, bytes, intensity, gflops, msamples);
+      fprintf(fp, "%s %lf %lf %lf - -\n", variant, intensity, gflops, msamples);
+    } else {
+      char label[40];
+      snprintf(label, sizeof(label), "%s(%s)", runName, variant);
+      printf("Roofline: %8s  %12.0lf  %12.0lf  %9.2lf  %12.2lf  %15.1lf  %8.2lf  %8.1lf%%\n",
+	     label, flops, bytes, intensity, gflops, msamples, achieved, 100.0*achieved/gflops);
+      fprintf(fp, "run_%s %lf %lf %lf %lf %lf\n", runName, intensity, gflops, msamples, achieved, 100.0*achieved/gflops);
+    }
+  }
+  fclose(fp);
+}
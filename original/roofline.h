@@ -0,0 +1,50 @@
+#ifndef _ROOFLINE
+#define _ROOFLINE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+
+// Roofline of the host: sustainable memory bandwidth of a STREAM triad and peak fp32
+// multiply add throughput of this build, on all threads. With the bytes and flops per
+// sample of each kernel variant (metrics.h) it bounds the propagate throughput by
+// min(peak, intensity*bandwidth). Measured by the ROOFLINE mode, or before a run when
+// $FLETCHER_ROOFLINE is set, to compare the run with its roof. The plot-ready table
+// goes to Roofline.dat: the roof, then the kernel variants, as gnuplot data blocks.
+
+
+#define ROOF_STREAM_FLOATS (1L<<24)   // floats per triad array, far beyond last level caches
+#define ROOF_CHAINS 64                // independent multiply add chains per thread
+#define ROOF_FMA_ITERS (1L<<20)       // multiply adds of each chain
+#define ROOF_REPEAT 5                 // best of repetitions
+#define ROOF_FILE "Roofline.dat"
+
+
+typedef struct {
+  double gbytes;     // sustainable memory bandwidth (GB/s)
+  double gflops;     // peak fp32 throughput (GFLOP/s)
+  int threads;
+} RoofT;
+
+
+// RooflineMeasure: measure bandwidth and peak throughput of the host
+
+
+void RooflineMeasure(RoofT *roof);
+
+
+// RooflineRecord: record the propagation of a finished run of formulation name
+
+
+void RooflineRecord(const char *name, long samples, double walltime);
+
+
+// RooflineReport: roof of each kernel variant, and of the run recorded by RooflineRecord
+//                 if any; printed and written to ROOF_FILE
+
+
+void RooflineReport(const RoofT *roof);
+
+#endif
@@ -0,0 +1,13 @@
+#!/bin/bash
+
+# Compares row-major and bricked layouts of the OpenMP backend.
+# Enable the TLB/LLC counter set in ModPAPI.h before running;
+# Report_<layout>.csv keeps walltime, MSamples and the counters of each layout.
+
+for layout in rowmajor brick; do
+  if [[ $layout == brick ]]; then flags="BRICK=1"; else flags=""; fi
+  (cd .. && make clean-all && make backend=OpenMP PAPI=1 $flags) || exit 1
+  echo "running ../ModelagemFletcher.exe TTI 248 248 248 16 12.5 12.5 12.5 0.001 0.1 ($layout)"
+  ../ModelagemFletcher.exe TTI 248 248 248 16 12.5 12.5 12.5 0.001 0.1 | tee log_$layout.txt
+  cp Report.csv Report_$layout.csv
+done
@@ -0,0 +1,20 @@
+#!/bin/bash
+
+# Compares OpenMP and WorkStealing backends with background noise:
+# NOISE busy loops (default: half of the cores) compete with the propagation.
+# Work stealing load imbalance is printed at the end of its log.
+
+NOISE=${NOISE:-$(( $(nproc) / 2 ))}
+
+for backend in OpenMP WorkStealing; do
+  (cd .. && make clean-all && make backend=$backend) || exit 1
+  pids=""
+  for ((n=0; n<NOISE; n++)); do
+    ( while :; do :; done ) &
+    pids="$pids $!"
+  done
+  echo "running ../ModelagemFletcher.exe TTI 248 248 248 16 12.5 12.5 12.5 0.001 0.1 ($backend, $NOISE noise loops)"
+  ../ModelagemFletcher.exe TTI 248 248 248 16 12.5 12.5 12.5 0.001 0.1 | tee log_noise_$backend.txt
+  [[ -n "$pids" ]] && kill $pids
+done
+grep -H "MSamples/s" log_noise_*.txt
@@ -0,0 +1,36 @@
+#!/bin/bash
+
+# Runs two jobs, with sources in different z slabs, on one resident model of BACKEND
+# (default Pthreads) and compares each output with a standalone run of the same job
+# (a one run sweep in a process of its own). The jobs share the context, reset
+# between them. THREADS (default 4) threads; runs in server_<backend>/; build
+# ../../compare first.
+
+set -o pipefail
+BACKEND=${1:-Pthreads}
+export OMP_NUM_THREADS=${THREADS:-4}  # several slabs, whatever env.sh set
+model="TTI 24 24 24 12 12.5 12.5 12.5 0.001 0.05"
+jobs=("centre -1 -1 -1 0:0:0" "low 28 28 12 0:0:-16")   # name ix iy iz, source offset
+
+(cd .. && make clean-all && make backend=$BACKEND && make client.exe) || exit 1
+rm -rf server_$BACKEND && mkdir server_$BACKEND && cd server_$BACKEND || exit 1
+
+echo "running ../../ModelagemFletcher.exe SERVE fletcher.sock $model ($BACKEND, $OMP_NUM_THREADS threads)"
+timeout 120 ../../ModelagemFletcher.exe SERVE fletcher.sock $model > log_server.txt &
+server=$!
+for k in $(seq 50); do [[ -S fletcher.sock ]] && break; sleep 0.1; done
+for job in "${jobs[@]}"; do
+  set -- $job
+  timeout 60 ../../client.exe fletcher.sock submit $1 $2 $3 $4 0 || { kill $server; exit 1; }
+done
+../../client.exe fletcher.sock shutdown
+wait $server || { echo "server failed"; exit 1; }
+
+status=0
+for job in "${jobs[@]}"; do
+  set -- $job
+  echo "$model source=$5" > $1_alone.txt
+  timeout 60 ../../ModelagemFletcher.exe SWEEP $1_alone.txt > log_$1_alone.txt || { echo "standalone $1 failed"; exit 1; }
+  ../../../compare/compare.exe -d diff_$1.rsf $1_alone_0.rsf $1.rsf | tail -1 || status=1
+done
+exit $status
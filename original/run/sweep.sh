@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# Runs a sweep on BACKEND (default Pthreads) and on OpenMP and compares every run.
+# The context is reused across the runs: the source moves to another z slab on the
+# same grid, then the grid shrinks to one that holds a single slab.
+# THREADS (default 4) workers; each backend runs in sweep_<backend>/; build
+# ../../compare first.
+
+set -o pipefail
+BACKEND=${1:-Pthreads}
+export OMP_NUM_THREADS=${THREADS:-4}  # several slabs, whatever env.sh set
+
+for backend in OpenMP $BACKEND; do
+  (cd .. && make clean-all && make backend=$backend) || exit 1
+  rm -rf sweep_$backend && mkdir sweep_$backend && cd sweep_$backend || exit 1
+  cat > sweep.txt <<END
+TTI 24 24 24 12 12.5 12.5 12.5 0.001 0.05 source=0:0:0,0:0:-16,0:0:0
+TTI 8 8 4 0 12.5 12.5 12.5 0.001 0.05 source=0:0:0,0:0:1
+END
+  echo "running ../../ModelagemFletcher.exe SWEEP sweep.txt ($backend, $OMP_NUM_THREADS threads)"
+  timeout 60 ../../ModelagemFletcher.exe SWEEP sweep.txt > log.txt || { echo "sweep failed ($backend)"; exit 1; }
+  grep "^Sweep sweep.txt" log.txt
+  cd ..
+done
+
+status=0
+for header in sweep_OpenMP/sweep_*.rsf; do
+  run=$(basename $header)
+  ../../compare/compare.exe -d sweep_$BACKEND/diff_$run $header sweep_$BACKEND/$run | tail -1 || status=1
+done
+exit $status
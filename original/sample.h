@@ -1,22 +1,54 @@
+#ifndef _SAMPLE_CLASSES
+#define _SAMPLE_CLASSES
+
+#include "coef.h"
+
+// tile classes (make SPECIALIZE=1): cheapest sample variant that is exact in a tile
+//   TILE_ISO: untilted symmetry axis and v2sz==0; needs pxx, pyy and qzz only
+//   TILE_VTI: untilted symmetry axis; needs no cross derivative
+//   TILE_TTI: full sample
+
+#define TILE_ISO 0
+#define TILE_VTI 1
+#define TILE_TTI 2
+#endif
+
 #ifdef SAMPLE_PRE_LOOP
 // START SAMPLE_PRE_LOOP
 
+// coefficients of the model, from the CoefT *coef at the place of inclusion;
+// CUDA kernels get them as arguments
+
 #ifndef __NVCC__
-extern float* ch1dxx;
-extern float* ch1dyy;
-extern float* ch1dzz;
-extern float* ch1dxy;
-extern float* ch1dyz;
-extern float* ch1dxz;
-extern float* v2px;
-extern float* v2pz;
-extern float* v2sz;
-extern float* v2pn;
+const float * restrict ch1dxx=coef->ch1dxx;
+const float * restrict ch1dyy=coef->ch1dyy;
+const float * restrict ch1dzz=coef->ch1dzz;
+const float * restrict ch1dxy=coef->ch1dxy;
+const float * restrict ch1dyz=coef->ch1dyz;
+const float * restrict ch1dxz=coef->ch1dxz;
+const float * restrict v2px=coef->v2px;
+const float * restrict v2pz=coef->v2pz;
+const float * restrict v2sz=coef->v2sz;
+const float * restrict v2pn=coef->v2pn;
+#ifdef SPECIALIZE
+const unsigned char * restrict tileClass=coef->tileClass;
+#endif
+#ifdef NONUNIFORM_Z
+const float * restrict zd1=coef->zd1;
+const float * restrict zw2=coef->zw2;
+#endif
 #endif
 
+#ifdef SAMPLE_TILE
+// stencils read the row-major tile gathered by the kernel (tpc, tqc)
+const int strideX=tind(1,0,0)-tind(0,0,0);
+const int strideY=tind(0,1,0)-tind(0,0,0);
+const int strideZ=tind(0,0,1)-tind(0,0,0);
+#else
 const int strideX=ind(1,0,0)-ind(0,0,0);
 const int strideY=ind(0,1,0)-ind(0,0,0);
 const int strideZ=ind(0,0,1)-ind(0,0,0);
+#endif
 
 const float dxxinv=1.0f/(dx*dx);
 const float dyyinv=1.0f/(dy*dy);
@@ -25,6 +57,21 @@ const float dxyinv=1.0f/(dx*dy);
 const float dxzinv=1.0f/(dx*dz);
 const float dyzinv=1.0f/(dy*dz);
 
+// z derivatives: on a stretched z axis, the second ones with the weights of plane iz and
+// the cross ones mapped to the plane index, uniform, by the factor of plane iz (precomp.h)
+
+#ifdef NONUNIFORM_Z
+const float dxinv=1.0f/dx;
+const float dyinv=1.0f/dy;
+#define DerZZ(p) Der2Z(p, is, strideZ, zw2+iz*STENCIL_WIDTH+STENCIL_RADIUS)
+#define DerXZ(p) DerCross(p, is, strideX, strideZ, dxinv*zd1[iz])
+#define DerYZ(p) DerCross(p, is, strideY, strideZ, dyinv*zd1[iz])
+#else
+#define DerZZ(p) Der2(p, is, strideZ, dzzinv)
+#define DerXZ(p) DerCross(p, is, strideX, strideZ, dxzinv)
+#define DerYZ(p) DerCross(p, is, strideY, strideZ, dyzinv)
+#endif
+
 // END SAMPLE_PRE_LOOP
 #endif
 
@@ -34,14 +81,66 @@ const float dyzinv=1.0f/(dy*dz);
 
 const int i=ind(ix,iy,iz);
 
+// stencil input: the wave fields themselves or the kernel tile holding (ix,iy,iz)
+
+#ifdef SAMPLE_TILE
+const int is=tind(ix-txStart,iy-tyStart,iz-tzStart);
+const float * restrict sp=tpc;
+const float * restrict sq=tqc;
+#elif defined(SAMPLE_TIME4)
+// second pass of the 4th order time step: stencils read the rhs of the first pass
+const int is=i;
+const float * restrict sp=rp;
+const float * restrict sq=rq;
+#else
+const int is=i;
+const float * restrict sp=pc;
+const float * restrict sq=qc;
+#endif
+
+#if defined(SAMPLE_ISO)
+
+// untilted symmetry axis: H1 is the z derivative and H2 the x and y ones; v2sz is null
+
+const float pxx= Der2(sp, is, strideX, dxxinv);
+const float pyy= Der2(sp, is, strideY, dyyinv);
+const float qzz= DerZZ(sq);
+
+const float h2p=pxx+pyy;
+const float h1q=qzz;
+
+const float rhsp=v2px[i]*h2p + v2pz[i]*h1q;
+const float rhsq=v2pn[i]*h2p + v2pz[i]*h1q;
+
+#elif defined(SAMPLE_VTI)
+
+// untilted symmetry axis: H1 is the z derivative and H2 the x and y ones
+
+const float pxx= Der2(sp, is, strideX, dxxinv);
+const float pyy= Der2(sp, is, strideY, dyyinv);
+const float pzz= DerZZ(sp);
+const float qxx= Der2(sq, is, strideX, dxxinv);
+const float qyy= Der2(sq, is, strideY, dyyinv);
+const float qzz= DerZZ(sq);
+
+const float h1p=pzz;
+const float h2p=pxx+pyy;
+const float h1q=qzz;
+const float h2q=qxx+qyy;
+
+const float rhsp=v2px[i]*h2p + v2pz[i]*h1q + v2sz[i]*(h1p-h1q);
+const float rhsq=v2pn[i]*h2p + v2pz[i]*h1q - v2sz[i]*(h2p-h2q);
+
+#else
+
 // p derivatives, H1(p) and H2(p)
 
-const float pxx= Der2(pc, i, strideX, dxxinv);
-const float pyy= Der2(pc, i, strideY, dyyinv);
-const float pzz= Der2(pc, i, strideZ, dzzinv);
-const float pxy= DerCross(pc, i, strideX, strideY, dxyinv);
-const float pyz= DerCross(pc, i, strideY, strideZ, dyzinv);
-const float pxz= DerCross(pc, i, strideX, strideZ, dxzinv);
+const float pxx= Der2(sp, is, strideX, dxxinv);
+const float pyy= Der2(sp, is, strideY, dyyinv);
+const float pzz= DerZZ(sp);
+const float pxy= DerCross(sp, is, strideX, strideY, dxyinv);
+const float pyz= DerYZ(sp);
+const float pxz= DerXZ(sp);
 
 const float cpxx=ch1dxx[i]*pxx;
 const float cpyy=ch1dyy[i]*pyy;
@@ -54,12 +153,12 @@ const float h2p=pxx+pyy+pzz-h1p;
 
 // q derivatives, H1(q) and H2(q)
 
-const float qxx= Der2(qc, i, strideX, dxxinv);
-const float qyy= Der2(qc, i, strideY, dyyinv);
-const float qzz= Der2(qc, i, strideZ, dzzinv);
-const float qxy= DerCross(qc, i, strideX,  strideY, dxyinv);
-const float qyz= DerCross(qc, i, strideY,  strideZ, dyzinv);
-const float qxz= DerCross(qc, i, strideX,  strideZ, dxzinv);
+const float qxx= Der2(sq, is, strideX, dxxinv);
+const float qyy= Der2(sq, is, strideY, dyyinv);
+const float qzz= DerZZ(sq);
+const float qxy= DerCross(sq, is, strideX,  strideY, dxyinv);
+const float qyz= DerYZ(sq);
+const float qxz= DerXZ(sq);
 
 const float cqxx=ch1dxx[i]*qxx;
 const float cqyy=ch1dyy[i]*qyy;
@@ -80,10 +179,38 @@ const float h2pmq=h2p-h2q;
 const float rhsp=v2px[i]*h2p + v2pz[i]*h1q + v2sz[i]*h1pmq;
 const float rhsq=v2pn[i]*h2p + v2pz[i]*h1q - v2sz[i]*h2pmq;
 
+#endif
+
 // new p and q
 
-pp[i]=2.0f*pc[i] - pp[i] + rhsp*dt*dt;
-qp[i]=2.0f*qc[i] - qp[i] + rhsq*dt*dt;
+#if defined(SAMPLE_RHS)
+// first pass of the 4th order time step (see OpenMP/openmp_time4.c): rhs only
+rp[i]=rhsp;
+rq[i]=rhsq;
+#elif defined(SAMPLE_TIME4)
+// modified equation: the dt^4/12 term is the operator applied to the rhs of the first pass
+pp[i]=2.0f*pc[i] - pp[i] + (rp[i] + rhsp*dt*dt*(1.0f/12.0f))*dt*dt;
+qp[i]=2.0f*qc[i] - qp[i] + (rq[i] + rhsq*dt*dt*(1.0f/12.0f))*dt*dt;
+#elif defined(SAMPLE_HALF)
+// half precision storage: pp and qp are decoded with their old scale and encoded
+// with the scale of the new step (see OpenMP/openmp_half.c)
+const float ppNew=2.0f*sp[is] - HalfToFloat(pp[i])*ppOldScale + rhsp*dt*dt;
+const float qpNew=2.0f*sq[is] - HalfToFloat(qp[i])*qpOldScale + rhsq*dt*dt;
+pp[i]=FloatToHalf(ppNew*ppNewInv);
+qp[i]=FloatToHalf(qpNew*qpNewInv);
+ppMax=fmaxf(ppMax, fabsf(ppNew));
+qpMax=fmaxf(qpMax, fabsf(qpNew));
+#else
+pp[i]=2.0f*sp[is] - pp[i] + rhsp*dt*dt;
+qp[i]=2.0f*sq[is] - qp[i] + rhsq*dt*dt;
+#endif
+
+#if defined(SAMPLE_DIAG) && !defined(SAMPLE_RHS)
+// fused diagnostics of the new fields, reduced per thread (see OpenMP/openmp_diag.c)
+diagEnergy+=pp[i]*pp[i] + qp[i]*qp[i];
+diagMax=fmaxf(diagMax, fabsf(pp[i]));
+diagNonFinite+=!isfinite(pp[i]) + !isfinite(qp[i]);
+#endif
 
 // END ONE SAMPLE
 #endif
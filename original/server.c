@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "libfletcher.h"
+#include "source.h"
+#include "utils.h"
+#include "zgrid.h"
+#include "walltime.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define SERVER_NAME 100          // length of a job name
+
+
+typedef struct JobS {
+  int id;
+  int fd;                    // connection of the client, answered when the job ends
+  int ix, iy, iz;
+  float tmax, dtOutput;
+  char name[SERVER_NAME];
+  double tQueued;
+  struct JobS *next;
+} JobT;
+
+
+typedef struct {
+  const ServerModelT *model;
+  FletcherT *ctx;
+  pthread_t thread;
+} WorkerT;
+
+
+// queue of jobs and counters, shared by the accepting thread and the workers
+
+static pthread_mutex_t lock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queued=PTHREAD_COND_INITIALIZER;
+static JobT *head=NULL, *tail=NULL;
+static int nQueued=0, nRunning=0, nDone=0, nFailed=0, stop=0;
+static double waitSum=0.0, waitMax=0.0, runSum=0.0, runMax=0.0;
+
+
+// Reply: send one line to the client; a client that went away is not an error
+
+
+static void Reply(int fd, const char *format, ...) {
+  char line[SERVER_LINE];
+  va_list ap;
+  va_start(ap, format);
+  int n=vsnprintf(line, SERVER_LINE, format, ap);
+  va_end(ap);
+  if (n >= SERVER_LINE)
+    n=SERVER_LINE-1;
+  for (int k=0, w; k < n; k+=w)
+    if ((w=send(fd, line+k, n-k, MSG_NOSIGNAL)) <= 0)
+      return;
+}
+
+
+// ReadLine: request line of a connection, without the newline; 0 if there is none, or
+//           if it does not arrive whole within SERVER_TIMEOUT seconds, so that no client
+//           holds the accepting thread
+
+
+static int ReadLine(int fd, char *line) {
+  const double deadline=wtime()+SERVER_TIMEOUT;
+  struct pollfd pfd={fd, POLLIN, 0};
+  int n=0;
+  while (n < SERVER_LINE-1) {
+    const int wait=(int)(1.0e3*(deadline-wtime()));
+    if (wait <= 0 || poll(&pfd, 1, wait) <= 0) {
+      n=0;
+      break;
+    }
+    const ssize_t r=read(fd, line+n, 1);
+    if (r <= 0 || line[n] == '\n')
+      break;
+    n++;
+  }
+  line[n]='\0';
+  return n > 0;
+}
+
+
+// ValidName: job names are plain file names in the working directory
+
+
+static int ValidName(const char *name) {
+  if (name[0] == '\0' || name[0] == '.' || strlen(name) >= SERVER_NAME)
+    return 0;
+  for (const char *c=name; *c != '\0'; c++)
+    if (!(isalnum((unsigned char)*c) || *c == '_' || *c == '-' || *c == '.'))
+      return 0;
+  return 1;
+}
+
+
+// Execute: propagate job on the context of worker; returns 0 and the reason on failure
+
+
+static int Execute(WorkerT *w, JobT *job, char *path, int *steps, double *setup, char *reason) {
+  const ServerModelT *m=w->model;
+  const int sx=m->sx, sy=m->sy, sz=m->sz, bord=m->bord;
+  if (job->ix < bord || job->ix >= sx-bord ||
+      job->iy < bord || job->iy >= sy-bord ||
+      job->iz < bord || job->iz >= sz-bord) {
+    sprintf(reason, "source (%d,%d,%d) outside the grid", job->ix, job->iy, job->iz);
+    return 0;
+  }
+  SlicePtr sPtr=OpenSliceFile(0, sx-1, 0, sy-1, 0, m->izEnd, m->dx, m->dy, m->dzOut, m->dt, job->name);
+  if (sPtr->fpHead == NULL || sPtr->fpBinary == NULL) {
+    sprintf(reason, "cannot create %s.rsf: %s", job->name, strerror(errno));
+    if (sPtr->fpHead != NULL)
+      fclose(sPtr->fpHead);
+    if (sPtr->fpBinary != NULL)
+      fclose(sPtr->fpBinary);
+    free(sPtr);
+    return 0;
+  }
+
+  FletcherReset(w->ctx);
+  double precompute;
+  FletcherTimes(w->ctx, &precompute, setup);
+  const int iSource=FletcherIndex(w->ctx, job->ix, job->iy, job->iz);
+
+  // the time loop of Model, without its measurements
+
+#ifdef NONUNIFORM_Z
+  ZGridDump(sx, sy, sz, m->zPlane, FletcherSnapshot(w->ctx), sPtr);
+#else
+  DumpSliceFile(sx, sy, sz, FletcherSnapshot(w->ctx), sPtr);
+#endif
+  *steps=ceil(job->tmax/m->dt);
+  int nOut=1;
+  float tOut=nOut*job->dtOutput;
+  for (int it=1; it<=*steps; it++) {
+    FletcherInject(w->ctx, iSource, Source(m->dt, it-1));
+    if (FletcherStep(w->ctx, 1) < 1) {
+      sprintf(reason, "wave fields diverged at time step %d", it);
+      CloseSliceFile(sPtr);
+      free(sPtr);
+      return 0;
+    }
+    if (it*m->dt >= tOut-0.5f*m->dt) {
+#ifdef NONUNIFORM_Z
+      ZGridDump(sx, sy, sz, m->zPlane, FletcherSnapshot(w->ctx), sPtr);
+#else
+      DumpSliceFile_Nofor(sx, sy, sz, FletcherSnapshot(w->ctx), sPtr);
+#endif
+      tOut=(++nOut)*job->dtOutput;
+    }
+  }
+  CloseSliceFile(sPtr);
+  free(sPtr);
+
+  char header[SERVER_NAME+8];
+  sprintf(header, "%s.rsf", job->name);
+  if (realpath(header, path) == NULL)
+    strcpy(path, header);
+  return 1;
+}
+
+
+// Work: thread of a worker; runs queued jobs until the queue is empty after stop
+
+
+static void *Work(void *a) {
+  WorkerT *w=(WorkerT *) a;
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    while (head == NULL && !stop)
+      pthread_cond_wait(&queued, &lock);
+    JobT *job=head;
+    if (job == NULL) {
+      pthread_mutex_unlock(&lock);
+      break;
+    }
+    head=job->next;
+    if (head == NULL)
+      tail=NULL;
+    nQueued--;
+    nRunning++;
+    pthread_mutex_unlock(&lock);
+
+    const double tStart=wtime();
+    char path[PATH_MAX], reason[SERVER_LINE/2];
+    int steps=0;
+    double setup=0.0;
+    const int ok=Execute(w, job, path, &steps, &setup, reason);
+    const double tEnd=wtime();
+    const double wait=tStart-job->tQueued, run=tEnd-tStart;
+
+    pthread_mutex_lock(&lock);
+    nRunning--;
+    if (ok) {
+      nDone++;
+      waitSum+=wait;
+      waitMax=fmax(waitMax, wait);
+      runSum+=run;
+      runMax=fmax(runMax, run);
+    } else
+      nFailed++;
+    pthread_mutex_unlock(&lock);
+
+    const ServerModelT *m=w->model;
+    if (ok) {
+      const double samples=(double)(m->sx-2*m->bord)*(m->sy-2*m->bord)*(m->sz-2*m->bord)*steps;
+      Reply(job->fd, "DONE %d %s %d %.6lf %.6lf %.6lf %.2lf\n",
+	    job->id, path, steps, wait, setup, run, 1.0e-6*samples/run);
+      printf("Job %d: source (%d,%d,%d), %d steps to %s; wait %.3lf s, run %.3lf s\n",
+	     job->id, job->ix, job->iy, job->iz, steps, path, wait, run);
+    } else {
+      Reply(job->fd, "FAILED %d %s\n", job->id, reason);
+      printf("Job %d failed: %s\n", job->id, reason);
+    }
+    fflush(stdout);
+    close(job->fd);
+    free(job);
+  }
+  return NULL;
+}
+
+
+// Listen: socket bound to socketName; a socket file without a server is replaced
+
+
+static int Listen(const char *socketName) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family=AF_UNIX;
+  if (strlen(socketName) >= sizeof(addr.sun_path)) {
+    printf("ServerRun: socket name %s is too long\n", socketName);
+    return -1;
+  }
+  strcpy(addr.sun_path, socketName);
+
+  const int fd=socket(AF_UNIX, SOCK_STREAM, 0);
+  if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+    printf("ServerRun: a server already listens on %s\n", socketName);
+    close(fd);
+    return -1;
+  }
+  unlink(socketName);
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+    printf("ServerRun: cannot listen on %s: %s\n", socketName, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+
+// ServerRun: serve jobs on socketName until SHUTDOWN; returns the number of failed jobs
+
+
+int ServerRun(const char *socketName, const ServerModelT *model) {
+  const int listener=Listen(socketName);
+  if (listener < 0)
+    return 1;
+
+  // resident contexts; backends that allow one context get one worker
+
+  const char *env=getenv("FLETCHER_SERVE_WORKERS");
+  int nWorkers=(env != NULL && atoi(env) > 0) ? atoi(env) : 1;
+#ifdef _OPENMP
+  const int threads=(omp_get_max_threads() >= nWorkers) ? omp_get_max_threads()/nWorkers : 1;
+#else
+  const int threads=0;
+#endif
+  const FletcherGridT grid={model->sx, model->sy, model->sz, model->bord,
+			    model->dx, model->dy, model->dz, model->dt, threads, 0};
+  WorkerT *worker=(WorkerT *) calloc(nWorkers, sizeof(WorkerT));
+  const double t0=wtime();
+  int n=0;
+  for (; n<nWorkers; n++) {
+    worker[n].model=model;
+    worker[n].ctx=FletcherInit(&grid, model->vpz, model->vsv, model->epsilon, model->delta,
+			       model->phi, model->theta, model->zPlane);
+    if (worker[n].ctx == NULL)
+      break;
+  }
+  if (n < nWorkers)
+    printf("ServerRun: %d of %d workers\n", n, nWorkers);
+  nWorkers=n;
+  if (nWorkers == 0) {
+    close(listener);
+    unlink(socketName);
+    free(worker);
+    return 1;
+  }
+  printf("Serving on %s: %d resident models of %dx%dx%d set up in %.3lf s\n",
+	 socketName, nWorkers, model->sx, model->sy, model->sz, wtime()-t0);
+  fflush(stdout);
+  for (int k=0; k<nWorkers; k++)
+    pthread_create(&worker[k].thread, NULL, Work, &worker[k]);
+
+  // one request per connection, until SHUTDOWN
+
+  int id=0;
+  for (;;) {
+    const int fd=accept(listener, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR)
+	continue;
+      break;
+    }
+    char line[SERVER_LINE], command[16];
+    if (!ReadLine(fd, line) || sscanf(line, "%15s", command) != 1) {
+      close(fd);
+      continue;
+    }
+    if (strcmp(command, "RUN") == 0) {
+      JobT *job=(JobT *) calloc(1, sizeof(JobT));
+      job->dtOutput=model->dtOutput;
+      char name[SERVER_LINE];
+      const int fields=sscanf(line, "%*s %d %d %d %f %511s %f",
+			      &job->ix, &job->iy, &job->iz, &job->tmax, name, &job->dtOutput);
+      if (fields < 5 || !ValidName(name) || !(job->dtOutput > 0.0f)) {
+	Reply(fd, "FAILED -1 malformed request: %s\n", line);
+	close(fd);
+	free(job);
+	continue;
+      }
+      strcpy(job->name, name);
+      if (job->ix < 0) job->ix=model->sx/2;
+      if (job->iy < 0) job->iy=model->sy/2;
+      if (job->iz < 0) job->iz=model->sz/2;
+      if (job->tmax <= 0.0f)
+	job->tmax=model->tmax;
+      job->fd=fd;
+      job->id=id++;
+      job->tQueued=wtime();
+
+      pthread_mutex_lock(&lock);
+      const int ahead=nQueued+nRunning;
+      if (tail == NULL)
+	head=job;
+      else
+	tail->next=job;
+      tail=job;
+      nQueued++;
+      Reply(fd, "QUEUED %d %d\n", job->id, ahead);
+      pthread_cond_signal(&queued);
+      pthread_mutex_unlock(&lock);
+    } else if (strcmp(command, "STATS") == 0) {
+      pthread_mutex_lock(&lock);
+      Reply(fd, "STATS %d %d %d %d %d %.6lf %.6lf\n", nWorkers, nQueued, nRunning, nDone, nFailed,
+	    (nDone > 0) ? waitSum/nDone : 0.0, (nDone > 0) ? runSum/nDone : 0.0);
+      pthread_mutex_unlock(&lock);
+      close(fd);
+    } else if (strcmp(command, "SHUTDOWN") == 0) {
+      pthread_mutex_lock(&lock);
+      stop=1;
+      pthread_cond_broadcast(&queued);
+      pthread_mutex_unlock(&lock);
+      for (int k=0; k<nWorkers; k++)
+	pthread_join(worker[k].thread, NULL);
+      Reply(fd, "BYE %d %d\n", nDone, nFailed);
+      close(fd);
+      break;
+    } else {
+      Reply(fd, "FAILED -1 unknown request: %s\n", line);
+      close(fd);
+    }
+  }
+  close(listener);
+  unlink(socketName);
+
+  for (int k=0; k<nWorkers; k++)
+    FletcherFree(worker[k].ctx);
+  free(worker);
+  if (nDone > 0)
+    printf("Server: %d jobs done, %d failed; wait mean %.3lf max %.3lf s; run mean %.3lf max %.3lf s\n",
+	   nDone, nFailed, waitSum/nDone, waitMax, runSum/nDone, runMax);
+  else
+    printf("Server: no jobs done, %d failed\n", nFailed);
+  return nFailed;
+}
@@ -0,0 +1,47 @@
+#ifndef _SERVER
+#define _SERVER
+
+
+// Server mode: SERVE socket <arguments of a run> sets the model up once, keeps it
+// resident in $FLETCHER_SERVE_WORKERS contexts (default 1; the OpenMP threads are split
+// among them) and runs the propagation jobs submitted to the UNIX domain socket, in
+// order of arrival, on the first free context. Each job propagates the source at its
+// own grid point to its own final time, writing its outputs to its own RSF file in the
+// working directory of the server. client.exe submits jobs and reports their latency.
+//
+// Requests are one text line per connection, sent within SERVER_TIMEOUT seconds:
+//   RUN ix iy iz tmax name [dtOutput]  ix, iy, iz grid indices (-1 for the centre);
+//                                      tmax<=0 for the tmax of the server
+//     replies QUEUED id ahead          when queued behind ahead jobs, then
+//             DONE id path steps wait setup run msamples   (seconds, MSamples/s)
+//          or FAILED id reason
+//   STATS  replies STATS workers queued running done failed wait run  (mean seconds)
+//   SHUTDOWN  runs the queued jobs, then replies BYE done failed and exits
+
+
+#define SERVER_LINE 512          // length of a request or reply
+#define SERVER_BACKLOG 64        // connections waiting to be accepted
+#define SERVER_TIMEOUT 2.0       // seconds a connection has to send its request
+
+
+// ServerModelT: the resident model and its uniform output axis
+
+
+typedef struct {
+  int sx, sy, sz, bord;
+  float dx, dy, dz, dt;
+  float tmax;                // final time of jobs that give none
+  float dtOutput;            // time between outputs of jobs that give none
+  int izEnd;                 // last plane of the output z axis
+  float dzOut;               // spacing of the output z axis
+  float *vpz, *vsv, *epsilon, *delta, *phi, *theta;
+  const float *zPlane;
+} ServerModelT;
+
+
+// ServerRun: serve jobs on socketName until SHUTDOWN; returns the number of failed jobs
+
+
+int ServerRun(const char *socketName, const ServerModelT *model);
+
+#endif
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "sweep.h"
+#include "fletcher.h"
+#include "medium.h"
+#include "boundary.h"
+#include "zgrid.h"
+#include "map.h"
+#include "utils.h"
+#include "model.h"
+#include "metrics.h"
+#include "walltime.h"
+#include "libfletcher.h"
+#include "coef.h"
+
+#define SWEEP_FIELDS 12          // form nx ny nz absorb dx dy dz dt tmax sigma source
+#define SWEEP_NAME 256
+
+
+typedef struct {
+  char form[16];
+  enum Form prob;
+  int nx, ny, nz, absorb;
+  float dx, dy, dz, dt, tmax;
+  double sigma;
+  int ox, oy, oz;            // source offset from the centre of the grid
+} RunT;
+
+
+// Field: field f of run set to value; 0 if the value is invalid
+
+
+static int Field(RunT *run, int f, const char *value) {
+  switch (f) {
+  case 0:
+    snprintf(run->form, sizeof(run->form), "%s", value);
+    return MediumForm(run->form, &run->prob);
+  case 1: run->nx=atoi(value); return run->nx > 0;
+  case 2: run->ny=atoi(value); return run->ny > 0;
+  case 3: run->nz=atoi(value); return run->nz > 0;
+  case 4: run->absorb=atoi(value); return run->absorb >= 0;
+  case 5: run->dx=atof(value); return run->dx > 0.0f;
+  case 6: run->dy=atof(value); return run->dy > 0.0f;
+  case 7: run->dz=atof(value); return run->dz > 0.0f;
+  case 8: run->dt=atof(value); return 1;
+  case 9: run->tmax=atof(value); return run->tmax > 0.0f;
+  case 10: run->sigma=atof(value); return run->sigma > 0.0;
+  default: return sscanf(value, "%d:%d:%d", &run->ox, &run->oy, &run->oz) == 3;
+  }
+}
+
+
+// Parse: runs of the sweep described in fileName; -1 on error
+
+
+static int Parse(const char *fileName, RunT *runs) {
+  FILE *fp=fopen(fileName, "r");
+  if (fp == NULL) {
+    printf("SweepRun: cannot read %s\n", fileName);
+    return -1;
+  }
+  int nRuns=0, lineNo=0;
+  char line[SWEEP_LINE];
+  while (fgets(line, SWEEP_LINE, fp) != NULL) {
+    lineNo++;
+
+    // values of each field, defaults for the optional ones
+
+    char *value[SWEEP_FIELDS][SWEEP_VALUES];
+    int nValues[SWEEP_FIELDS]={0};
+    char sigma[32];
+    snprintf(sigma, sizeof(sigma), "%f", SIGMA);
+    value[10][0]=sigma; nValues[10]=1;
+    value[11][0]="0:0:0"; nValues[11]=1;
+
+    int f=0;
+    char *save;
+    for (char *token=strtok_r(line, " \t\n", &save); token != NULL; token=strtok_r(NULL, " \t\n", &save)) {
+      if (f == 0 && token[0] == '#')
+	break;
+      int field=f;
+      if (strncmp(token, "sigma=", 6) == 0) {
+	field=10;
+	token+=6;
+      } else if (strncmp(token, "source=", 7) == 0) {
+	field=11;
+	token+=7;
+      } else if (f < 10)
+	f++;
+      else {
+	printf("SweepRun: line %d of %s: unexpected %s\n", lineNo, fileName, token);
+	fclose(fp);
+	return -1;
+      }
+      nValues[field]=0;
+      char *saveValue;
+      for (char *v=strtok_r(token, ",", &saveValue); v != NULL && nValues[field] < SWEEP_VALUES;
+	   v=strtok_r(NULL, ",", &saveValue))
+	value[field][nValues[field]++]=v;
+    }
+    if (f == 0)
+      continue;
+    if (f < 10) {
+      printf("SweepRun: line %d of %s: %d fields, 10 required\n", lineNo, fileName, f);
+      fclose(fp);
+      return -1;
+    }
+
+    // every combination, the last field varying fastest
+
+    int k[SWEEP_FIELDS]={0};
+    for (;;) {
+      if (nRuns == SWEEP_RUNS) {
+	printf("SweepRun: more than %d runs\n", SWEEP_RUNS);
+	fclose(fp);
+	return -1;
+      }
+      RunT *run=&runs[nRuns];
+      for (int j=0; j<SWEEP_FIELDS; j++)
+	if (!Field(run, j, value[j][k[j]])) {
+	  printf("SweepRun: line %d of %s: invalid value %s\n", lineNo, fileName, value[j][k[j]]);
+	  fclose(fp);
+	  return -1;
+	}
+      nRuns++;
+      int j=SWEEP_FIELDS-1;
+      while (j >= 0 && ++k[j] == nValues[j])
+	k[j--]=0;
+      if (j < 0)
+	break;
+    }
+  }
+  fclose(fp);
+  return nRuns;
+}
+
+
+// SweepRun: run the sweep described in fileName; returns the number of failed runs
+
+
+int SweepRun(const char *fileName) {
+  const char *verify=getenv("FLETCHER_VERIFY");
+  if (verify != NULL && verify[0] != '\0') {
+    printf("SweepRun: $FLETCHER_VERIFY holds the reference of a single run; unset it to sweep\n");
+    return 1;
+  }
+  RunT *runs=(RunT *) malloc(SWEEP_RUNS*sizeof(RunT));
+  const int nRuns=Parse(fileName, runs);
+  if (nRuns <= 0) {
+    free(runs);
+    return 1;
+  }
+  const int bord=STENCIL_RADIUS;
+  const float dtOutput=0.01;
+
+  // outputs are named after the file, without directory and extension
+
+  char base[SWEEP_NAME];
+  const char *slash=strrchr(fileName, '/');
+  snprintf(base, SWEEP_NAME, "%s", (slash != NULL) ? slash+1 : fileName);
+  char *dot=strrchr(base, '.');
+  if (dot != NULL && dot != base)
+    *dot='\0';
+
+  // room for the largest grid
+
+  long maxPoints=0;
+  int maxPlanes=0;
+  for (int r=0; r<nRuns; r++) {
+    const int sx=runs[r].nx+2*bord+2*runs[r].absorb;
+    const int sy=runs[r].ny+2*bord+2*runs[r].absorb;
+    const int sz=runs[r].nz+2*bord+2*runs[r].absorb;
+    if ((long)sx*sy*sz > maxPoints)
+      maxPoints=(long)sx*sy*sz;
+    if (sz > maxPlanes)
+      maxPlanes=sz;
+  }
+  float *zPlane=(float *) malloc(maxPlanes*sizeof(float));
+  float *vpz=(float *) malloc(maxPoints*sizeof(float));
+  float *vsv=(float *) malloc(maxPoints*sizeof(float));
+  float *epsilon=(float *) malloc(maxPoints*sizeof(float));
+  float *delta=(float *) malloc(maxPoints*sizeof(float));
+  float *phi=(float *) malloc(maxPoints*sizeof(float));
+  float *theta=(float *) malloc(maxPoints*sizeof(float));
+  printf("Sweep %s: %d runs, room for %ld grid points\n", fileName, nRuns, maxPoints);
+
+  char name[SWEEP_NAME+16];
+  snprintf(name, sizeof(name), "%s.dat", base);
+  FILE *fp=fopen(name, "w");
+  if (fp != NULL)
+    fprintf(fp, "# run form nx ny nz absorb dx dy dz dt tmax sigma source recomputed "
+	    "wall_s propagate_s overhead_s medium_s precompute_s setup_s output_s msamples_per_s\n");
+
+  const char *report=getenv("FLETCHER_REPORT");
+  char *savedReport=(report != NULL) ? strdup(report) : NULL;
+  FletcherT *ctx=NULL;
+  const RunT *prev=NULL;
+  float stabdt=0.0f;
+  int failed=0;
+  double sumWall=0.0, sumPropagate=0.0;
+
+  for (int r=0; r<nRuns; r++) {
+    const RunT *run=&runs[r];
+    const int sx=run->nx+2*bord+2*run->absorb;
+    const int sy=run->ny+2*bord+2*run->absorb;
+    const int sz=run->nz+2*bord+2*run->absorb;
+#ifdef BRICK
+    if (sx%BRICK_X!=0 || sy%BRICK_Y!=0 || sz%BRICK_Z!=0) {
+      printf("Sweep run %d: grid (%d,%d,%d) must be a multiple of the brick (%d,%d,%d)\n",
+	     r, sx, sy, sz, BRICK_X, BRICK_Y, BRICK_Z);
+      failed++;
+      continue;
+    }
+#endif
+    const double t0=wtime();
+
+    // medium and coefficients, where they changed
+
+    const int gridChanged=(prev == NULL || prev->prob != run->prob ||
+			   prev->nx != run->nx || prev->ny != run->ny || prev->nz != run->nz ||
+			   prev->absorb != run->absorb || prev->dz != run->dz);
+    const int sigmaChanged=(prev == NULL || prev->sigma != run->sigma);
+    const int parts=gridChanged ? COEF_ALL : (sigmaChanged ? COEF_VELOCITIES : 0);
+    if (gridChanged || sigmaChanged) {
+      ZGridPlanes(run->prob, sz, bord+run->absorb, run->dz, zPlane);
+      Medium(run->prob, sx, sy, sz, zPlane, run->sigma, vpz, vsv, epsilon, delta, phi, theta);
+      // the random boundary of a run of its own, that starts from the default seed
+      srand(1);
+      RandomVelocityBoundary(sx, sy, sz, run->nx, run->ny, run->nz, bord, run->absorb, vpz, vsv);
+    }
+    if (gridChanged || sigmaChanged || prev->dx != run->dx || prev->dy != run->dy)
+      stabdt=MediumStability(sx, sy, sz, run->dx, run->dy, run->dz, zPlane, vpz, epsilon);
+    float dt=run->dt;
+    if (dt <= 0.0f) {
+      const int stepsPerOutput=(int)ceilf(dtOutput/(DT_SAFETY*stabdt));
+      dt=dtOutput/stepsPerOutput;
+    }
+    if (dt > stabdt)
+      printf("**(SweepRun)**: time step %f exceeds the stability limit %f\n", dt, stabdt);
+    const int st=ceil(run->tmax/dt);
+    const double tMedium=wtime()-t0;
+    MetricsPhase(PHASE_SETUP, tMedium);
+
+    const FletcherGridT grid={sx, sy, sz, bord, run->dx, run->dy, run->dz, dt, 0, maxPoints};
+    if (ctx == NULL)
+      ctx=FletcherInit(&grid, vpz, vsv, epsilon, delta, phi, theta, zPlane);
+    else
+      FletcherReuse(ctx, &grid, parts, vpz, vsv, epsilon, delta, phi, theta, zPlane);
+    if (ctx == NULL)
+      break;
+
+    const int ix=sx/2+run->ox, iy=sy/2+run->oy, iz=sz/2+run->oz;
+    if (ix < bord || ix >= sx-bord || iy < bord || iy >= sy-bord || iz < bord || iz >= sz-bord) {
+      printf("Sweep run %d: source (%d,%d,%d) outside the grid\n", r, ix, iy, iz);
+      failed++;
+      prev=run;
+      continue;
+    }
+
+    // outputs and reports of the run
+
+    int izEnd=sz-1;
+#ifdef NONUNIFORM_Z
+    float dzOut;
+    int kFirst;
+    izEnd=ZGridOutput(zPlane, sz, &dzOut, &kFirst)-1;
+#else
+    const float dzOut=run->dz;
+#endif
+    snprintf(name, sizeof(name), "%s_%d", base, r);
+    setenv("FLETCHER_REPORT", name, 1);
+    SlicePtr sPtr=OpenSliceFile(0, sx-1, 0, sy-1, 0, izEnd, run->dx, run->dy, dzOut, dt, name);
+    const int completed=Model(st, FletcherIndex(ctx, ix, iy, iz), dtOutput, sPtr, run->form,
+			      sx, sy, sz, bord, run->dx, run->dy, run->dz, dt, 0,
+			      vpz, vsv, epsilon, delta, phi, theta, run->absorb, zPlane, ctx);
+    free(sPtr);
+    if (!completed) {
+      printf("Sweep run %d: wave fields diverged\n", r);
+      failed++;
+      prev=run;
+      continue;
+    }
+
+    // time outside of propagation
+
+    const double wall=wtime()-t0;
+    const double propagate=MetricsReported(PHASE_PROPAGATE);
+    const double precompute=MetricsReported(PHASE_PRECOMPUTE);
+    const double setup=MetricsReported(PHASE_SETUP)-tMedium;
+    const double output=MetricsReported(PHASE_OUTPUT);
+    const double msamples=1.0e-6*(double)(sx-2*bord)*(sy-2*bord)*(sz-2*bord)*st/propagate;
+    const char *recomputed=(parts == COEF_ALL) ? "all" : (parts == COEF_VELOCITIES) ? "velocities" : "none";
+    printf("Sweep run %d of %d: %s %dx%dx%d dt %g tmax %g sigma %g source %+d:%+d:%+d; recomputed %s\n",
+	   r+1, nRuns, run->form, run->nx, run->ny, run->nz, dt, run->tmax, run->sigma,
+	   run->ox, run->oy, run->oz, recomputed);
+    printf("Sweep run %d of %d: overhead %.3lf s (medium %.3lf, precompute %.3lf, setup %.3lf, output %.3lf), "
+	   "propagate %.3lf s, %.0lf MSamples/s\n",
+	   r+1, nRuns, wall-propagate, tMedium, precompute, setup, output, propagate, msamples);
+    fflush(stdout);
+    if (fp != NULL)
+      fprintf(fp, "%d %s %d %d %d %d %g %g %g %g %g %g %d:%d:%d %s %.6lf %.6lf %.6lf %.6lf %.6lf %.6lf %.6lf %.2lf\n",
+	      r, run->form, run->nx, run->ny, run->nz, run->absorb, run->dx, run->dy, run->dz, dt,
+	      run->tmax, run->sigma, run->ox, run->oy, run->oz, recomputed,
+	      wall, propagate, wall-propagate, tMedium, precompute, setup, output, msamples);
+    sumWall+=wall;
+    sumPropagate+=propagate;
+    prev=run;
+  }
+
+  if (ctx != NULL)
+    FletcherFree(ctx);
+  if (savedReport != NULL) {
+    setenv("FLETCHER_REPORT", savedReport, 1);
+    free(savedReport);
+  } else
+    unsetenv("FLETCHER_REPORT");
+  if (fp != NULL)
+    fclose(fp);
+  printf("Sweep %s: %d runs, %d failed; %.3lf s, of which %.3lf s propagating and %.3lf s (%.1lf%%) overhead\n",
+	 fileName, nRuns, failed, sumWall, sumPropagate, sumWall-sumPropagate,
+	 (sumWall > 0.0) ? 100.0*(sumWall-sumPropagate)/sumWall : 0.0);
+  free(zPlane);
+  free(vpz); free(vsv); free(epsilon); free(delta); free(phi); free(theta);
+  free(runs);
+  return failed+(ctx == NULL);
+}
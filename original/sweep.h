@@ -0,0 +1,35 @@
+#ifndef _SWEEP
+#define _SWEEP
+
+
+// Sweep mode: SWEEP file runs the runs described in file back to back in this process,
+// each with the outputs and reports of a run of its own, named after the file and the
+// run (file_0.rsf, file_0.csv, file_0.json, ...), and a summary file.dat. One line of
+// the description is
+//   form nx ny nz absorb dx dy dz dt tmax [sigma=s] [source=ox:oy:oz]
+// with the fields of a run, sigma (SIGMA by default) and the offset in grid points of
+// the source from the centre of the grid; any field may be a comma separated list of
+// values, and the line stands for every combination, the last field varying fastest.
+// Lines starting with # are comments. $FLETCHER_VERIFY, the reference of a single
+// run, must be unset.
+//
+// The medium, the coefficients and the wave fields are allocated once, for the
+// largest grid. Between runs the wave fields are zeroed by the threads that use
+// them, and only what depends on what changed is computed again: the medium and all
+// coefficients when the formulation, grid or sigma change (only the velocity
+// coefficients for sigma), nothing when only dt, tmax or the source change. Each
+// run reports its time outside of propagation.
+
+
+#define SWEEP_ARGS 3             // tokens in the sweep command
+#define SWEEP_LINE 1024          // length of a line of the description
+#define SWEEP_VALUES 64          // values of a field in a line
+#define SWEEP_RUNS 4096          // runs of a sweep
+
+
+// SweepRun: run the sweep described in fileName; returns the number of failed runs
+
+
+int SweepRun(const char *fileName);
+
+#endif
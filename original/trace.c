@@ -0,0 +1,166 @@
+#ifdef TRACE
+
+#include <time.h>
+#include "trace.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+typedef struct {
+  uint64_t start;
+  uint64_t end;
+  int event;
+  int tile;
+} TraceSpan;
+
+typedef struct {
+  TraceSpan *span;
+  long n;                 // spans recorded; the last min(n,capacity) are kept
+  int ompThread;          // OpenMP thread number at the first record, -1 outside OpenMP
+} TraceBuffer;
+
+
+static const char *eventName[NTRACE_EVENTS]={"kernel", "rhs", "source", "propagate", "swap", "output",
+					       "consumer", "stall"};
+
+int traceOn=0;
+static char traceName[4096];
+static long capacity=TRACE_RECORDS;
+static uint64_t t0=0;
+static double spanCost=0.0;        // seconds per traced span, from the calibration
+static TraceBuffer *buffer[TRACE_THREADS];
+static int nBuffers=0;
+static __thread TraceBuffer *mine=NULL;
+
+
+// TraceNow: monotonic time in ns
+
+
+uint64_t TraceNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+// NewBuffer: buffer of the calling thread; NULL past TRACE_THREADS threads
+
+
+static TraceBuffer *NewBuffer() {
+  const int k=__atomic_fetch_add(&nBuffers, 1, __ATOMIC_RELAXED);
+  if (k >= TRACE_THREADS)
+    return NULL;
+  TraceBuffer *b=(TraceBuffer *) malloc(sizeof(TraceBuffer));
+  b->span=(TraceSpan *) malloc(capacity*sizeof(TraceSpan));
+  b->n=0;
+#ifdef _OPENMP
+  b->ompThread=omp_in_parallel() ? omp_get_thread_num() : -1;
+#else
+  b->ompThread=-1;
+#endif
+  __atomic_store_n(&buffer[k], b, __ATOMIC_RELEASE);
+  return b;
+}
+
+
+// TraceRecord: record a span of event on tile (-1 if none) from start to now
+
+
+void TraceRecord(int event, int tile, uint64_t start) {
+  const uint64_t end=TraceNow();
+  if (mine == NULL && (mine=NewBuffer()) == NULL)
+    return;
+  TraceSpan *s=&mine->span[mine->n%capacity];
+  s->start=start;
+  s->end=end;
+  s->event=event;
+  s->tile=tile;
+  mine->n++;
+}
+
+
+// TraceFlush: write the trace in Chrome trace event format and report the overhead
+
+
+static void TraceFlush() {
+
+  traceOn=0;
+  FILE *fp=fopen(traceName, "w");
+  if (fp == NULL) {
+    printf("TraceFlush: cannot write %s\n", traceName);
+    return;
+  }
+
+  const int nb=(nBuffers < TRACE_THREADS) ? nBuffers : TRACE_THREADS;
+  long kept=0, dropped=0;
+  uint64_t last=t0;
+
+  fprintf(fp, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  for (int k=0; k<nb; k++) {
+    const TraceBuffer *b=buffer[k];
+    if (b == NULL)
+      continue;
+    if (b->ompThread >= 0)
+      fprintf(fp, "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %d, "
+	      "\"args\": {\"name\": \"thread %d (OpenMP %d)\"}},\n", k, k, b->ompThread);
+    else
+      fprintf(fp, "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %d, "
+	      "\"args\": {\"name\": \"thread %d\"}},\n", k, k);
+    const long first=(b->n > capacity) ? b->n-capacity : 0;
+    for (long r=first; r<b->n; r++) {
+      const TraceSpan *s=&b->span[r%capacity];
+      fprintf(fp, "{\"ph\": \"X\", \"name\": \"%s\", \"pid\": 1, \"tid\": %d, "
+	      "\"ts\": %.3lf, \"dur\": %.3lf",
+	      eventName[s->event], k, 1.0e-3*(double)(s->start-t0), 1.0e-3*(double)(s->end-s->start));
+      if (s->tile >= 0)
+	fprintf(fp, ", \"args\": {\"tile\": %d}", s->tile);
+      fprintf(fp, "},\n");
+      if (s->end > last)
+	last=s->end;
+    }
+    kept+=b->n-first;
+    dropped+=first;
+  }
+  fprintf(fp, "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": 1, \"args\": {\"name\": \"fletcher\"}}\n");
+  fprintf(fp, "]}\n");
+  fclose(fp);
+
+  const double traced=1.0e-9*(double)(last-t0);
+  const double overhead=spanCost*(kept+dropped);
+  printf("Trace %s: %ld spans of %d threads, %ld dropped by full buffers\n",
+	 traceName, kept, nb, dropped);
+  printf("Trace overhead %.0lf ns per span, %.3lf s in all threads (%.2lf%% of %.3lf s traced)\n",
+	 1.0e9*spanCost, overhead, (traced > 0.0) ? 100.0*overhead/traced : 0.0, traced);
+}
+
+
+// TraceInitialize: enable tracing if $FLETCHER_TRACE is set; the trace is written at exit
+
+
+void TraceInitialize() {
+  const char *env=getenv("FLETCHER_TRACE");
+  if (env == NULL || env[0] == '\0')
+    return;
+  snprintf(traceName, sizeof(traceName), "%s", env);
+  const char *records=getenv("FLETCHER_TRACE_RECORDS");
+  if (records != NULL && atol(records) > 0)
+    capacity=atol(records);
+
+  // cost of one span, timed on the buffer of this thread and then discarded
+
+  traceOn=1;
+  const uint64_t c0=TraceNow();
+  for (int k=0; k<TRACE_CALIB; k++) {
+    TRACE_BEGIN(t);
+    TRACE_END(t, TRACE_KERNEL, k);
+  }
+  spanCost=1.0e-9*(double)(TraceNow()-c0)/TRACE_CALIB;
+  mine->n=0;
+
+  t0=TraceNow();
+  atexit(TraceFlush);
+  printf("Tracing to %s, %ld spans per thread\n", traceName, capacity);
+}
+
+#endif
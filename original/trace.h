@@ -0,0 +1,61 @@
+#ifndef _TRACE
+#define _TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+
+// Timeline tracing (make TRACE=1), enabled at run time by $FLETCHER_TRACE, the name
+// of the Chrome trace JSON file (chrome://tracing or ui.perfetto.dev) written at exit.
+// Each thread records (start, end, event, tile) spans in its own ring buffer of
+// $FLETCHER_TRACE_RECORDS records (default TRACE_RECORDS); when a buffer wraps, its
+// oldest spans are dropped. Without TRACE the macros below compile to nothing.
+
+
+#define TRACE_RECORDS 65536     // records per thread buffer
+#define TRACE_THREADS 256       // threads that may record
+#define TRACE_CALIB 100000      // spans timed to estimate the tracing overhead
+
+
+enum TraceEvent {TRACE_KERNEL, TRACE_RHS, TRACE_SOURCE, TRACE_PROPAGATE, TRACE_SWAP,
+		 TRACE_OUTPUT, TRACE_CONSUMER, TRACE_STALL, NTRACE_EVENTS};
+
+
+#ifdef TRACE
+
+extern int traceOn;
+
+
+// TraceNow: monotonic time in ns
+
+
+uint64_t TraceNow();
+
+
+// TraceRecord: record a span of event on tile (-1 if none) from start to now
+
+
+void TraceRecord(int event, int tile, uint64_t start);
+
+
+// TraceInitialize: enable tracing if $FLETCHER_TRACE is set; the trace is written at exit
+
+
+void TraceInitialize();
+
+
+#define TRACE_BEGIN(t) const uint64_t t=traceOn ? TraceNow() : 0
+#define TRACE_END(t, event, tile) if (traceOn) TraceRecord(event, tile, t)
+
+#else
+
+#define TraceInitialize()
+#define TRACE_BEGIN(t)
+#define TRACE_END(t, event, tile)
+
+#endif
+
+#endif
@@ -1,6 +1,22 @@
 #include "utils.h"
     
 
+#ifdef BRICK
+
+// WriteRow: appends row (ixStart:ixEnd,iy,iz) of a bricked array, in row-major order
+
+
+static void WriteRow(int sx, int sy, int sz,
+		     int ixStart, int ixEnd, int iy, int iz,
+		     const float *arrP, float *row, FILE *fp) {
+  int ix;
+  for (ix=ixStart; ix<=ixEnd; ix++)
+    row[ix-ixStart]=arrP[ind(ix,iy,iz)];
+  fwrite((void *) row, sizeof(float), ixEnd-ixStart+1, fp);
+}
+#endif
+
+
 // DumpFieldToFile: dumps array into a file using RFS format
 
 
@@ -41,9 +57,17 @@ void DumpFieldToFile(int sx, int sy, int sz,
   // create binary file
   
   fp=fopen(fNameBinary, "w+b");
+#ifdef BRICK
+  float *row=(float *) malloc(sx*sizeof(float));
+  for (iz=izStart; iz<=izEnd; iz++)
+    for (iy=iyStart; iy<=iyEnd; iy++) 
+      WriteRow(sx, sy, sz, ixStart, ixEnd, iy, iz, arrP, row, fp);
+  free(row);
+#else
   for (iz=izStart; iz<=izEnd; iz++)
     for (iy=iyStart; iy<=iyEnd; iy++) 
       fwrite((void *) (arrP +ind(ixStart,iy,iz)), sizeof(float), ixEnd-ixStart+1, fp);
+#endif
   fclose(fp);
   int fsize=(ixEnd-ixStart+1)*(iyEnd-iyStart+1)*(izEnd-izStart+1);
   printf("created header (%s) and binary (%s) files\n",
@@ -137,19 +161,27 @@ SlicePtr OpenSliceFile(int ixStart, int ixEnd,
 
 
 void DumpSliceFile(int sx, int sy, int sz,
-		   float *arrP, SlicePtr p) {
+		   const float *arrP, SlicePtr p) {
 
 //PPL  int ix, iy, iz;
   int iy, iz;
   
   // dump section to binary file
   
+#ifdef BRICK
+  float *row=(float *) malloc(sx*sizeof(float));
   for (iz=p->izStart; iz<=p->izEnd; iz++)
     for (iy=p->iyStart; iy<=p->iyEnd; iy++) 
-      fwrite((void *) (arrP+ind(p->ixStart,iy,iz)),
+      WriteRow(sx, sy, sz, p->ixStart, p->ixEnd, iy, iz, arrP, row, p->fpBinary);
+  free(row);
+#else
+  for (iz=p->izStart; iz<=p->izEnd; iz++)
+    for (iy=p->iyStart; iy<=p->iyEnd; iy++) 
+      fwrite((const void *) (arrP+ind(p->ixStart,iy,iz)),
 	     sizeof(float),
 	     p->ixEnd-p->ixStart+1,
 	     p->fpBinary);
+#endif
 
   // increase it count
   
@@ -157,7 +189,7 @@ void DumpSliceFile(int sx, int sy, int sz,
 }
 
 void DumpSliceFile_Nofor(int sx, int sy, int sz,
-		   float *arrP, SlicePtr p) {
+		   const float *arrP, SlicePtr p) {
 
 //PPL  int ix, iy, iz;
   int iy, iz;
@@ -165,10 +197,22 @@ void DumpSliceFile_Nofor(int sx, int sy, int sz,
   
   // dump section to binary file
   
-  fwrite((void *) arrP,
+#ifdef BRICK
+  // bricked arrays are converted to row-major one plane at a time
+  float *plane=(float *) malloc(sx*sy*sizeof(float));
+  for (iz=0; iz<sz; iz++) {
+    for (iy=0; iy<sy; iy++)
+      for (int ix=0; ix<sx; ix++)
+	plane[iy*sx+ix]=arrP[ind(ix,iy,iz)];
+    fwrite((void *) plane, sizeof(float), sx*sy, p->fpBinary);
+  }
+  free(plane);
+#else
+  fwrite((const void *) arrP,
     sizeof(float),
     totalSize,
     p->fpBinary);
+#endif
 
   // increase it count
   
@@ -230,7 +274,7 @@ void CloseSliceFile(SlicePtr p){
 
 void   DumpSliceSummary(int sx, int sy, int sz,
 			SlicePtr p,
-			float dt, int it, float *arrP, float src) {
+			float dt, int it, const float *arrP, float src) {
 
   int ix, iy, iz;
   float maxP, minP, valP;
@@ -69,10 +69,10 @@ SlicePtr OpenSliceFile(int ixStart, int ixEnd,
 
 
 void DumpSliceFile(int sx, int sy, int sz,
-		   float *arrP, SlicePtr p);
+		   const float *arrP, SlicePtr p);
 
 void DumpSliceFile_Nofor(int sx, int sy, int sz,
-		   float *arrP, SlicePtr p);
+		   const float *arrP, SlicePtr p);
 
 
 // CloseSliceFile: close file in RFS format that has been continuously appended
@@ -86,7 +86,7 @@ void CloseSliceFile(SlicePtr p);
 
 void DumpSliceSummary(int sx, int sy, int sz,
 		      SlicePtr p,
-		      float dt, int it, float *arrP, float src);
+		      float dt, int it, const float *arrP, float src);
 
 
 void SwapArrays(float * restrict *pp, float * restrict *pc, float * restrict *qp, float * restrict *qc);
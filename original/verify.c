@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "verify.h"
+#include "map.h"
+#include "zgrid.h"
+#include "walltime.h"
+#ifdef _OPENMP
+#include <omp.h>
+#else
+#define omp_get_max_threads() 1
+#define omp_get_thread_num() 0
+#endif
+
+
+struct VerifyS {
+  int sx, sy, sz;
+  int nz;                    // planes of the output z axis
+  const float *zPlane;
+  int stride;
+  double maxError;
+  char name[VERIFY_NAME];    // reference header
+
+  // reference, mapped from its data file
+
+  int n4;                    // output steps of the reference
+  const float *ref;
+  size_t size;
+  int fd;
+
+  int step;                  // next output step
+  float *plane;              // an output plane per thread
+  float *planeMax, *planeDiff;
+
+  // comparison of all steps
+
+  double maxErr, worstSnr, diff2, ref2, seconds;
+};
+
+
+// Advise: advice on the pages that hold bytes from p
+
+
+static void Advise(const void *p, size_t bytes, int advice) {
+  const size_t page=sysconf(_SC_PAGESIZE);
+  const size_t start=(size_t)p & ~(page-1);
+  madvise((void *)start, (size_t)p+bytes-start, advice);
+}
+
+
+// ReadHeader: dimensions of an RSF header and its data file, relative to the directory
+//             of the header unless absolute; 0 if it cannot be read
+
+
+static int ReadHeader(const char *name, int *n, char *data) {
+  FILE *fp=fopen(name, "r");
+  if (fp == NULL)
+    return 0;
+  char line[VERIFY_NAME], in[VERIFY_NAME]="";
+  int esize=sizeof(float);
+  n[0]=n[1]=n[2]=n[3]=1;
+  while (fgets(line, VERIFY_NAME, fp) != NULL) {
+    int k, value;
+    if (sscanf(line, "n%d=%d", &k, &value) == 2 && k >= 1 && k <= 4)
+      n[k-1]=value;
+    else if (sscanf(line, "esize=%d", &value) == 1)
+      esize=value;
+    else if (strncmp(line, "in=", 3) == 0) {
+      snprintf(in, VERIFY_NAME, "%s", line+3+(line[3] == '"'));
+      in[strcspn(in, "\"\n")]='\0';
+    }
+  }
+  fclose(fp);
+  if (esize != sizeof(float) || in[0] == '\0')
+    return 0;
+  const char *slash=strrchr(name, '/');
+  if (in[0] == '/' || slash == NULL)
+    snprintf(data, VERIFY_NAME, "%s", in);
+  else
+    snprintf(data, VERIFY_NAME, "%.*s/%s", (int)(slash-name), name, in);
+  return 1;
+}
+
+
+// VerifyOpen: verification of the outputs of a grid of sx*sy*sz points with the z
+//             coordinate of each plane in zPlane against $FLETCHER_VERIFY; NULL if
+//             unset. Halts execution if the reference does not match the outputs
+
+
+VerifyT *VerifyOpen(int sx, int sy, int sz, const float *zPlane) {
+  const char *env=getenv("FLETCHER_VERIFY");
+  if (env == NULL || env[0] == '\0')
+    return NULL;
+  VerifyT *v=(VerifyT *) calloc(1, sizeof(VerifyT));
+  v->sx=sx;
+  v->sy=sy;
+  v->sz=sz;
+  v->zPlane=zPlane;
+#ifdef NONUNIFORM_Z
+  float hOut;
+  int kFirst;
+  v->nz=ZGridOutput(zPlane, sz, &hOut, &kFirst);
+#else
+  v->nz=sz;
+#endif
+  snprintf(v->name, VERIFY_NAME, "%s", env);
+  env=getenv("FLETCHER_VERIFY_ERROR");
+  v->maxError=(env != NULL) ? atof(env) : VERIFY_MAX_ERROR;
+  env=getenv("FLETCHER_VERIFY_STRIDE");
+  v->stride=(env != NULL && atoi(env) > 0) ? atoi(env) : 1;
+
+  int n[4];
+  char data[VERIFY_NAME];
+  if (!ReadHeader(v->name, n, data)) {
+    printf("Verification reference %s is not an RSF header of 4 byte samples; execution halted\n", v->name);
+    exit(-1);
+  }
+  if (n[0] != sx || n[1] != sy || n[2] != v->nz) {
+    printf("Verification reference %s is (%d,%d,%d), the outputs (%d,%d,%d); execution halted\n",
+	   v->name, n[0], n[1], n[2], sx, sy, v->nz);
+    exit(-1);
+  }
+  v->n4=n[3];
+  v->size=(size_t)sx*sy*v->nz*v->n4*sizeof(float);
+  struct stat st;
+  v->fd=open(data, O_RDONLY);
+  if (v->fd < 0 || fstat(v->fd, &st) != 0 || (size_t)st.st_size < v->size ||
+      (v->ref=(const float *) mmap(NULL, v->size, PROT_READ, MAP_SHARED, v->fd, 0)) == MAP_FAILED) {
+    printf("Verification reference data %s cannot be mapped; execution halted\n", data);
+    exit(-1);
+  }
+  madvise((void *)v->ref, v->size, MADV_SEQUENTIAL);
+
+  v->plane=(float *) malloc((size_t)omp_get_max_threads()*sx*sy*sizeof(float));
+  v->planeMax=(float *) malloc(v->nz*sizeof(float));
+  v->planeDiff=(float *) malloc(v->nz*sizeof(float));
+  v->worstSnr=INFINITY;
+  printf("Verifying outputs against %s (%d steps), max_error %e, stride %d\n",
+	 v->name, v->n4, v->maxError, v->stride);
+  return v;
+}
+
+
+// OutputPlane: plane iz of the output of field p, as written to the RSF file
+
+
+static const float *OutputPlane(const VerifyT *v, const float *p, int iz, float *plane) {
+#ifdef NONUNIFORM_Z
+  ZGridInterpolate(v->sx, v->sy, v->sz, v->zPlane, p, iz, plane);
+  return plane;
+#elif defined(BRICK)
+  const int sx=v->sx, sy=v->sy;
+  for (int iy=0; iy<sy; iy++)
+    for (int ix=0; ix<sx; ix++)
+      plane[iy*sx+ix]=p[ind(ix,iy,iz)];
+  return plane;
+#else
+  return p+(long)iz*v->sx*v->sy;
+#endif
+}
+
+
+// VerifyStep: compare the next output, of field p at time step it, with the reference;
+//             returns the number of points in error
+
+
+long VerifyStep(VerifyT *v, int it, const float *p) {
+  if (v->step >= v->n4) {
+    if (v->step++ == v->n4)
+      printf("Verification reference %s ends at output %d; later outputs are not verified\n",
+	     v->name, v->n4);
+    return 0;
+  }
+  const double t0=wtime();
+  const int sx=v->sx, sy=v->sy, s=v->stride;
+  const size_t stepPoints=(size_t)sx*sy*v->nz;
+  const float *ref=v->ref+v->step*stepPoints;
+  if (v->step+1 < v->n4)
+    Advise(ref+stepPoints, stepPoints*sizeof(float), MADV_WILLNEED);
+
+  // maxima of the reference and of the difference in each plane, and squared norms
+
+  double ref2=0.0, new2=0.0, diff2=0.0;
+  long points=0;
+#pragma omp parallel for reduction(+:ref2,new2,diff2,points) schedule(dynamic)
+  for (int iz=0; iz<v->nz; iz+=s) {
+    const float *out=OutputPlane(v, p, iz, v->plane+(size_t)omp_get_thread_num()*sx*sy);
+    const float *r=ref+(size_t)iz*sx*sy;
+    float ma=0.0f, md=0.0f;
+    for (int iy=0; iy<sy; iy+=s)
+#pragma omp simd reduction(max:ma,md) reduction(+:ref2,new2,diff2)
+      for (int ix=0; ix<sx; ix+=s) {
+	const int i=iy*sx+ix;
+	const float e=r[i]-out[i];
+	ma=fmaxf(ma, fabsf(r[i]));
+	md=fmaxf(md, fabsf(e));
+	ref2+=(double)r[i]*r[i];
+	new2+=(double)out[i]*out[i];
+	diff2+=(double)e*e;
+      }
+    v->planeMax[iz]=ma;
+    v->planeDiff[iz]=md;
+    points+=(long)((sy+s-1)/s)*((sx+s-1)/s);
+  }
+  float maxval=1.0e-15f, maxdiff=0.0f;
+  for (int iz=0; iz<v->nz; iz+=s) {
+    maxval=fmaxf(maxval, v->planeMax[iz]);
+    maxdiff=fmaxf(maxdiff, v->planeDiff[iz]);
+  }
+
+  // errors are counted again only in the planes that have any
+
+  const double threshold=maxval*v->maxError;
+  long errors=0;
+  if (maxdiff > threshold) {
+#pragma omp parallel for reduction(+:errors) schedule(dynamic)
+    for (int iz=0; iz<v->nz; iz+=s) {
+      if (v->planeDiff[iz] <= threshold)
+	continue;
+      const float *out=OutputPlane(v, p, iz, v->plane+(size_t)omp_get_thread_num()*sx*sy);
+      const float *r=ref+(size_t)iz*sx*sy;
+      for (int iy=0; iy<sy; iy+=s)
+	for (int ix=0; ix<sx; ix+=s)
+	  errors+=(fabsf(r[iy*sx+ix]-out[iy*sx+ix]) > threshold);
+    }
+  }
+  Advise(ref, stepPoints*sizeof(float), MADV_DONTNEED);
+
+  const double snr=(diff2 > 0.0) ? 10.0*log10(ref2/diff2) : INFINITY;
+  printf("Verify output %d (it=%d): maxerr %e rms %e snr %.2lf dB l2ref %e l2new %e errors %ld\n",
+	 v->step, it, maxdiff/maxval, sqrt(diff2/points), snr, sqrt(ref2), sqrt(new2), errors);
+  v->maxErr=fmax(v->maxErr, maxdiff/maxval);
+  v->worstSnr=fmin(v->worstSnr, snr);
+  v->diff2+=diff2;
+  v->ref2+=ref2;
+  v->step++;
+  v->seconds+=wtime()-t0;
+  return errors;
+}
+
+
+// VerifyClose: report the comparison of every output and release the verification
+
+
+void VerifyClose(VerifyT *v) {
+  const int steps=(v->step < v->n4) ? v->step : v->n4;
+  printf("Verified %d outputs against %s in %.3lf s: maximum relative error %e, "
+	 "relative L2 error %e, worst snr %.2lf dB\n",
+	 steps, v->name, v->seconds, v->maxErr,
+	 (v->ref2 > 0.0) ? sqrt(v->diff2/v->ref2) : 0.0, v->worstSnr);
+  munmap((void *)v->ref, v->size);
+  close(v->fd);
+  free(v->plane);
+  free(v->planeMax);
+  free(v->planeDiff);
+  free(v);
+}
@@ -0,0 +1,42 @@
+#ifndef _VERIFY
+#define _VERIFY
+
+
+// Live verification: with $FLETCHER_VERIFY=reference.rsf every output step is compared,
+// as it is written, with the same step of the reference, the output of a run of the
+// same problem by a trusted build (compare/compare.exe does the same offline). Each
+// step reports its maximum relative, RMS and relative L2 errors, SNR and the L2 norms of
+// both; points are errors when their difference exceeds $FLETCHER_VERIFY_ERROR (default
+// VERIFY_MAX_ERROR, the MAX_ERROR of compare.c) times the maximum absolute value of the
+// reference in the step, and the run stops at the first step with errors.
+// $FLETCHER_VERIFY_STRIDE=s compares only every s-th point in each dimension.
+
+
+#define VERIFY_MAX_ERROR 1.0e-5  // relative error tolerance
+#define VERIFY_NAME 512
+
+
+typedef struct VerifyS VerifyT;
+
+
+// VerifyOpen: verification of the outputs of a grid of sx*sy*sz points with the z
+//             coordinate of each plane in zPlane against $FLETCHER_VERIFY; NULL if
+//             unset. Halts execution if the reference does not match the outputs
+
+
+VerifyT *VerifyOpen(int sx, int sy, int sz, const float *zPlane);
+
+
+// VerifyStep: compare the next output, of field p at time step it, with the reference;
+//             returns the number of points in error
+
+
+long VerifyStep(VerifyT *v, int it, const float *p);
+
+
+// VerifyClose: report the comparison of every output and release the verification
+
+
+void VerifyClose(VerifyT *v);
+
+#endif
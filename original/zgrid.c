@@ -0,0 +1,190 @@
+#include "zgrid.h"
+
+
+#define ZGRID_MAX_NODES 17    // 2*STENCIL_RADIUS+1 for the highest stencil order
+
+
+// Fornberg: weights c[k*n+j] of the k-th derivative (k<=m) at x0 over nodes x[0..n-1]
+//           (B. Fornberg, Math. Comp. 51, 1988)
+
+
+static void Fornberg(double x0, const double *x, int n, int m, double *c) {
+  double c1=1.0;
+  double c4=x[0]-x0;
+  for (int j=0; j<(m+1)*n; j++)
+    c[j]=0.0;
+  c[0]=1.0;
+  for (int i=1; i<n; i++) {
+    const int mn=(i < m) ? i : m;
+    double c2=1.0;
+    const double c5=c4;
+    c4=x[i]-x0;
+    for (int j=0; j<i; j++) {
+      const double c3=x[i]-x[j];
+      c2*=c3;
+      if (j == i-1) {
+	for (int k=mn; k>=1; k--)
+	  c[k*n+i]=c1*(k*c[(k-1)*n+i-1]-c5*c[k*n+i-1])/c2;
+	c[i]=-c1*c5*c[i-1]/c2;
+      }
+      for (int k=mn; k>=1; k--)
+	c[k*n+j]=(c4*c[k*n+j]-k*c[(k-1)*n+j])/c3;
+      c[j]=c4*c[j]/c3;
+    }
+    c1=c2;
+  }
+}
+
+
+// ZGridPlanes: z coordinate of each of the sz planes; the outer planes of the
+//              border and absortion zones keep the spacing of the last internal ones
+
+
+void ZGridPlanes(enum Form prob, int sz, int outer, float dz, float *zPlane) {
+  const int izSource=sz/2;
+
+#ifdef NONUNIFORM_Z
+
+  // march from the source plane with spacing dz*v(z)/v(0), v at the middle of each interval
+
+  const double v0=MediumSlowest(prob, 0.0f);
+  double z=0.0, h=dz;
+  zPlane[izSource]=0.0f;
+  for (int iz=izSource+1; iz<sz; iz++) {
+    if (iz < sz-outer)
+      h=dz*MediumSlowest(prob, z+0.5*dz*MediumSlowest(prob, z)/v0)/v0;
+    z+=h;
+    zPlane[iz]=z;
+  }
+  z=0.0;
+  h=dz;
+  for (int iz=izSource-1; iz>=0; iz--) {
+    if (iz >= outer)
+      h=dz*MediumSlowest(prob, z-0.5*dz*MediumSlowest(prob, z)/v0)/v0;
+    z-=h;
+    zPlane[iz]=z;
+  }
+
+#else
+
+  for (int iz=0; iz<sz; iz++)
+    zPlane[iz]=(iz-izSource)*dz;
+
+#endif
+}
+
+
+// ZGridSpacing: distance from plane iz to its nearest neighbour plane
+
+
+float ZGridSpacing(const float *zPlane, int sz, int iz) {
+  if (iz == 0)
+    return zPlane[1]-zPlane[0];
+  if (iz == sz-1)
+    return zPlane[sz-1]-zPlane[sz-2];
+  return fminf(zPlane[iz+1]-zPlane[iz], zPlane[iz]-zPlane[iz-1]);
+}
+
+
+// ZGridWeights: derivative of the plane index with respect to z (d1), that maps first z
+//               derivatives to the uniform plane index, and weights of the second z
+//               derivative (w2) at each plane with a full stencil; STENCIL_WIDTH
+//               weights per plane, zero elsewhere
+
+
+void ZGridWeights(const float *zPlane, int sz, int bord, float *d1, float *w2) {
+  double x[ZGRID_MAX_NODES], c[3*ZGRID_MAX_NODES], u[ZGRID_MAX_NODES], cu[2*ZGRID_MAX_NODES];
+  const int n=STENCIL_WIDTH;
+
+  // first derivative weights in the plane index
+
+  for (int j=0; j<n; j++)
+    u[j]=j-STENCIL_RADIUS;
+  Fornberg(0.0, u, n, 1, cu);
+
+  for (int j=0; j<sz*n; j++)
+    w2[j]=0.0f;
+  for (int iz=0; iz<sz; iz++)
+    d1[iz]=0.0f;
+  for (int iz=bord; iz<sz-bord; iz++) {
+    double dzdi=0.0;
+    for (int j=0; j<n; j++) {
+      x[j]=zPlane[iz-STENCIL_RADIUS+j];
+      dzdi+=cu[n+j]*x[j];
+    }
+    d1[iz]=1.0/dzdi;
+    Fornberg(zPlane[iz], x, n, 2, c);
+    for (int j=0; j<n; j++)
+      w2[iz*n+j]=c[2*n+j];
+  }
+}
+
+
+// ZGridOutput: planes of the uniform output z axis, its spacing and the index
+//              (relative to the source plane) of its first plane
+
+
+int ZGridOutput(const float *zPlane, int sz, float *hOut, int *kFirst) {
+  float h=ZGridSpacing(zPlane, sz, 0);
+  for (int iz=1; iz<sz; iz++)
+    h=fminf(h, ZGridSpacing(zPlane, sz, iz));
+  *hOut=h;
+  *kFirst=(int)ceilf(zPlane[0]/h);
+  return (int)floorf(zPlane[sz-1]/h)-*kFirst+1;
+}
+
+
+// ZGridInterpolate: plane k of the uniform output z axis of array arrP; Lagrange
+//                   interpolation over the 2*STENCIL_RADIUS nearest planes
+
+
+void ZGridInterpolate(int sx, int sy, int sz, const float *zPlane,
+		      const float *arrP, int k, float *plane) {
+  float hOut;
+  int kFirst;
+  ZGridOutput(zPlane, sz, &hOut, &kFirst);
+  const int n=(2*STENCIL_RADIUS < sz) ? 2*STENCIL_RADIUS : sz;
+  double x[ZGRID_MAX_NODES], c[ZGRID_MAX_NODES];
+  const float z=(kFirst+k)*hOut;
+
+  // interval [zPlane[iz],zPlane[iz+1]) holding z, and the nodes centered on it
+
+  int iz=0;
+  while (iz < sz-2 && zPlane[iz+1] <= z)
+    iz++;
+  int iz0=iz-n/2+1;
+  if (iz0 < 0) iz0=0;
+  if (iz0 > sz-n) iz0=sz-n;
+  for (int j=0; j<n; j++)
+    x[j]=zPlane[iz0+j];
+  Fornberg(z, x, n, 0, c);
+
+  for (int iy=0; iy<sy; iy++)
+    for (int ix=0; ix<sx; ix++) {
+      float v=0.0f;
+      for (int j=0; j<n; j++)
+	v+=c[j]*arrP[ind(ix,iy,iz0+j)];
+      plane[iy*sx+ix]=v;
+    }
+}
+
+
+// ZGridDump: appends one array, interpolated to the uniform output z axis, to an opened RFS file
+
+
+void ZGridDump(int sx, int sy, int sz, const float *zPlane,
+	       const float *arrP, SlicePtr p) {
+  float hOut;
+  int kFirst;
+  const int nOut=ZGridOutput(zPlane, sz, &hOut, &kFirst);
+  float *plane=(float *) malloc(sx*sy*sizeof(float));
+  for (int k=0; k<nOut; k++) {
+    ZGridInterpolate(sx, sy, sz, zPlane, arrP, k, plane);
+    fwrite((void *) plane, sizeof(float), sx*sy, p->fpBinary);
+  }
+  free(plane);
+
+  // increase it count
+
+  p->itCnt++;
+}
@@ -0,0 +1,62 @@
+#ifndef _ZGRID
+#define _ZGRID
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include "map.h"
+#include "utils.h"
+#include "medium.h"
+
+
+// z axis of the grid: coordinate of each plane relative to the source plane (sz/2).
+// Uniform by default; with make NONUNIFORM_Z=1 the spacing follows the slowest qP velocity
+// of each depth, keeping the points per wavelength of the source plane, where the spacing
+// is dz. Derivatives along z then use per plane coefficients of the stretched grid (precomp.h),
+// and outputs are interpolated to a uniform z axis as fine as the finest plane spacing.
+
+
+// ZGridPlanes: z coordinate of each of the sz planes; the outer planes of the
+//              border and absortion zones keep the spacing of the last internal ones
+
+
+void ZGridPlanes(enum Form prob, int sz, int outer, float dz, float *zPlane);
+
+
+// ZGridSpacing: distance from plane iz to its nearest neighbour plane
+
+
+float ZGridSpacing(const float *zPlane, int sz, int iz);
+
+
+// ZGridWeights: derivative of the plane index with respect to z (d1), that maps first z
+//               derivatives to the uniform plane index, and weights of the second z
+//               derivative (w2) at each plane with a full stencil; STENCIL_WIDTH
+//               weights per plane, zero elsewhere
+
+
+void ZGridWeights(const float *zPlane, int sz, int bord, float *d1, float *w2);
+
+
+// ZGridOutput: planes of the uniform output z axis, its spacing and the index
+//              (relative to the source plane) of its first plane
+
+
+int ZGridOutput(const float *zPlane, int sz, float *hOut, int *kFirst);
+
+
+// ZGridInterpolate: plane k of the uniform output z axis of array arrP, in plane
+
+
+void ZGridInterpolate(int sx, int sy, int sz, const float *zPlane,
+		      const float *arrP, int k, float *plane);
+
+
+// ZGridDump: appends one array, interpolated to the uniform output z axis, to an opened RFS file
+
+
+void ZGridDump(int sx, int sy, int sz, const float *zPlane,
+	       const float *arrP, SlicePtr p);
+
+#endif